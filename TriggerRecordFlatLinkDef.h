@@ -0,0 +1,10 @@
+#ifdef __ROOTCLING__
+
+#pragma link C++ class TriggerRecordFlat+;
+#pragma link C++ enum TriggerRecordFlat::EDataType+;
+#pragma link C++ class TriggerRecordFlat::Stream+;
+#pragma link C++ class TriggerRecordFlat::HWSignalsInterfaces+;
+#pragma link C++ class TriggerRecordFlat::Triggers+;
+#pragma link C++ class TriggerRecordFlat::TRBuilders+;
+
+#endif
@@ -0,0 +1,11 @@
+#ifdef __ROOTCLING__
+
+#pragma link C++ class TriggerRecordUnits+;
+#pragma link C++ enum TriggerRecordUnits::EDataType+;
+#pragma link C++ class TriggerRecordUnits::Stream+;
+#pragma link C++ class TriggerRecordUnits::Detectors+;
+#pragma link C++ class TriggerRecordUnits::HWSignalsInterfaces+;
+#pragma link C++ class TriggerRecordUnits::Triggers+;
+#pragma link C++ class TriggerRecordUnits::TRBuilders+;
+
+#endif
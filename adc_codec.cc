@@ -0,0 +1,248 @@
+/**
+ * Copyright CERN; jblomer@cern.ch
+ */
+
+#include "adc_codec.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+// First byte of the encoded payload
+constexpr std::uint8_t kTagVerbatim = 0;
+constexpr std::uint8_t kTagADC = 1;
+// Tag plus the size of the original payload
+constexpr std::size_t kPreambleSize = 1 + sizeof(std::uint64_t);
+
+// Frame geometries of the DUNE DAQ formats (daqdataformats fragment header, fddetdataformats frames)
+constexpr RADCFrameLayout kLayoutWIBEth{72, 7200, 32, 64, 64, 14};
+constexpr RADCFrameLayout kLayoutDAPHNEStream{72, 480, 32, 4, 64, 14};
+
+// The bit manipulation assumes a little-endian host, like the DAQ formats themselves
+
+std::uint32_t ReadBits(const unsigned char *base, std::size_t nbytes, std::size_t bitOffset, unsigned nbits)
+{
+   std::uint64_t word = 0;
+   const auto byte = bitOffset / 8;
+   memcpy(&word, base + byte, std::min<std::size_t>(sizeof(word), nbytes - byte));
+   return (word >> (bitOffset % 8)) & ((std::uint64_t(1) << nbits) - 1);
+}
+
+// The target bits must be zero
+void OrBits(unsigned char *base, std::size_t nbytes, std::size_t bitOffset, std::uint32_t value)
+{
+   std::uint64_t word = 0;
+   const auto byte = bitOffset / 8;
+   const auto n = std::min<std::size_t>(sizeof(word), nbytes - byte);
+   memcpy(&word, base + byte, n);
+   word |= std::uint64_t(value) << (bitOffset % 8);
+   memcpy(base + byte, &word, n);
+}
+
+std::uint32_t ZigZagEncode(std::int32_t value)
+{
+   return (static_cast<std::uint32_t>(value) << 1) ^ static_cast<std::uint32_t>(value >> 31);
+}
+
+std::int32_t ZigZagDecode(std::uint32_t value)
+{
+   return static_cast<std::int32_t>(value >> 1) ^ -static_cast<std::int32_t>(value & 1);
+}
+
+unsigned GetBitWidth(std::uint32_t value)
+{
+   unsigned width = 0;
+   while (value) {
+      width++;
+      value >>= 1;
+   }
+   return width;
+}
+
+void Append(std::vector<std::byte> &out, const void *data, std::size_t size)
+{
+   auto bytes = static_cast<const std::byte *>(data);
+   out.insert(out.end(), bytes, bytes + size);
+}
+
+void WritePreamble(std::uint8_t tag, std::uint64_t size, std::vector<std::byte> &out)
+{
+   out.clear();
+   out.push_back(static_cast<std::byte>(tag));
+   Append(out, &size, sizeof(size));
+}
+
+std::uint64_t ReadPreamble(const std::byte *data, std::size_t size, std::uint8_t &tag)
+{
+   assert(size >= kPreambleSize);
+   tag = static_cast<std::uint8_t>(data[0]);
+   std::uint64_t originalSize;
+   memcpy(&originalSize, data + 1, sizeof(originalSize));
+   return originalSize;
+}
+
+/// Appends values of a fixed bit width to a byte vector
+class RBitWriter {
+   std::vector<std::byte> &fOut;
+   std::uint64_t fBuffer = 0;
+   unsigned fNBits = 0;
+
+public:
+   explicit RBitWriter(std::vector<std::byte> &out) : fOut(out) {}
+
+   void Write(std::uint32_t value, unsigned nbits)
+   {
+      fBuffer |= std::uint64_t(value) << fNBits;
+      fNBits += nbits;
+      while (fNBits >= 8) {
+         fOut.push_back(static_cast<std::byte>(fBuffer & 0xff));
+         fBuffer >>= 8;
+         fNBits -= 8;
+      }
+   }
+
+   /// Pads to the next byte boundary
+   void Flush()
+   {
+      if (fNBits > 0)
+         fOut.push_back(static_cast<std::byte>(fBuffer & 0xff));
+      fBuffer = 0;
+      fNBits = 0;
+   }
+};
+
+} // anonymous namespace
+
+void RIdentityTransform::Encode(const std::byte *data, std::size_t size, std::vector<std::byte> &out) const
+{
+   out.assign(data, data + size);
+}
+
+void RIdentityTransform::Decode(const std::byte *data, std::size_t size, std::vector<std::byte> &out) const
+{
+   out.assign(data, data + size);
+}
+
+void RADCTransform::Encode(const std::byte *data, std::size_t size, std::vector<std::byte> &out) const
+{
+   const auto adcSize = fLayout.GetADCSize();
+   const std::size_t nFrames = (size > fLayout.fFragmentHeaderSize)
+                                  ? (size - fLayout.fFragmentHeaderSize) / fLayout.fFrameSize
+                                  : 0;
+   if ((nFrames == 0) || (fLayout.fFragmentHeaderSize + nFrames * fLayout.fFrameSize != size)) {
+      WritePreamble(kTagVerbatim, size, out);
+      Append(out, data, size);
+      return;
+   }
+
+   WritePreamble(kTagADC, size, out);
+   out.reserve(size);
+   Append(out, data, fLayout.fFragmentHeaderSize);
+   const auto frames = reinterpret_cast<const unsigned char *>(data) + fLayout.fFragmentHeaderSize;
+   for (std::size_t f = 0; f < nFrames; ++f) {
+      const auto frame = frames + f * fLayout.fFrameSize;
+      Append(out, frame, fLayout.fADCOffset);
+      Append(out, frame + fLayout.fADCOffset + adcSize, fLayout.fFrameSize - fLayout.fADCOffset - adcSize);
+   }
+
+   const std::size_t nValues = nFrames * fLayout.fNSamples;
+   std::vector<std::uint32_t> values(nValues);
+   RBitWriter writer(out);
+   for (unsigned c = 0; c < fLayout.fNChannels; ++c) {
+      std::int32_t prev = 0;
+      for (std::size_t f = 0; f < nFrames; ++f) {
+         const auto adc = frames + f * fLayout.fFrameSize + fLayout.fADCOffset;
+         for (unsigned s = 0; s < fLayout.fNSamples; ++s) {
+            const std::size_t bitOffset = (std::size_t(s) * fLayout.fNChannels + c) * fLayout.fNBits;
+            const auto value = static_cast<std::int32_t>(ReadBits(adc, adcSize, bitOffset, fLayout.fNBits));
+            values[f * fLayout.fNSamples + s] = ZigZagEncode(value - prev);
+            prev = value;
+         }
+      }
+
+      for (std::size_t first = 0; first < nValues; first += kBlockSize) {
+         const auto last = std::min(nValues, first + kBlockSize);
+         std::uint32_t maxValue = 0;
+         for (auto i = first; i < last; ++i)
+            maxValue |= values[i];
+         const auto width = GetBitWidth(maxValue);
+         out.push_back(static_cast<std::byte>(width));
+         for (auto i = first; i < last; ++i)
+            writer.Write(values[i], width);
+         writer.Flush();
+      }
+   }
+}
+
+void RADCTransform::Decode(const std::byte *data, std::size_t size, std::vector<std::byte> &out) const
+{
+   std::uint8_t tag;
+   const auto originalSize = ReadPreamble(data, size, tag);
+   if (tag == kTagVerbatim) {
+      assert(size == kPreambleSize + originalSize);
+      out.assign(data + kPreambleSize, data + size);
+      return;
+   }
+   assert(tag == kTagADC);
+
+   const auto adcSize = fLayout.GetADCSize();
+   const std::size_t nFrames = (originalSize - fLayout.fFragmentHeaderSize) / fLayout.fFrameSize;
+   const std::size_t nValues = nFrames * fLayout.fNSamples;
+   const std::size_t otherSize = fLayout.fFrameSize - adcSize;
+
+   // The ADC words are or-ed together from the unpacked values, so they have to start zeroed
+   out.assign(originalSize, std::byte{0});
+   auto in = reinterpret_cast<const unsigned char *>(data) + kPreambleSize;
+   const auto inEnd = reinterpret_cast<const unsigned char *>(data) + size;
+   memcpy(out.data(), in, fLayout.fFragmentHeaderSize);
+   in += fLayout.fFragmentHeaderSize;
+   auto frames = reinterpret_cast<unsigned char *>(out.data()) + fLayout.fFragmentHeaderSize;
+   for (std::size_t f = 0; f < nFrames; ++f) {
+      const auto frame = frames + f * fLayout.fFrameSize;
+      memcpy(frame, in, fLayout.fADCOffset);
+      memcpy(frame + fLayout.fADCOffset + adcSize, in + fLayout.fADCOffset, otherSize - fLayout.fADCOffset);
+      in += otherSize;
+   }
+
+   for (unsigned c = 0; c < fLayout.fNChannels; ++c) {
+      std::int32_t prev = 0;
+      for (std::size_t first = 0; first < nValues; first += kBlockSize) {
+         const auto last = std::min(nValues, first + kBlockSize);
+         assert(in < inEnd);
+         const unsigned width = *in++;
+         const std::size_t blockBytes = ((last - first) * width + 7) / 8;
+         assert(in + blockBytes <= inEnd);
+         for (auto i = first; i < last; ++i) {
+            const auto value = prev + ZigZagDecode(width ? ReadBits(in, blockBytes, (i - first) * width, width) : 0);
+            prev = value;
+            const auto f = i / fLayout.fNSamples;
+            const auto s = i % fLayout.fNSamples;
+            const std::size_t bitOffset = (s * fLayout.fNChannels + c) * fLayout.fNBits;
+            OrBits(frames + f * fLayout.fFrameSize + fLayout.fADCOffset, adcSize, bitOffset,
+                   static_cast<std::uint32_t>(value));
+         }
+         in += blockBytes;
+      }
+   }
+   assert(in == inEnd);
+   (void)inEnd;
+}
+
+const RStreamTransform &GetStreamTransform(TriggerRecord::EDataType type)
+{
+   static const RIdentityTransform identity;
+   static const RADCTransform wibEth("adc-wibeth", kLayoutWIBEth);
+   static const RADCTransform daphneStream("adc-daphne", kLayoutDAPHNEStream);
+
+   switch (type) {
+   case TriggerRecord::EDataType::kWIBEth:
+      return wibEth;
+   case TriggerRecord::EDataType::kDAPHNEStream:
+      return daphneStream;
+   default:
+      return identity;
+   }
+}
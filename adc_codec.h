@@ -0,0 +1,69 @@
+/**
+ * Copyright CERN; jblomer@cern.ch
+ */
+
+#ifndef ADC_CODEC_H_
+#define ADC_CODEC_H_
+
+#include "TriggerRecord.hxx"
+
+#include <cstddef>
+#include <vector>
+
+/// Reversible transformation of a stream payload that is applied before the general-purpose compression.
+/// Transforms are selected per stream data type with `GetStreamTransform()`.
+class RStreamTransform {
+public:
+   virtual ~RStreamTransform() = default;
+   virtual const char *GetName() const = 0;
+   /// Replaces the content of `out` by the encoded form of the `size` bytes at `data`
+   virtual void Encode(const std::byte *data, std::size_t size, std::vector<std::byte> &out) const = 0;
+   /// Replaces the content of `out` by the original payload restored from the `size` encoded bytes at `data`
+   virtual void Decode(const std::byte *data, std::size_t size, std::vector<std::byte> &out) const = 0;
+};
+
+/// Passes the payload through unchanged
+class RIdentityTransform : public RStreamTransform {
+public:
+   const char *GetName() const final { return "identity"; }
+   void Encode(const std::byte *data, std::size_t size, std::vector<std::byte> &out) const final;
+   void Decode(const std::byte *data, std::size_t size, std::vector<std::byte> &out) const final;
+};
+
+/// Geometry of a fragment of detector frames with packed ADC samples.  A fragment is a fragment header
+/// followed by frames of fixed size.  Every frame has a header and fNSamples time samples; within a time
+/// sample, the fNChannels ADC values of fNBits each are packed little-endian, channel after channel.
+struct RADCFrameLayout {
+   std::size_t fFragmentHeaderSize;
+   std::size_t fFrameSize;
+   /// Offset of the packed ADC words within the frame
+   std::size_t fADCOffset;
+   unsigned fNChannels;
+   unsigned fNSamples;
+   unsigned fNBits;
+
+   std::size_t GetADCSize() const { return fNSamples * fNChannels * fNBits / 8; }
+};
+
+/// Unpacks the ADC samples of the frames of a fragment, stores them per channel as zigzag-encoded
+/// differences to the previous sample, and bit-packs the differences in blocks with their own bit width.
+/// The fragment header and the non-ADC bytes of the frames are kept verbatim.  The transform is lossless
+/// for any input; payloads that are not a whole number of frames are stored verbatim.
+class RADCTransform : public RStreamTransform {
+   RADCFrameLayout fLayout;
+   const char *fName;
+
+public:
+   /// Number of values that share a bit width in the packed output
+   static constexpr std::size_t kBlockSize = 128;
+
+   RADCTransform(const char *name, const RADCFrameLayout &layout) : fLayout(layout), fName(name) {}
+   const char *GetName() const final { return fName; }
+   void Encode(const std::byte *data, std::size_t size, std::vector<std::byte> &out) const final;
+   void Decode(const std::byte *data, std::size_t size, std::vector<std::byte> &out) const final;
+};
+
+/// Returns the ADC transform for WIBEth and DAPHNE streams and the identity transform otherwise
+const RStreamTransform &GetStreamTransform(TriggerRecord::EDataType type);
+
+#endif // ADC_CODEC_H_
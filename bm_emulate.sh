@@ -0,0 +1,93 @@
+#!/bin/sh
+
+die() {
+  echo "$1"
+  exit 1
+}
+
+usage() {
+  echo "$0 -p <physical dir> -m <hdd | http+<latency ms> | env> [-o <trace dir>] -- <command>"
+  echo "  runs the command with @MOUNT_DIR@ replaced by a fuse_forward mount of the"
+  echo "  physical directory that emulates the given storage medium; 'env' takes the"
+  echo "  model from the FF_EMU_* environment variables"
+}
+
+PHYS_DIR=
+MODEL=
+TRACE_DIR=
+
+while getopts "hvp:m:o:" option; do
+  case $option in
+    h)
+      usage
+      exit 0
+    ;;
+    v)
+      usage
+      exit 0
+    ;;
+    p)
+      PHYS_DIR=$OPTARG
+    ;;
+    m)
+      MODEL=$OPTARG
+    ;;
+    o)
+      TRACE_DIR=$OPTARG
+    ;;
+    ?)
+      usage
+      exit 1
+    ;;
+  esac
+done
+shift $(($OPTIND - 1))
+
+[ "x$PHYS_DIR" = "x" ] && die "physical directory missing"
+[ "x$MODEL" = "x" ] && die "storage model missing"
+
+# Rough device parameters; override with -m env and the FF_EMU_* variables
+case $MODEL in
+  hdd)
+    export FF_EMU_LATENCY_US=0
+    export FF_EMU_BANDWIDTH_MBS=150
+    export FF_EMU_SEEK_US_PER_GB=10000
+    export FF_EMU_SEEK_MAX_US=12000
+  ;;
+  http+*)
+    export FF_EMU_LATENCY_US=$((${MODEL#http+} * 1000))
+    export FF_EMU_BANDWIDTH_MBS=1000
+    export FF_EMU_SEEK_US_PER_GB=0
+    export FF_EMU_SEEK_MAX_US=0
+  ;;
+  env)
+  ;;
+  *)
+    die "unknown storage model: $MODEL"
+  ;;
+esac
+
+MOUNT_DIR=$(mktemp -d)
+LOG_DIR=$(mktemp -d)
+
+FF_PHYS_PATH=$(realpath $PHYS_DIR) FF_LOG_PATH=$LOG_DIR \
+  ./fuse_forward -f -o clone_fd $MOUNT_DIR &
+FF_PID=$!
+while ! mountpoint -q $MOUNT_DIR; do
+  kill -0 $FF_PID 2>/dev/null || die "fuse_forward failed"
+  sleep 0.1
+done
+
+CMD=$(echo "$@" | sed s,@MOUNT_DIR@,$MOUNT_DIR,g)
+$CMD
+RETVAL=$?
+
+fusermount3 -u $MOUNT_DIR
+wait $FF_PID
+rmdir $MOUNT_DIR
+if [ "x$TRACE_DIR" != "x" ]; then
+  mkdir -p $TRACE_DIR
+  mv $LOG_DIR/* $TRACE_DIR/
+fi
+rm -rf $LOG_DIR
+exit $RETVAL
@@ -42,15 +42,22 @@ shift $(($OPTIND - 1))
 MOUNT_DIR=$(mktemp -d)
 LOG_DIR=$(mktemp -d)
 
+# Foreground mode so that we can wait for the trace to be flushed after unmount
 FF_PHYS_PATH=$(dirname $WATCH_FILENAME) FF_LOG_PATH=$LOG_DIR \
-  ./fuse_forward $MOUNT_DIR
+  ./fuse_forward -f -o clone_fd $MOUNT_DIR &
+FF_PID=$!
+while ! mountpoint -q $MOUNT_DIR; do
+  kill -0 $FF_PID 2>/dev/null || die "fuse_forward failed"
+  sleep 0.1
+done
 echo "Interposition FS mounted on $MOUNT_DIR"
 
 CMD=$(echo "$@" | sed s,@MOUNT_DIR@,$MOUNT_DIR,g)
 echo "Running $CMD"
 $CMD
 
-fusermount -u $MOUNT_DIR
+fusermount3 -u $MOUNT_DIR
+wait $FF_PID
 rmdir $MOUNT_DIR
-mv $LOG_DIR/$(echo $WATCH_FILENAME | sed s,/,-,g) $OUTPUT_FILE
+./io_trace_dump $LOG_DIR/$(echo $WATCH_FILENAME | sed s,/,-,g) > $OUTPUT_FILE
 rm -rf $LOG_DIR
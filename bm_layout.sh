@@ -0,0 +1,23 @@
+#!/bin/bash
+
+# Combines result_layout_<medium>.<sample>+P<page>+C<cluster>~<compression>.ntuple.txt files
+# into lines "<medium> <sample> <page size> <cluster size> <compression> <timings...>"
+
+BM_FIELD=${BM_FIELD:-realtime}
+
+if [ -f $BM_OUTPUT ]; then
+  mv $BM_OUTPUT $BM_OUTPUT.save
+fi
+
+for result in $@; do
+  medium=$(echo $result | cut -d. -f1 | cut -d_ -f3)
+  sample=$(echo $result | cut -d. -f2 | cut -d+ -f1)
+  page=$(echo $result | sed -E -e 's/.*\+P([^+~]*).*/\1/')
+  cluster=$(echo $result | sed -E -e 's/.*\+C([^+~]*).*/\1/')
+  compression=$(echo $result | cut -d~ -f2 | cut -d. -f1)
+  header="$medium $sample $page $cluster $compression"
+  echo "$result --> $header"
+  grep "^${BM_FIELD}" $result | awk -v header="$header" \
+    '{ for(i=2; i<NF; i++) printf "%s",$i OFS; if(NF) printf "%s",$NF; printf ORS} BEGIN {printf "%s ", header}' \
+    >> $BM_OUTPUT
+done
@@ -0,0 +1,19 @@
+#!/bin/bash
+
+# Combines result_merge_<mode>.<sample>.txt files into lines "<mode> <sample> <timings...>"
+
+BM_FIELD=${BM_FIELD:-realtime}
+
+if [ -f $BM_OUTPUT ]; then
+  mv $BM_OUTPUT $BM_OUTPUT.save
+fi
+
+for result in $@; do
+  mode=$(echo $result | cut -d. -f1 | cut -d_ -f3)
+  sample=$(echo $result | cut -d. -f2)
+  header="$mode $sample"
+  echo "$result --> $header"
+  grep "^${BM_FIELD}" $result | awk -v header="$header" \
+    '{ for(i=2; i<NF; i++) printf "%s",$i OFS; if(NF) printf "%s",$NF; printf ORS} BEGIN {printf "%s ", header}' \
+    >> $BM_OUTPUT
+done
@@ -0,0 +1,73 @@
+#!/bin/sh
+
+# Compares download-then-process with process-while-downloading (-w) for one
+# analysis and one input file served by a local http_serve with the given latency.
+# Every iteration writes a line "<mode> <latency ms> <time to first event s> <total s>"
+# with the modes
+#   download:  curl the file, then process the local copy
+#   stream:    process the remote file, spilling fetched blocks into a local cache file
+#   spilled:   second streaming run, served from the spill file of the first one
+#   local:     process the file downloaded in the first mode from the local disk
+
+set -e
+
+BM_NITER=${BM_NITER:-6}
+BM_PORT=${BM_PORT:-8080}
+BM_OUTPUT=$(realpath -m $1)
+ANALYSIS=$(realpath $2)
+DATA_DIR=$(realpath $3)
+FILE_NAME=$4
+LATENCY=$5
+
+[ "x$LATENCY" = "x" ] && { echo "$0 <output> <analysis binary> <data dir> <file name> <latency ms>"; exit 1; }
+
+URL=http://localhost:$BM_PORT/$FILE_NAME
+WORK_DIR=$(mktemp -d)
+
+./http_serve -d $DATA_DIR -p $BM_PORT -l $LATENCY &
+SERVER_PID=$!
+trap "kill $SERVER_PID; rm -rf $WORK_DIR" EXIT
+sleep 1
+
+# Prints the time in seconds to the first event and in total, given the start
+# time in nanoseconds and the analysis output
+report() {
+  ts_start=$1
+  output=$2
+  ts_end=$(date +%s%N)
+  analysis_us=$(grep Runtime-Analysis: $output | awk '{print $2}' | tr -d us)
+  total=$(echo "($ts_end - $ts_start) / 1000000000" | bc -l)
+  first=$(echo "$total - $analysis_us / 1000000" | bc -l)
+  printf "%.3f %.3f\n" $first $total
+}
+
+rm -f $BM_OUTPUT
+this_output=$(mktemp)
+START_DIR=$(pwd)
+cd $WORK_DIR
+for i in $(seq 1 $BM_NITER); do
+  rm -rf $WORK_DIR/*
+
+  ts_start=$(date +%s%N)
+  curl -s -O $URL
+  $ANALYSIS -i $FILE_NAME > $this_output
+  echo "download $LATENCY $(report $ts_start $this_output)" | tee -a $BM_OUTPUT
+
+  # The streaming runs spill into their own directory, so that they do not pick up the downloaded copy
+  mkdir $WORK_DIR/stream
+  cd $WORK_DIR/stream
+  ts_start=$(date +%s%N)
+  $ANALYSIS -w -i $URL > $this_output
+  echo "stream $LATENCY $(report $ts_start $this_output)" | tee -a $BM_OUTPUT
+
+  ts_start=$(date +%s%N)
+  $ANALYSIS -w -i $URL > $this_output
+  echo "spilled $LATENCY $(report $ts_start $this_output)" | tee -a $BM_OUTPUT
+  cd $WORK_DIR
+
+  ts_start=$(date +%s%N)
+  $ANALYSIS -i $WORK_DIR/$FILE_NAME > $this_output
+  echo "local $LATENCY $(report $ts_start $this_output)" | tee -a $BM_OUTPUT
+done
+cd $START_DIR
+rm -f $this_output
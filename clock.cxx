@@ -1,5 +1,9 @@
+#include <ROOT/RCluster.hxx>
+#include <ROOT/RColumnElement.hxx>
+#include <ROOT/RNTupleDescriptor.hxx>
 #include <ROOT/RNTupleMetrics.hxx>
 #include <ROOT/RNTupleZip.hxx>
+#include <ROOT/RPageStorage.hxx>
 
 #include <TApplication.h>
 #include <TCanvas.h>
@@ -13,16 +17,25 @@
 #include <TSystem.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <ctime>
 #include <limits>
+#include <memory>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <unistd.h>
 
+#include "tsc_counter.h"
+#include "util.h"
+
 using RNTupleAtomicCounter = ROOT::Experimental::Detail::RNTupleAtomicCounter;
 using RNTupleAtomicTimer = ROOT::Experimental::Detail::RNTupleAtomicTimer;
 using RNTupleCompressor = ROOT::Experimental::Detail::RNTupleCompressor;
@@ -30,6 +43,12 @@ using RNTupleDecompressor = ROOT::Experimental::Detail::RNTupleDecompressor;
 using RNTupleMetrics = ROOT::Experimental::Detail::RNTupleMetrics;
 template<class T>
 using RNTupleTickCounter = ROOT::Experimental::Detail::RNTupleTickCounter<T>;
+using ROOT::Experimental::DescriptorId_t;
+using ROOT::Experimental::RNTupleDescriptor;
+using ROOT::Experimental::Internal::RCluster;
+using ROOT::Experimental::Internal::RColumnElementBase;
+using ROOT::Experimental::Internal::ROnDiskPage;
+using ROOT::Experimental::Internal::RPageSource;
 
 class ClockHist {
   std::string fName;
@@ -63,6 +82,15 @@ public:
     fTotal++;
   }
 
+  /// For counter back-ends without CPU time
+  void Fill(std::int64_t wall_ns) {
+    fMinWall = std::min(fMinWall, wall_ns);
+    fMaxWall = std::max(fMaxWall, wall_ns);
+    fSumWall += wall_ns;
+    fHWall->Fill(wall_ns);
+    fTotal++;
+  }
+
   void Draw() {
     fHWall->SetMaximum(fTotal * 2);
 
@@ -73,6 +101,11 @@ public:
     fHWall->GetXaxis()->SetTitle("Duration (ns)");
     fHWall->Draw();
 
+    if (fHCpu->GetEntries() == 0) {
+      printf("%-16s Wall[%ld - %ld] Sum = %ld\n", fName.c_str(), fMinWall, fMaxWall, fSumWall);
+      return;
+    }
+
     fHCpu->SetLineColor(kRed);
     fHCpu->SetFillColor(kRed);
     fHCpu->SetFillStyle(3001);
@@ -126,6 +159,43 @@ public:
   }
 };
 
+/// Like ClockHistRAII for the TSC counter, which has no CPU time
+class ClockHistTscRAII {
+  ClockHist &fClockHist;
+  RTscCounter &fCtr;
+  std::uint64_t fTicks;
+
+public:
+  ClockHistTscRAII(ClockHist &h, RTscCounter &c) : fClockHist(h), fCtr(c), fTicks(c.GetTicks()) {}
+
+  ~ClockHistTscRAII() {
+    fClockHist.Fill((fCtr.GetTicks() - fTicks) * RTscClock::GetNsPerTick());
+  }
+};
+
+/// Counter back-ends for the clock histograms: Measure() fills a histogram with the counter increments during
+/// its lifetime, Time() increments the counters during its lifetime
+class AtomicBackend {
+  RNTupleAtomicCounter &fCtrWall;
+  RNTupleTickCounter<RNTupleAtomicCounter> &fCtrCpu;
+
+public:
+  AtomicBackend(RNTupleAtomicCounter &w, RNTupleTickCounter<RNTupleAtomicCounter> &c) : fCtrWall(w), fCtrCpu(c) {}
+  ClockHistRAII Measure(ClockHist &h) { return ClockHistRAII(h, fCtrWall, fCtrCpu); }
+  RNTupleAtomicTimer Time() { return RNTupleAtomicTimer(fCtrWall, fCtrCpu); }
+};
+
+class TscBackend {
+  RTscCounter &fCtr;
+
+public:
+  explicit TscBackend(RTscCounter &c) : fCtr(c) {}
+  ClockHistTscRAII Measure(ClockHist &h) { return ClockHistTscRAII(h, fCtr); }
+  RTscTimer Time() { return RTscTimer(fCtr); }
+};
+
+constexpr int kNumBlocks = 1000;
+
 ClockHist *gHistNop = nullptr;
 ClockHist *gHistSin100 = nullptr;
 ClockHist *gHistUnzip = nullptr;
@@ -179,20 +249,431 @@ static void Show() {
 }
 
 
+/// Fills the clock histograms, timing every interval with the given counter back-end
+template <class BackendT>
+static void RunClock(BackendT &backend, double seed, bool use_identical_block, float *const *blocks,
+                     const std::uint32_t *blockSizes, int kNumValsPerBlock)
+{
+  // No-op
+  for (unsigned i = 0; i < 1000000; ++i) {
+    {
+      auto t = backend.Measure(*gHistNop);
+      {
+        auto timer = backend.Time();
+      }
+    }
+    ClobberMemory();
+  }
+  printf("No-op done\n");
+
+  // 100 times sine
+  double sine = seed;
+  for (unsigned i = 0; i < 1000000; ++i) {
+    {
+      auto t = backend.Measure(*gHistSin100);
+      {
+        auto timer = backend.Time();
+        sine = Compute(sine, 100);
+      }
+    }
+    ClobberMemory();
+  }
+  printf("100x sine result: %lf\n", sine);
+
+  // Decompress a block
+  float dummy = 0.0;
+  RNTupleDecompressor decompressor;
+  float *dest = new float[kNumValsPerBlock];
+  int blockIdx = gRandom->Uniform(kNumBlocks - 2) + 1;
+  for (unsigned i = 0; i < 100000; ++i) {
+    if (!use_identical_block)
+      blockIdx = gRandom->Uniform(kNumBlocks - 2) + 1;
+    {
+      auto t = backend.Measure(*gHistUnzip);
+      {
+        auto timer = backend.Time();
+        decompressor(blocks[blockIdx], blockSizes[blockIdx], kNumValsPerBlock * sizeof(float), dest);
+      }
+    }
+    dummy += dest[int(gRandom->Uniform(kNumValsPerBlock - 2) + 1)];
+
+    ClobberMemory();
+  }
+  printf("Decompression dummy result: %f\n", dummy);
+
+  // Decompress blocks: sum over 100 runs
+  for (unsigned i = 0; i < 1000; ++i) {
+    auto t = backend.Measure(*gHistUnzip100X);
+    for (unsigned j = 0; j < 100; ++j) {
+      if (!use_identical_block)
+        blockIdx = gRandom->Uniform(kNumBlocks - 2) + 1;
+      {
+        auto timer = backend.Time();
+        decompressor(blocks[blockIdx], blockSizes[blockIdx], kNumValsPerBlock * sizeof(float), dest);
+      }
+      dummy += dest[int(gRandom->Uniform(kNumValsPerBlock - 2) + 1)];
+      ClobberMemory();
+    } // 100x block
+  }
+  printf("Decompression Sum(100) dummy result: %f\n", dummy);
+}
+
+
+// Decompression matrix: codecs x levels x block sizes x data sources
+
+static std::int64_t GetThreadCpuNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return std::int64_t(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
+/// Gaussian floats like the blocks of the clock histograms
+static std::vector<unsigned char> MakeGaussPool(std::size_t size) {
+  std::vector<unsigned char> pool(size);
+  auto values = reinterpret_cast<float *>(pool.data());
+  for (std::size_t i = 0; i < size / sizeof(float); ++i)
+    values[i] = gRandom->Gaus();
+  return pool;
+}
+
+static void CollectColumnIds(const RNTupleDescriptor &desc, DescriptorId_t fieldId,
+                             std::vector<std::pair<DescriptorId_t, std::unique_ptr<RColumnElementBase>>> &columns)
+{
+  for (const auto &columnDesc : desc.GetColumnIterable(fieldId)) {
+    if (columnDesc.IsAliasColumn())
+      continue;
+    columns.emplace_back(columnDesc.GetPhysicalId(), RColumnElementBase::Generate(columnDesc.GetModel().GetType()));
+  }
+  for (const auto &fieldDesc : desc.GetFieldIterable(fieldId))
+    CollectColumnIds(desc, fieldDesc.GetId(), columns);
+}
+
+/// Concatenated uncompressed pages of the ntuple, cluster by cluster and column by column, up to maxSize bytes
+static std::vector<unsigned char> ReadNTuplePool(const std::string &path, const std::string &ntupleName,
+                                                 std::size_t maxSize)
+{
+  auto source = RPageSource::Create(ntupleName, path);
+  source->Attach();
+  auto desc = source->GetSharedDescriptorGuard()->Clone();
+  std::vector<std::pair<DescriptorId_t, std::unique_ptr<RColumnElementBase>>> columns;
+  CollectColumnIds(*desc, desc->GetFieldZeroId(), columns);
+  RCluster::ColumnSet_t columnSet;
+  for (const auto &column : columns)
+    columnSet.insert(column.first);
+
+  std::vector<unsigned char> pool;
+  RNTupleDecompressor decompressor;
+  for (const auto &clusterDesc : desc->GetClusterIterable()) {
+    RCluster::RKey key{clusterDesc.GetId(), columnSet};
+    auto cluster = std::move(source->LoadClusters({&key, 1})[0]);
+    for (const auto &[columnId, element] : columns) {
+      if (!clusterDesc.ContainsColumn(columnId))
+        continue;
+      std::uint64_t pageNo = 0;
+      for (const auto &pageInfo : clusterDesc.GetPageRange(columnId).fPageInfos) {
+        auto onDiskPage = cluster->GetOnDiskPage(ROnDiskPage::Key{columnId, pageNo++});
+        const auto packedSize = element->GetPackedSize(pageInfo.fNElements);
+        const std::size_t checksumSize = pageInfo.fHasChecksum ? sizeof(std::uint64_t) : 0;
+        const auto offset = pool.size();
+        pool.resize(offset + packedSize);
+        decompressor(onDiskPage->GetAddress(), onDiskPage->GetSize() - checksumSize, packedSize,
+                     pool.data() + offset);
+        if (pool.size() >= maxSize) {
+          pool.resize(maxSize);
+          return pool;
+        }
+      }
+    }
+  }
+  return pool;
+}
+
+/// The first nBlocks blocks of the pool, compressed one by one
+static std::vector<std::vector<unsigned char>> CompressBlocks(const std::vector<unsigned char> &pool,
+                                                              int compression, std::size_t blockSize,
+                                                              std::size_t nBlocks)
+{
+  RNTupleCompressor compressor;
+  std::vector<std::vector<unsigned char>> zipped(nBlocks);
+  for (std::size_t i = 0; i < nBlocks; ++i) {
+    const auto zippedSize = compressor(pool.data() + i * blockSize, blockSize, compression);
+    auto buffer = reinterpret_cast<const unsigned char *>(compressor.GetZipBuffer());
+    zipped[i].assign(buffer, buffer + zippedSize);
+  }
+  return zipped;
+}
+
+/// The generated Gaussian pool and, if given, the uncompressed pages of an ntuple
+static std::vector<std::pair<std::string, std::vector<unsigned char>>> LoadPools(const std::string &ntuplePath,
+                                                                                 const std::string &ntupleName)
+{
+  constexpr std::size_t kPoolSize = 64 * 1024 * 1024;
+  std::vector<std::pair<std::string, std::vector<unsigned char>>> sources;
+  sources.emplace_back("gauss", MakeGaussPool(kPoolSize));
+  if (!ntuplePath.empty())
+    sources.emplace_back(GetFileName(ntuplePath), ReadNTuplePool(ntuplePath, ntupleName, kPoolSize));
+  return sources;
+}
+
+struct MatrixResult {
+  double fRatio;
+  double fGBps;
+  double fMeanWallNs;
+  double fMedianWallNs;
+  double fP99WallNs;
+  double fMeanCpuNs;
+};
+
+/**
+ * Compresses the pool in blocks of the given size and decompresses every block kNumRounds times,
+ * timing each block individually.  The latency distributions are stored as a ClockHist.
+ */
+static MatrixResult RunMatrixCell(const std::vector<unsigned char> &pool, int compression, std::size_t blockSize,
+                                  const std::string &name)
+{
+  constexpr int kNumRounds = 5;
+  constexpr std::size_t kMaxBlocks = 1000;
+  const std::size_t nBlocks = std::min(kMaxBlocks, pool.size() / blockSize);
+
+  const auto zipped = CompressBlocks(pool, compression, blockSize, nBlocks);
+  std::uint64_t zippedTotal = 0;
+  for (const auto &z : zipped)
+    zippedTotal += z.size();
+
+  RNTupleDecompressor decompressor;
+  std::vector<unsigned char> dest(blockSize);
+  std::vector<std::int64_t> wall;
+  std::vector<std::int64_t> cpu;
+  wall.reserve(kNumRounds * nBlocks);
+  cpu.reserve(kNumRounds * nBlocks);
+  for (int r = 0; r < kNumRounds; ++r) {
+    for (std::size_t i = 0; i < nBlocks; ++i) {
+      const auto cpuStart = GetThreadCpuNs();
+      const auto wallStart = std::chrono::steady_clock::now();
+      decompressor(zipped[i].data(), zipped[i].size(), blockSize, dest.data());
+      const auto wallEnd = std::chrono::steady_clock::now();
+      cpu.emplace_back(GetThreadCpuNs() - cpuStart);
+      wall.emplace_back(std::chrono::duration_cast<std::chrono::nanoseconds>(wallEnd - wallStart).count());
+      ClobberMemory();
+    }
+  }
+
+  std::vector<std::int64_t> sorted(wall);
+  std::sort(sorted.begin(), sorted.end());
+  std::int64_t sumWall = 0;
+  std::int64_t sumCpu = 0;
+  for (std::size_t i = 0; i < wall.size(); ++i) {
+    sumWall += wall[i];
+    sumCpu += cpu[i];
+  }
+
+  auto hist = new ClockHist(name, 0, 2 * sorted[sorted.size() * 99 / 100] + 1);
+  for (std::size_t i = 0; i < wall.size(); ++i)
+    hist->Fill(wall[i], cpu[i]);
+  hist->Write();
+
+  MatrixResult result;
+  result.fRatio = double(nBlocks * blockSize) / zippedTotal;
+  result.fGBps = double(kNumRounds * nBlocks * blockSize) / sumWall;
+  result.fMeanWallNs = double(sumWall) / wall.size();
+  result.fMedianWallNs = sorted[sorted.size() / 2];
+  result.fP99WallNs = sorted[sorted.size() * 99 / 100];
+  result.fMeanCpuNs = double(sumCpu) / cpu.size();
+  return result;
+}
+
+static int RunMatrix(const std::string &output, const std::vector<std::string> &codecs,
+                     const std::vector<std::string> &levels, const std::vector<std::string> &blockSizesKiB,
+                     const std::string &ntuplePath, const std::string &ntupleName)
+{
+  const auto sources = LoadPools(ntuplePath, ntupleName);
+
+  auto f = TFile::Open(output.c_str(), "RECREATE");
+  f->cd();
+  printf("%-24s %-8s %5s %8s %8s %10s %10s %10s %10s %8s\n", "source", "codec", "level", "block", "ratio",
+         "mean [us]", "median", "p99", "cpu [us]", "GB/s");
+  for (const auto &[sourceName, pool] : sources) {
+    for (const auto &blockSizeStr : blockSizesKiB) {
+      const std::size_t blockSize = std::stoul(blockSizeStr) * 1024;
+      if (pool.size() < blockSize) {
+        printf("%-24s skipping %s KiB blocks, only %zu bytes of data\n", sourceName.c_str(), blockSizeStr.c_str(),
+               pool.size());
+        continue;
+      }
+      for (const auto &codec : codecs) {
+        // The algorithm part of the compression settings, e.g. 500 for zstd
+        const int algorithm = GetCompressionSettings(codec) / 100 * 100;
+        for (const auto &level : levels) {
+          const int compression = algorithm + std::stoi(level);
+          const auto name = sourceName + " " + codec + "-" + level + " " + blockSizeStr + "KiB";
+          auto r = RunMatrixCell(pool, compression, blockSize, name);
+          printf("%-24s %-8s %5s %6sKi %8.2f %10.2f %10.2f %10.2f %10.2f %8.2f\n", sourceName.c_str(), codec.c_str(),
+                 level.c_str(), blockSizeStr.c_str(), r.fRatio, r.fMeanWallNs / 1000., r.fMedianWallNs / 1000.,
+                 r.fP99WallNs / 1000., r.fMeanCpuNs / 1000., r.fGBps);
+        }
+      }
+    }
+  }
+  f->Close();
+  return 0;
+}
+
+
+
+// Decompression scaling: the blocks of a pool decompressed by 1..N threads concurrently
+
+struct ScalingResult {
+  double fGBps;
+  double fMeanWallNs;
+  double fMedianWallNs;
+  double fP99WallNs;
+};
+
+/**
+ * Every thread decompresses all blocks kNumRounds times with its own decompressor and destination buffer.  The
+ * threads start at different blocks so that they do not read the same compressed block at the same time.
+ * The latency distribution over all threads is stored as a ClockHist.
+ */
+static ScalingResult RunScalingCell(const std::vector<std::vector<unsigned char>> &zipped, std::size_t blockSize,
+                                    unsigned nThreads, const std::string &name)
+{
+  constexpr int kNumRounds = 5;
+  const std::size_t nBlocks = zipped.size();
+
+  std::vector<std::vector<std::int64_t>> wallPerThread(nThreads);
+  std::atomic<unsigned> nReady{0};
+  std::atomic<bool> go{false};
+  auto worker = [&](unsigned t) {
+    RNTupleDecompressor decompressor;
+    std::vector<unsigned char> dest(blockSize);
+    auto &wall = wallPerThread[t];
+    wall.reserve(kNumRounds * nBlocks);
+    const std::size_t firstBlock = t * nBlocks / nThreads;
+    nReady++;
+    while (!go.load(std::memory_order_acquire))
+      std::this_thread::yield();
+
+    for (int r = 0; r < kNumRounds; ++r) {
+      for (std::size_t j = 0; j < nBlocks; ++j) {
+        const auto &block = zipped[(firstBlock + j) % nBlocks];
+        const auto wallStart = std::chrono::steady_clock::now();
+        decompressor(block.data(), block.size(), blockSize, dest.data());
+        const auto wallEnd = std::chrono::steady_clock::now();
+        wall.emplace_back(std::chrono::duration_cast<std::chrono::nanoseconds>(wallEnd - wallStart).count());
+        ClobberMemory();
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < nThreads; ++t)
+    threads.emplace_back(worker, t);
+  while (nReady < nThreads)
+    std::this_thread::yield();
+  const auto tsStart = std::chrono::steady_clock::now();
+  go.store(true, std::memory_order_release);
+  for (auto &t : threads)
+    t.join();
+  const auto tsEnd = std::chrono::steady_clock::now();
+
+  std::vector<std::int64_t> sorted;
+  sorted.reserve(nThreads * kNumRounds * nBlocks);
+  for (const auto &wall : wallPerThread)
+    sorted.insert(sorted.end(), wall.begin(), wall.end());
+  std::int64_t sumWall = 0;
+  for (auto w : sorted)
+    sumWall += w;
+  std::sort(sorted.begin(), sorted.end());
+
+  auto hist = new ClockHist(name, 0, 2 * sorted[sorted.size() * 99 / 100] + 1);
+  for (auto w : sorted)
+    hist->Fill(w);
+  hist->Write();
+
+  const auto elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(tsEnd - tsStart).count();
+  ScalingResult result;
+  result.fGBps = double(sorted.size() * blockSize) / elapsedNs;
+  result.fMeanWallNs = double(sumWall) / sorted.size();
+  result.fMedianWallNs = sorted[sorted.size() / 2];
+  result.fP99WallNs = sorted[sorted.size() * 99 / 100];
+  return result;
+}
+
+/// Runs 1, 2, 4, ... threads up to maxThreads for every combination of data source, block size, codec and level
+static int RunScaling(const std::string &output, const std::vector<std::string> &codecs,
+                      const std::vector<std::string> &levels, const std::vector<std::string> &blockSizesKiB,
+                      const std::string &ntuplePath, const std::string &ntupleName, unsigned maxThreads)
+{
+  std::vector<unsigned> threadCounts;
+  for (unsigned n = 1; n < maxThreads; n *= 2)
+    threadCounts.emplace_back(n);
+  threadCounts.emplace_back(maxThreads);
+
+  const auto sources = LoadPools(ntuplePath, ntupleName);
+
+  auto f = TFile::Open(output.c_str(), "RECREATE");
+  f->cd();
+  printf("%-24s %-8s %5s %8s %7s %8s %8s %10s %10s %10s %9s\n", "source", "codec", "level", "block", "threads",
+         "GB/s", "speedup", "mean [us]", "median", "p99", "inflation");
+  for (const auto &[sourceName, pool] : sources) {
+    for (const auto &blockSizeStr : blockSizesKiB) {
+      const std::size_t blockSize = std::stoul(blockSizeStr) * 1024;
+      if (pool.size() < blockSize) {
+        printf("%-24s skipping %s KiB blocks, only %zu bytes of data\n", sourceName.c_str(), blockSizeStr.c_str(),
+               pool.size());
+        continue;
+      }
+      for (const auto &codec : codecs) {
+        const int algorithm = GetCompressionSettings(codec) / 100 * 100;
+        for (const auto &level : levels) {
+          const int compression = algorithm + std::stoi(level);
+          const auto zipped = CompressBlocks(pool, compression, blockSize, pool.size() / blockSize);
+          const auto name = sourceName + " " + codec + "-" + level + " " + blockSizeStr + "KiB";
+          ScalingResult single;
+          for (auto nThreads : threadCounts) {
+            auto r = RunScalingCell(zipped, blockSize, nThreads, name + " " + std::to_string(nThreads) + "T");
+            if (nThreads == 1)
+              single = r;
+            // Latency inflation: median block latency relative to the single-threaded run
+            printf("%-24s %-8s %5s %6sKi %7u %8.2f %8.2f %10.2f %10.2f %10.2f %9.2f\n", sourceName.c_str(),
+                   codec.c_str(), level.c_str(), blockSizeStr.c_str(), nThreads, r.fGBps, r.fGBps / single.fGBps,
+                   r.fMeanWallNs / 1000., r.fMedianWallNs / 1000., r.fP99WallNs / 1000.,
+                   r.fMedianWallNs / single.fMedianWallNs);
+          }
+        }
+      }
+    }
+  }
+  f->Close();
+  return 0;
+}
+
 static void Usage(const char *progname) {
   printf("%s [-s random seed] [-o output file] [-b <block size in kB, defaults to 10kB>] "
-         "[-i(identical block for decompression)] [-s(how)]\n",
-         progname);
+         "[-i(identical block for decompression)] [-t(sc counters)] [-s(how)]\n"
+         "%s -m(atrix) [-o output file] [-c <codecs (lz4,zlib,lzma,zstd)>] [-l <levels (1,5,9)>] "
+         "[-k <block sizes in KiB (4,16,64,256,1024)>] [-n <ntuple file> [-N <ntuple name (Events)>]]\n"
+         "%s -j <max threads> [-o output file] [-c <codecs (zstd)>] [-l <levels (5)>] [-k <block sizes in KiB (64)>] "
+         "[-n <ntuple file> [-N <ntuple name (Events)>]]\n",
+         progname, progname, progname);
 }
 
 int main(int argc, char **argv) {
   bool show = false;
   bool use_identical_block = false;
+  bool matrix = false;
+  bool use_tsc = false;
+  unsigned maxThreads = 0;
+  std::string codecs;
+  std::string levels;
+  std::string blockSizesKiB;
+  std::string ntuplePath;
+  std::string ntupleName = "Events";
   std::string output = "clock.root";
   double seed = 42.0;
   int blockSize = 10000;
   int c;
-  while ((c = getopt(argc, argv, "hvr:o:b:is")) != -1) {
+  while ((c = getopt(argc, argv, "hvr:o:b:istmj:c:l:k:n:N:")) != -1) {
     switch (c) {
     case 'h':
     case 'v':
@@ -213,6 +694,30 @@ int main(int argc, char **argv) {
     case 's':
       show = true;
       break;
+    case 't':
+      use_tsc = true;
+      break;
+    case 'm':
+      matrix = true;
+      break;
+    case 'j':
+      maxThreads = std::max(1, atoi(optarg));
+      break;
+    case 'c':
+      codecs = optarg;
+      break;
+    case 'l':
+      levels = optarg;
+      break;
+    case 'k':
+      blockSizesKiB = optarg;
+      break;
+    case 'n':
+      ntuplePath = optarg;
+      break;
+    case 'N':
+      ntupleName = optarg;
+      break;
     default:
       fprintf(stderr, "Unknown option: -%c\n", c);
       Usage(argv[0]);
@@ -220,11 +725,34 @@ int main(int argc, char **argv) {
     }
   }
 
+  if (maxThreads > 0) {
+    gRandom->SetSeed(seed);
+    return RunScaling(output, SplitString(codecs.empty() ? "zstd" : codecs, ','),
+                      SplitString(levels.empty() ? "5" : levels, ','),
+                      SplitString(blockSizesKiB.empty() ? "64" : blockSizesKiB, ','), ntuplePath, ntupleName,
+                      maxThreads);
+  }
+
+  if (matrix) {
+    if (codecs.empty())
+      codecs = "lz4,zlib,lzma,zstd";
+    if (levels.empty())
+      levels = "1,5,9";
+    if (blockSizesKiB.empty())
+      blockSizesKiB = "4,16,64,256,1024";
+    gRandom->SetSeed(seed);
+    return RunMatrix(output, SplitString(codecs, ','), SplitString(levels, ','), SplitString(blockSizesKiB, ','),
+                     ntuplePath, ntupleName);
+  }
+
   printf("Clock information: clock() = %ld    CLOCKS_PER_SEC = %ld\n", clock(), CLOCKS_PER_SEC);
 
   std::string blockSizeStr = std::to_string(blockSize / 1000) + "kB";
 
-  gHistNop = new ClockHist("no-op", 0, 1200);                                             // [0 - 1.2us]
+  if (use_tsc)
+    gHistNop = new ClockHist("no-op", 0, 120);                                            // [0 - 120ns]
+  else
+    gHistNop = new ClockHist("no-op", 0, 1200);                                           // [0 - 1.2us]
   gHistSin100 = new ClockHist("100X sine", 0, 10000);                                     // [0 - 10us]
   gHistUnzip = new ClockHist(blockSizeStr + " u-zstd", 0.8 * blockSize, 6.4 * blockSize); // ~10us for 10kB
   gHistUnzip100X =
@@ -234,7 +762,6 @@ int main(int argc, char **argv) {
   // Prepare compressed blocks
   gRandom->SetSeed(seed);
   RNTupleCompressor compressor;
-  constexpr int kNumBlocks = 1000;
   int kNumValsPerBlock = blockSize / sizeof(float);
   float *blocks[kNumBlocks];
   std::uint32_t blockSizes[kNumBlocks];
@@ -250,73 +777,20 @@ int main(int argc, char **argv) {
   printf("Compressed memory blocks ready\n");
 
   RNTupleMetrics metrics("metrics");
-  auto ctrWall = metrics.MakeCounter<RNTupleAtomicCounter*>("timeWall", "ns", "Wall time counter");
-  auto ctrCpu = metrics.MakeCounter<ROOT::Experimental::Detail::RNTupleTickCounter<RNTupleAtomicCounter>*>(
-    "timeCpu", "ns", "CPU time counter");
-  metrics.Enable();
-
-  // No-op
-  for (unsigned i = 0; i < 1000000; ++i) {
-    {
-      ClockHistRAII t(*gHistNop, *ctrWall, *ctrCpu);
-      {
-        RNTupleAtomicTimer timer(*ctrWall, *ctrCpu);
-      }
-    }
-    ClobberMemory();
+  if (use_tsc) {
+    auto ctrTsc = metrics.MakeCounter<RTscCounter*>("timeTsc", "ns", "TSC wall time counter");
+    metrics.Enable();
+    printf("TSC: %lf ns per tick\n", RTscClock::GetNsPerTick());
+    TscBackend backend(*ctrTsc);
+    RunClock(backend, seed, use_identical_block, blocks, blockSizes, kNumValsPerBlock);
+  } else {
+    auto ctrWall = metrics.MakeCounter<RNTupleAtomicCounter*>("timeWall", "ns", "Wall time counter");
+    auto ctrCpu = metrics.MakeCounter<ROOT::Experimental::Detail::RNTupleTickCounter<RNTupleAtomicCounter>*>(
+      "timeCpu", "ns", "CPU time counter");
+    metrics.Enable();
+    AtomicBackend backend(*ctrWall, *ctrCpu);
+    RunClock(backend, seed, use_identical_block, blocks, blockSizes, kNumValsPerBlock);
   }
-  printf("No-op done\n");
-
-  // 100 times sine
-  double sine = seed;
-  for (unsigned i = 0; i < 1000000; ++i) {
-    {
-      ClockHistRAII t(*gHistSin100, *ctrWall, *ctrCpu);
-      {
-        RNTupleAtomicTimer timer(*ctrWall, *ctrCpu);
-        sine = Compute(sine, 100);
-      }
-    }
-    ClobberMemory();
-  }
-  printf("100x sine result: %lf\n", sine);
-
-  // Decompress a block
-  float dummy = 0.0;
-  RNTupleDecompressor decompressor;
-  float *dest = new float[kNumValsPerBlock];
-  int blockIdx = gRandom->Uniform(kNumBlocks - 2) + 1;
-  for (unsigned i = 0; i < 100000; ++i) {
-    if (!use_identical_block)
-      blockIdx = gRandom->Uniform(kNumBlocks - 2) + 1;
-    {
-      ClockHistRAII t(*gHistUnzip, *ctrWall, *ctrCpu);
-      {
-        RNTupleAtomicTimer timer(*ctrWall, *ctrCpu);
-        decompressor(blocks[blockIdx], blockSizes[blockIdx], kNumValsPerBlock * sizeof(float), dest);
-      }
-    }
-    dummy += dest[int(gRandom->Uniform(kNumValsPerBlock - 2) + 1)];
-
-    ClobberMemory();
-  }
-  printf("Decompression dummy result: %f\n", dummy);
-
-  // Decompress blocks: sum over 100 runs
-  for (unsigned i = 0; i < 1000; ++i) {
-    ClockHistRAII t(*gHistUnzip100X, *ctrWall, *ctrCpu);
-    for (unsigned j = 0; j < 100; ++j) {
-      if (!use_identical_block)
-        blockIdx = gRandom->Uniform(kNumBlocks - 2) + 1;
-      {
-        RNTupleAtomicTimer timer(*ctrWall, *ctrCpu);
-        decompressor(blocks[blockIdx], blockSizes[blockIdx], kNumValsPerBlock * sizeof(float), dest);
-      }
-      dummy += dest[int(gRandom->Uniform(kNumValsPerBlock - 2) + 1)];
-      ClobberMemory();
-    } // 100x block
-  }
-  printf("Decompression Sum(100) dummy result: %f\n", dummy);
 
   if (show)
     Show();
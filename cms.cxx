@@ -27,10 +27,12 @@
 #include <vector>
 #include <utility>
 
+#include "spill_file.h"
 #include "util.h"
 
 bool g_perf_stats = false;
 bool g_show = false;
+bool g_stream = false;
 unsigned int g_cluster_bunch_size = 1;
 
 static ROOT::Experimental::RNTupleReadOptions GetRNTupleOptions() {
@@ -77,7 +79,7 @@ static void Show(TH1D *h) {
 static void TreeDirect(const std::string &path) {
    auto ts_init = std::chrono::steady_clock::now();
 
-   auto file = OpenOrDownload(path);
+   auto file = g_stream ? OpenOrStream(path) : OpenOrDownload(path);
    auto tree = file->Get<TTree>("Events");
    TTreePerfStats *ps = nullptr;
    if (g_perf_stats)
@@ -166,13 +168,15 @@ static void NTupleDirect(const std::string &path) {
    using RNTupleReader = ROOT::Experimental::RNTupleReader;
 
    // Trigger download if needed.
-   delete OpenOrDownload(path);
+   if (!g_stream)
+      delete OpenOrDownload(path);
 
    auto ts_init = std::chrono::steady_clock::now();
 
    auto model = RNTupleModel::Create();
    auto options = GetRNTupleOptions();
-   auto ntuple = RNTupleReader::Open(std::move(model), "Events", path, options);
+   auto ntuple = g_stream ? OpenNTupleOrStream(std::move(model), "Events", path, options)
+                          : RNTupleReader::Open(std::move(model), "Events", path, options);
    if (g_perf_stats)
       ntuple->EnableMetrics();
 
@@ -281,7 +285,8 @@ static void Rdf(ROOT::RDataFrame &df) {
 
 
 static void Usage(const char *progname) {
-  printf("%s [-i input.root/ntuple] [-r(df)] [-m(t)] [-s(show)] [-p(erformance stats)] [-x cluster bunch size]\n",
+  printf("%s [-i input.root/ntuple] [-r(df)] [-m(t)] [-s(show)] [-p(erformance stats)] [-x cluster bunch size]\n"
+         "   [-w (process while downloading)]\n",
          progname);
 }
 
@@ -291,7 +296,7 @@ int main(int argc, char **argv) {
    bool use_rdf = false;
    std::string path;
    int c;
-   while ((c = getopt(argc, argv, "hvsrpmi:x:")) != -1) {
+   while ((c = getopt(argc, argv, "hvsrpmi:x:w")) != -1) {
       switch (c) {
       case 'h':
       case 'v':
@@ -315,6 +320,9 @@ int main(int argc, char **argv) {
       case 'x':
          g_cluster_bunch_size = atoi(optarg);
          break;
+      case 'w':
+         g_stream = true;
+         break;
       default:
          fprintf(stderr, "Unknown option: -%c\n", c);
          Usage(argv[0]);
@@ -49,6 +49,13 @@ function test_gen_cms() {
 				    ${GEN_CMS_PARQUET} -i ${PATH_HIGGS4LEPTONS} -o ${BASE_PATH_CMS[$i]}/higgs4leptons~${COMPRESSION}.parquet -c ${COMPRESSION} -s ${PARQUET_CHUNK_SIZE})
     done
     echo Parquet ${RESULTS[HDD]} ${RESULTS[SSD]} ${RESULTS[CephFS]}
+
+    # Parquet, column batches appended in bulk; writes the same file as above
+    for i in SSD CephFS HDD; do
+	RESULTS[$i]=$(LogAndGetTime gen_cms_parquet_bulk.log \
+				    ${GEN_CMS_PARQUET} -i ${PATH_HIGGS4LEPTONS} -o ${BASE_PATH_CMS[$i]}/higgs4leptons~${COMPRESSION}.parquet -c ${COMPRESSION} -s ${PARQUET_CHUNK_SIZE} -b)
+    done
+    echo Parquet/bulk ${RESULTS[HDD]} ${RESULTS[SSD]} ${RESULTS[CephFS]}
 }
 
 function test_cms_10br() {
@@ -3,7 +3,7 @@ source ./benchmark_common.sh
 
 # * NOTE: adjust these values before running the benchmark
 CLEAR_PAGE_CACHE=../clear_page_cache
-GEN_LHCB=../gen_lhcb
+GEN_LHCB=../gen_ntuple
 GEN_LHCB_H5_ROW=./gen_lhcb_h5_row
 GEN_LHCB_H5_COLUMN=./gen_lhcb_h5_column
 GEN_LHCB_PARQUET=./gen_lhcb_parquet
@@ -11,6 +11,7 @@ LHCB=../lhcb
 LHCB_H5_ROW=./lhcb_h5_row
 LHCB_H5_COLUMN=./lhcb_h5_column
 LHCB_PARQUET=./lhcb_parquet
+LHCB_BATCH=./lhcb_batch
 
 COMPRESSION=zstd
 H5_COMPRESSIONLEVEL=3
@@ -48,6 +49,13 @@ function test_gen_lhcb() {
 				    ${GEN_LHCB_PARQUET} -i ${PATH_B2HHH_NONE} -o ${BASE_PATH_LHCB[$i]}/B2HHH~${COMPRESSION}.parquet -c ${COMPRESSION} -s ${PARQUET_CHUNK_SIZE})
     done
     echo Parquet ${RESULTS[HDD]} ${RESULTS[SSD]} ${RESULTS[CephFS]}
+
+    # Parquet, column batches appended in bulk; writes the same file as above
+    for i in SSD CephFS HDD; do
+	RESULTS[$i]=$(LogAndGetTime gen_lhcb_parquet_bulk.log \
+				    ${GEN_LHCB_PARQUET} -i ${PATH_B2HHH_NONE} -o ${BASE_PATH_LHCB[$i]}/B2HHH~${COMPRESSION}.parquet -c ${COMPRESSION} -s ${PARQUET_CHUNK_SIZE} -b)
+    done
+    echo Parquet/bulk ${RESULTS[HDD]} ${RESULTS[SSD]} ${RESULTS[CephFS]}
 }
 
 function test_lhcb() {
@@ -94,6 +102,25 @@ function test_lhcb() {
     echo -e "Parquet\t ${RESULTS[HDD]}\t${RESULTS[SSD]}\t${RESULTS[CephFS]}\t${RESULTS[warmCache]}"
 }
 
+# Same analysis kernel on all formats, through the column batch reader
+function test_lhcb_batch() {
+    declare -A RESULTS
+
+    for format in "TTree B2HHH~${COMPRESSION}.root" \
+		  "RNTuple B2HHH~${COMPRESSION}.ntuple" \
+		  "HDF5/row-wise B2HHH_row~${H5_COMPRESSIONLEVEL}.h5" \
+		  "HDF5/column-wise B2HHH_col~${H5_COMPRESSIONLEVEL}.h5" \
+		  "Parquet B2HHH~${COMPRESSION}.parquet"; do
+	set -- $format
+	for i in SSD CephFS HDD warmCache; do
+	    if [ $i != warmCache ]; then ${CLEAR_PAGE_CACHE}; fi
+	    RESULTS[$i]=$(LogAndGetRuntimeAnalysis lhcb_batch.log \
+						   ${LHCB_BATCH} -i ${BASE_PATH_LHCB[$i]}/$2)
+	done
+	echo -e "$1\t ${RESULTS[HDD]}\t${RESULTS[SSD]}\t${RESULTS[CephFS]}\t${RESULTS[warmCache]}"
+    done
+}
+
 echo "==== gen_lhcb TESTS START ===="
 echo -e "\t HDD\tSSD\tCephFS"
 test_gen_lhcb;
@@ -101,3 +128,7 @@ test_gen_lhcb;
 echo "==== lhcb TESTS START ===="
 echo -e "\t HDD\tSSD\tCephFS\twarmCache"
 test_lhcb;
+
+echo "==== lhcb_batch TESTS START ===="
+echo -e "\t HDD\tSSD\tCephFS\twarmCache"
+test_lhcb_batch;
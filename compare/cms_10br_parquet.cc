@@ -1,8 +1,5 @@
 #include "util_arrow.h"
 
-#include <arrow/io/api.h>
-#include <parquet/arrow/reader.h>
-
 #include <cassert>
 #include <chrono>
 #include <cstdio>
@@ -41,13 +38,7 @@ int main(int argc, char **argv) {
 
   auto ts_init = std::chrono::steady_clock::now();
 
-  std::shared_ptr<arrow::io::ReadableFile> infile;
-  PARQUET_ASSIGN_OR_THROW(infile,
-			  arrow::io::ReadableFile::Open(inputPath));
-  std::unique_ptr<parquet::arrow::FileReader> reader;
-  PARQUET_THROW_NOT_OK(parquet::arrow::OpenFile(infile, arrow::default_memory_pool(),
-						&reader));
-  reader->set_use_threads(true);
+  auto reader = OpenParquetFile(inputPath);
 
   std::shared_ptr<arrow::Schema> schema;
   reader->GetSchema(&schema);
@@ -60,43 +51,48 @@ int main(int argc, char **argv) {
   //				   "MET_pt",
   //				   /*"nJet",*/ "Jet_pt.list.item", "Jet_eta.list.item", "Jet_phi.list.item", "Jet_mass.list.item", "Jet_btag.list.item"});
   std::vector<int> columns{11, 12, 60, 67, 68, 69, 70, 72};
-  std::shared_ptr<arrow::Table> table;
 
   std::chrono::steady_clock::time_point ts_first = std::chrono::steady_clock::now();
   size_t count = 0;
-  for (size_t row_group = 0, num_row_groups = reader->num_row_groups();
-       row_group < num_row_groups; ++row_group) {
+  float sum = 0;
+  // Row group N+1 is read in the background while row group N is processed
+  RowGroupPrefetcher prefetcher(reader.get(), columns);
+  while (auto table = prefetcher.Next()) {
     printf("processed %lu k events\n", count / 1000);
 
-    reader->ReadRowGroup(row_group, columns, &table);
     //std::cout << table->ToString();
-    assert(table->GetColumnByName("Muon_eta")->num_chunks() == 1);
-    assert(table->GetColumnByName("Muon_phi")->num_chunks() == 1);
-    assert(table->GetColumnByName("MET_pt")->num_chunks() == 1);
-    assert(table->GetColumnByName("Jet_pt")->num_chunks() == 1);
-    assert(table->GetColumnByName("Jet_eta")->num_chunks() == 1);
-    assert(table->GetColumnByName("Jet_phi")->num_chunks() == 1);
-    assert(table->GetColumnByName("Jet_mass")->num_chunks() == 1);
-    assert(table->GetColumnByName("Jet_btag")->num_chunks() == 1);
+    // Offsets of the muon and jet collections; the item values are contiguous
+    // in the child array of each list
+    auto Muon_eta = GetListArray(table, "Muon_eta");
+    auto Muon_phi = GetListArray(table, "Muon_phi");
+    auto MET_pt = GetRawValues<FloatArray>(table, "MET_pt");
+    auto Jet_pt = GetListArray(table, "Jet_pt");
+    auto Jet_eta = GetListArray(table, "Jet_eta");
+    auto Jet_phi = GetListArray(table, "Jet_phi");
+    auto Jet_mass = GetListArray(table, "Jet_mass");
+    auto Jet_btag = GetListArray(table, "Jet_btag");
 
-    auto Muon_eta = std::static_pointer_cast<FloatArray>(table->GetColumnByName("Muon_eta")->chunk(0));
-    auto Muon_phi = std::static_pointer_cast<FloatArray>(table->GetColumnByName("Muon_phi")->chunk(0));
-    auto MET_pt = std::static_pointer_cast<FloatArray>(table->GetColumnByName("MET_pt")->chunk(0));
-    auto Jet_pt = std::static_pointer_cast<FloatArray>(table->GetColumnByName("Jet_pt")->chunk(0));
-    auto Jet_eta = std::static_pointer_cast<FloatArray>(table->GetColumnByName("Jet_eta")->chunk(0));
-    auto Jet_phi = std::static_pointer_cast<FloatArray>(table->GetColumnByName("Jet_phi")->chunk(0));
-    auto Jet_mass = std::static_pointer_cast<FloatArray>(table->GetColumnByName("Jet_mass")->chunk(0));
-    auto Jet_btag = std::static_pointer_cast<FloatArray>(table->GetColumnByName("Jet_btag")->chunk(0));
+    auto muonOffsets = Muon_eta->raw_value_offsets();
+    auto jetOffsets = Jet_pt->raw_value_offsets();
+    auto items = [](const std::shared_ptr<arrow::ListArray> &list) {
+      return std::static_pointer_cast<FloatArray>(list->values())->raw_values();
+    };
+    auto Muon_eta_items = items(Muon_eta);
+    auto Muon_phi_items = items(Muon_phi);
+    auto Jet_pt_items = items(Jet_pt);
+    auto Jet_eta_items = items(Jet_eta);
+    auto Jet_phi_items = items(Jet_phi);
+    auto Jet_mass_items = items(Jet_mass);
+    auto Jet_btag_items = items(Jet_btag);
 
-    for (int64_t i = 0; i < table->num_rows(); ++i) {
-      (void)Muon_eta->Value(i);
-      (void)Muon_phi->Value(i);
-      (void)MET_pt->Value(i);
-      (void)Jet_pt->Value(i);
-      (void)Jet_eta->Value(i);
-      (void)Jet_phi->Value(i);
-      (void)Jet_mass->Value(i);
-      (void)Jet_btag->Value(i);
+    for (int64_t i = 0, num_rows = table->num_rows(); i < num_rows; ++i) {
+      for (auto j = muonOffsets[i]; j < muonOffsets[i + 1]; ++j)
+        sum += Muon_eta_items[j] + Muon_phi_items[j];
+      sum += MET_pt[i];
+      for (auto j = jetOffsets[i]; j < jetOffsets[i + 1]; ++j) {
+        sum += Jet_pt_items[j] + Jet_eta_items[j] + Jet_phi_items[j] +
+               Jet_mass_items[j] + Jet_btag_items[j];
+      }
     }
     count += table->num_rows();
   }
@@ -104,6 +100,10 @@ int main(int argc, char **argv) {
   auto runtime_init = std::chrono::duration_cast<std::chrono::microseconds>(ts_first - ts_init).count();
   auto runtime_analyze = std::chrono::duration_cast<std::chrono::microseconds>(ts_end - ts_first).count();
 
+  // Keep the reads from being optimized away
+  volatile float sink = sum;
+  (void)sink;
+
   std::cout << "Runtime-Initialization: " << runtime_init << "us" << std::endl;
   std::cout << "Runtime-Analysis: " << runtime_analyze << "us" << std::endl;
 
@@ -0,0 +1,21 @@
+#include "column_batch_reader.h"
+#include "util.h"
+
+#include <cstdlib>
+#include <iostream>
+
+std::unique_ptr<RColumnBatchReader> RColumnBatchReader::Create(const std::string &path, const std::string &name) {
+  switch (GetFileFormat(GetSuffix(path))) {
+    case FileFormats::kRoot:
+      return CreateColumnBatchReaderTTree(path, name);
+    case FileFormats::kNtuple:
+      return CreateColumnBatchReaderNTuple(path, name);
+    case FileFormats::kParquet:
+      return CreateColumnBatchReaderParquet(path);
+    case FileFormats::kH5:
+      return CreateColumnBatchReaderH5(path);
+    default:
+      std::cerr << "No column batch reader for " << path << std::endl;
+      abort();
+  }
+}
@@ -0,0 +1,87 @@
+#ifndef COLUMN_BATCH_READER_H_
+#define COLUMN_BATCH_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/// \brief Format-agnostic, columnar access to the flat (non-collection) columns of a data set.
+///
+/// The analysis kernel requests its columns with `AddColumn<T>()` and then iterates over batches of
+/// entries.  After `NextBatch()`, `GetColumn<T>()` returns a pointer to the contiguous values of the
+/// current batch.  Batches follow the natural unit of the format: TTree/RNTuple clusters, Parquet row
+/// groups, HDF5 chunks.  The back-end is selected from the file suffix, so that a single kernel runs over
+/// `.root`, `.ntuple`, `.parquet` and `.h5` files.
+class RColumnBatchReader {
+public:
+  enum class EColumnType { kInt32, kFloat, kDouble };
+
+  template <typename T>
+  static constexpr EColumnType GetColumnType() {
+    static_assert(std::is_same<T, std::int32_t>::value || std::is_same<T, float>::value ||
+                  std::is_same<T, double>::value, "unsupported column type");
+    if constexpr (std::is_same<T, std::int32_t>::value)
+      return EColumnType::kInt32;
+    else if constexpr (std::is_same<T, float>::value)
+      return EColumnType::kFloat;
+    else
+      return EColumnType::kDouble;
+  }
+  static std::size_t GetColumnTypeSize(EColumnType type) {
+    return (type == EColumnType::kDouble) ? sizeof(double) : 4;
+  }
+
+protected:
+  struct RColumn {
+    std::string fName;
+    EColumnType fType;
+    /// Points to the values of the current batch; owned by the back-end
+    const void *fData = nullptr;
+  };
+  std::vector<RColumn> fColumns;
+  bool fIsConnected = false;
+
+  /// Resolves the requested columns in the data set; called once before the first batch
+  virtual void Connect() = 0;
+  /// Loads the next batch and sets `fData` of all columns; returns 0 at the end of the data set
+  virtual std::size_t LoadBatch() = 0;
+
+public:
+  virtual ~RColumnBatchReader() = default;
+
+  /// Opens `path` with the back-end that belongs to the file suffix.  `name` is the tree or ntuple name
+  /// for ROOT files; Parquet and HDF5 files are searched for the column names.
+  static std::unique_ptr<RColumnBatchReader> Create(const std::string &path, const std::string &name);
+
+  /// Returns the column index to be used with `GetColumn()`.  Must be called before the first batch.
+  template <typename T>
+  std::size_t AddColumn(const std::string &name) {
+    fColumns.push_back(RColumn{name, GetColumnType<T>()});
+    return fColumns.size() - 1;
+  }
+
+  /// Returns the number of entries in the new batch, 0 at the end of the data set
+  std::size_t NextBatch() {
+    if (!fIsConnected) {
+      Connect();
+      fIsConnected = true;
+    }
+    return LoadBatch();
+  }
+
+  template <typename T>
+  const T *GetColumn(std::size_t idx) const {
+    return static_cast<const T *>(fColumns[idx].fData);
+  }
+};
+
+// Back-end factories, one per translation unit
+std::unique_ptr<RColumnBatchReader> CreateColumnBatchReaderTTree(const std::string &path, const std::string &name);
+std::unique_ptr<RColumnBatchReader> CreateColumnBatchReaderNTuple(const std::string &path, const std::string &name);
+std::unique_ptr<RColumnBatchReader> CreateColumnBatchReaderParquet(const std::string &path);
+std::unique_ptr<RColumnBatchReader> CreateColumnBatchReaderH5(const std::string &path);
+
+#endif // COLUMN_BATCH_READER_H_
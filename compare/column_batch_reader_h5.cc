@@ -0,0 +1,252 @@
+#include "column_batch_reader.h"
+
+#include <hdf5.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <utility>
+
+namespace {
+
+/// Reads one HDF5 chunk per batch.  Works for both h5hep column models: a column is either the member
+/// of a compound data set (row-wise layout) or a data set of its own (column-wise layout).  All requested
+/// members of a compound data set are read by a single H5Dread() with a memory type of just these members,
+/// so that every chunk is decompressed once; the rows are then scattered into the column buffers.
+/// If the data sets are chunked differently, a batch spans one chunk of the data set with the largest chunks;
+/// the chunk cache of every data set holds the chunk that straddles the batch boundary for the next batch.
+class RColumnBatchReaderH5 : public RColumnBatchReader {
+  static constexpr hsize_t kDefaultBatchSize = 65536;
+
+  /// One H5Dread() per batch: either of the requested members of a compound data set or of a plain data set
+  struct RDatasetRead {
+    hid_t fDataset = H5I_INVALID_HID;
+    hid_t fMemType = H5I_INVALID_HID;
+    bool fIsCompound = false;
+    hsize_t fNEntries = 0;
+    /// Number of rows per chunk, 0 for contiguous data sets
+    hsize_t fChunkSize = 0;
+    /// Size of a row of the memory type
+    std::size_t fRowSize = 0;
+    /// Column index and offset within the row of the memory type
+    std::vector<std::pair<std::size_t, std::size_t>> fMembers;
+    /// Rows of the compound memory type before they are scattered into the columns
+    std::vector<unsigned char> fBuffer;
+  };
+
+  hid_t fFile = H5I_INVALID_HID;
+  /// Data sets by their full path
+  std::vector<std::string> fDatasetPaths;
+  /// Compound member name --> data set path
+  std::map<std::string, std::string> fMembers;
+
+  std::vector<RDatasetRead> fReads;
+  std::vector<std::vector<unsigned char>> fBuffers;
+  hsize_t fNEntries = 0;
+  hsize_t fBatchSize = kDefaultBatchSize;
+  hsize_t fNextEntry = 0;
+
+  static herr_t VisitLink(hid_t group, const char *name, const H5L_info_t * /*info*/, void *data) {
+    auto self = static_cast<RColumnBatchReaderH5 *>(data);
+    hid_t object = H5Oopen(group, name, H5P_DEFAULT);
+    if (object < 0)
+      return 0;
+    if (H5Iget_type(object) == H5I_DATASET) {
+      self->fDatasetPaths.emplace_back(name);
+      hid_t type = H5Dget_type(object);
+      if (H5Tget_class(type) == H5T_COMPOUND) {
+        for (int i = 0, n = H5Tget_nmembers(type); i < n; ++i) {
+          char *member = H5Tget_member_name(type, i);
+          self->fMembers.emplace(member, name);
+          H5free_memory(member);
+        }
+      }
+      H5Tclose(type);
+    }
+    H5Oclose(object);
+    return 0;
+  }
+
+  static hid_t GetNativeType(EColumnType type) {
+    switch (type) {
+      case EColumnType::kInt32: return H5T_NATIVE_INT32;
+      case EColumnType::kFloat: return H5T_NATIVE_FLOAT;
+      case EColumnType::kDouble: return H5T_NATIVE_DOUBLE;
+    }
+    return H5I_INVALID_HID;
+  }
+
+  /// Opens the data set and queries its own extent and chunking.  Chunked data sets are reopened with a chunk
+  /// cache of at least two chunks, so that a chunk read partially by one batch is still cached for the next.
+  void OpenDataset(const std::string &path, RDatasetRead &read) const {
+    read.fDataset = H5Dopen(fFile, path.c_str(), H5P_DEFAULT);
+    if (read.fDataset < 0) {
+      std::cerr << "Cannot open data set " << path << std::endl;
+      abort();
+    }
+    hid_t space = H5Dget_space(read.fDataset);
+    H5Sget_simple_extent_dims(space, &read.fNEntries, nullptr);
+    H5Sclose(space);
+    hid_t plist = H5Dget_create_plist(read.fDataset);
+    if (H5Pget_layout(plist) == H5D_CHUNKED) {
+      hsize_t chunkDims[H5S_MAX_RANK];
+      H5Pget_chunk(plist, H5S_MAX_RANK, chunkDims);
+      read.fChunkSize = chunkDims[0];
+    }
+    H5Pclose(plist);
+    if (read.fChunkSize == 0)
+      return;
+
+    hid_t type = H5Dget_type(read.fDataset);
+    const std::size_t chunkBytes = read.fChunkSize * H5Tget_size(type);
+    H5Tclose(type);
+    hid_t accessList = H5Dget_access_plist(read.fDataset);
+    std::size_t nSlots, nBytes;
+    double w0;
+    H5Pget_chunk_cache(accessList, &nSlots, &nBytes, &w0);
+    if (nBytes < 2 * chunkBytes) {
+      H5Pset_chunk_cache(accessList, nSlots, 2 * chunkBytes, w0);
+      H5Dclose(read.fDataset);
+      read.fDataset = H5Dopen(fFile, path.c_str(), accessList);
+    }
+    H5Pclose(accessList);
+  }
+
+  /// Finds the data set that stores `name`, either as "name", ".../name" or "....name"
+  std::string FindDataset(const std::string &name) const {
+    for (const auto &path : fDatasetPaths) {
+      if (path.size() < name.size() || path.compare(path.size() - name.size(), name.size(), name) != 0)
+        continue;
+      if (path.size() == name.size())
+        return path;
+      const char sep = path[path.size() - name.size() - 1];
+      if (sep == '/' || sep == '.')
+        return path;
+    }
+    return "";
+  }
+
+protected:
+  void Connect() final {
+    H5Lvisit(fFile, H5_INDEX_NAME, H5_ITER_NATIVE, VisitLink, this);
+
+    // Compound data set path --> index in fReads
+    std::map<std::string, std::size_t> compoundReads;
+    for (std::size_t i = 0; i < fColumns.size(); ++i) {
+      const auto &column = fColumns[i];
+      const std::size_t size = GetColumnTypeSize(column.fType);
+      auto itrMember = fMembers.find(column.fName);
+      if (itrMember != fMembers.end()) {
+        auto itrRead = compoundReads.find(itrMember->second);
+        if (itrRead == compoundReads.end()) {
+          itrRead = compoundReads.emplace(itrMember->second, fReads.size()).first;
+          RDatasetRead read;
+          OpenDataset(itrMember->second, read);
+          read.fIsCompound = true;
+          fReads.emplace_back(std::move(read));
+        }
+        auto &read = fReads[itrRead->second];
+        read.fMembers.emplace_back(i, read.fRowSize);
+        read.fRowSize += size;
+      } else {
+        const auto path = FindDataset(column.fName);
+        if (path.empty()) {
+          std::cerr << "Column " << column.fName << " not found" << std::endl;
+          abort();
+        }
+        RDatasetRead read;
+        OpenDataset(path, read);
+        read.fMemType = H5Tcopy(GetNativeType(column.fType));
+        read.fRowSize = size;
+        read.fMembers.emplace_back(i, 0);
+        fReads.emplace_back(std::move(read));
+      }
+    }
+    for (auto &read : fReads) {
+      if (!read.fIsCompound)
+        continue;
+      read.fMemType = H5Tcreate(H5T_COMPOUND, read.fRowSize);
+      for (const auto &[columnIdx, offset] : read.fMembers)
+        H5Tinsert(read.fMemType, fColumns[columnIdx].fName.c_str(), offset, GetNativeType(fColumns[columnIdx].fType));
+    }
+    fBuffers.resize(fColumns.size());
+    if (fReads.empty())
+      return;
+
+    fNEntries = fReads[0].fNEntries;
+    hsize_t maxChunkSize = 0;
+    for (const auto &read : fReads) {
+      if (read.fNEntries != fNEntries) {
+        std::cerr << "Column " << fColumns[read.fMembers[0].first].fName << " has " << read.fNEntries
+                  << " entries, expected " << fNEntries << std::endl;
+        abort();
+      }
+      maxChunkSize = std::max(maxChunkSize, read.fChunkSize);
+    }
+    if (maxChunkSize > 0)
+      fBatchSize = maxChunkSize;
+  }
+
+  std::size_t LoadBatch() final {
+    if (fNextEntry >= fNEntries)
+      return 0;
+    hsize_t nEntries = std::min(fBatchSize, fNEntries - fNextEntry);
+    hid_t memSpace = H5Screate_simple(1, &nEntries, nullptr);
+    for (auto &read : fReads) {
+      for (const auto &[columnIdx, offset] : read.fMembers) {
+        fBuffers[columnIdx].resize(nEntries * GetColumnTypeSize(fColumns[columnIdx].fType));
+        fColumns[columnIdx].fData = fBuffers[columnIdx].data();
+      }
+      // Plain data sets are read directly into their column buffer
+      unsigned char *target = fBuffers[read.fMembers[0].first].data();
+      if (read.fIsCompound) {
+        read.fBuffer.resize(nEntries * read.fRowSize);
+        target = read.fBuffer.data();
+      }
+      hid_t fileSpace = H5Dget_space(read.fDataset);
+      H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, &fNextEntry, nullptr, &nEntries, nullptr);
+      if (H5Dread(read.fDataset, read.fMemType, memSpace, fileSpace, H5P_DEFAULT, target) < 0) {
+        std::cerr << "Cannot read column " << fColumns[read.fMembers[0].first].fName << std::endl;
+        abort();
+      }
+      H5Sclose(fileSpace);
+      if (!read.fIsCompound)
+        continue;
+      for (const auto &[columnIdx, offset] : read.fMembers) {
+        const std::size_t size = GetColumnTypeSize(fColumns[columnIdx].fType);
+        const unsigned char *src = read.fBuffer.data() + offset;
+        unsigned char *dst = fBuffers[columnIdx].data();
+        for (hsize_t r = 0; r < nEntries; ++r, src += read.fRowSize, dst += size)
+          memcpy(dst, src, size);
+      }
+    }
+    H5Sclose(memSpace);
+    fNextEntry += nEntries;
+    return nEntries;
+  }
+
+public:
+  explicit RColumnBatchReaderH5(const std::string &path) {
+    fFile = H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (fFile < 0) {
+      std::cerr << "Cannot open " << path << std::endl;
+      abort();
+    }
+  }
+
+  ~RColumnBatchReaderH5() override {
+    for (auto &read : fReads) {
+      H5Tclose(read.fMemType);
+      H5Dclose(read.fDataset);
+    }
+    H5Fclose(fFile);
+  }
+};
+
+} // anonymous namespace
+
+std::unique_ptr<RColumnBatchReader> CreateColumnBatchReaderH5(const std::string &path) {
+  return std::make_unique<RColumnBatchReaderH5>(path);
+}
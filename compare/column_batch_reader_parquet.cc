@@ -0,0 +1,56 @@
+#include "column_batch_reader.h"
+#include "util_arrow.h"
+
+#include <arrow/io/api.h>
+#include <parquet/arrow/reader.h>
+
+namespace {
+
+/// Reads one row group per batch; the column pointers refer directly to the Arrow value buffers
+class RColumnBatchReaderParquet : public RColumnBatchReader {
+  std::unique_ptr<parquet::arrow::FileReader> fReader;
+  std::vector<int> fColumnIndices;
+  std::shared_ptr<arrow::Table> fTable;
+  int fNextRowGroup = 0;
+
+protected:
+  void Connect() final {
+    std::shared_ptr<arrow::Schema> schema;
+    PARQUET_THROW_NOT_OK(fReader->GetSchema(&schema));
+    std::vector<std::string> names;
+    for (const auto &column : fColumns)
+      names.push_back(column.fName);
+    fColumnIndices = GetColumnIndices(schema, names);
+  }
+
+  std::size_t LoadBatch() final {
+    if (fNextRowGroup >= fReader->num_row_groups())
+      return 0;
+    PARQUET_THROW_NOT_OK(fReader->ReadRowGroup(fNextRowGroup++, fColumnIndices, &fTable));
+    // The table columns are in the order of the requested column indices
+    for (std::size_t i = 0; i < fColumns.size(); ++i) {
+      auto chunked = fTable->column(i);
+      if (chunked->num_chunks() != 1) {
+        PARQUET_ASSIGN_OR_THROW(fTable, fTable->CombineChunks());
+        chunked = fTable->column(i);
+      }
+      auto array = std::static_pointer_cast<arrow::PrimitiveArray>(chunked->chunk(0));
+      fColumns[i].fData = array->values()->data() + array->offset() * GetColumnTypeSize(fColumns[i].fType);
+    }
+    return fTable->num_rows();
+  }
+
+public:
+  explicit RColumnBatchReaderParquet(const std::string &path) {
+    std::shared_ptr<arrow::io::ReadableFile> infile;
+    PARQUET_ASSIGN_OR_THROW(infile, arrow::io::ReadableFile::Open(path));
+    PARQUET_THROW_NOT_OK(parquet::arrow::OpenFile(infile, arrow::default_memory_pool(), &fReader));
+    fReader->set_use_threads(true);
+  }
+};
+
+} // anonymous namespace
+
+std::unique_ptr<RColumnBatchReader> CreateColumnBatchReaderParquet(const std::string &path) {
+  return std::make_unique<RColumnBatchReaderParquet>(path);
+}
@@ -0,0 +1,165 @@
+#include "column_batch_reader.h"
+
+#include <ROOT/RField.hxx>
+#include <ROOT/RNTupleDescriptor.hxx>
+#include <ROOT/RNTupleModel.hxx>
+#include <ROOT/RNTupleReader.hxx>
+
+#include <TBranch.h>
+#include <TBufferFile.h>
+#include <TFile.h>
+#include <TTree.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <optional>
+
+namespace {
+
+/// Reads one TTree cluster per batch; every branch is deserialized basket by basket with the bulk API and the
+/// baskets' values are copied into contiguous buffers
+class RColumnBatchReaderTTree : public RColumnBatchReader {
+  std::unique_ptr<TFile> fFile;
+  TTree *fTree = nullptr;
+  std::vector<TBranch *> fBranches;
+  /// Receives the deserialized values of one basket of the corresponding branch
+  std::vector<std::unique_ptr<TBufferFile>> fBasketBuffers;
+  std::vector<std::vector<unsigned char>> fBuffers;
+  std::optional<TTree::TClusterIterator> fClusterIter;
+  Long64_t fNEntries = 0;
+  Long64_t fNextEntry = 0;
+
+protected:
+  void Connect() final {
+    fBranches.resize(fColumns.size());
+    fBuffers.resize(fColumns.size());
+    for (std::size_t i = 0; i < fColumns.size(); ++i) {
+      fBranches[i] = fTree->GetBranch(fColumns[i].fName.c_str());
+      if (fBranches[i] == nullptr) {
+        std::cerr << "Branch " << fColumns[i].fName << " not found" << std::endl;
+        abort();
+      }
+      if (!fBranches[i]->GetBulkRead().SupportsBulkRead()) {
+        std::cerr << "Branch " << fColumns[i].fName << " does not support bulk reading" << std::endl;
+        abort();
+      }
+      fBasketBuffers.emplace_back(std::make_unique<TBufferFile>(TBuffer::kWrite, 32 * 1024));
+    }
+    fClusterIter.emplace(fTree->GetClusterIterator(0));
+  }
+
+  std::size_t LoadBatch() final {
+    if (fNextEntry >= fNEntries)
+      return 0;
+    const Long64_t first = (*fClusterIter)();
+    const Long64_t last = std::min(fClusterIter->GetNextEntry(), fNEntries);
+    const std::size_t nEntries = last - first;
+    for (std::size_t i = 0; i < fColumns.size(); ++i) {
+      const std::size_t size = GetColumnTypeSize(fColumns[i].fType);
+      auto branch = fBranches[i];
+      auto &basketBuffer = *fBasketBuffers[i];
+      auto &buffer = fBuffers[i];
+      buffer.resize(nEntries * size);
+      // Baskets need not be aligned with the cluster boundaries; copy the overlap of every basket
+      for (Long64_t entry = first; entry < last;) {
+        const Int_t nBasketEntries = branch->GetBulkRead().GetBulkEntries(entry, basketBuffer);
+        if (nBasketEntries <= 0) {
+          std::cerr << "Cannot read entry " << entry << " of branch " << fColumns[i].fName << std::endl;
+          abort();
+        }
+        const Long64_t basketFirst = branch->GetBasketEntry()[branch->GetReadBasket()];
+        const Long64_t basketLast = std::min(basketFirst + nBasketEntries, last);
+        memcpy(buffer.data() + (entry - first) * size, basketBuffer.GetCurrent() + (entry - basketFirst) * size,
+               (basketLast - entry) * size);
+        entry = basketLast;
+      }
+      fColumns[i].fData = buffer.data();
+    }
+    fNextEntry = last;
+    return nEntries;
+  }
+
+public:
+  RColumnBatchReaderTTree(const std::string &path, const std::string &name) : fFile(TFile::Open(path.c_str())) {
+    if (!fFile || fFile->IsZombie()) {
+      std::cerr << "Cannot open " << path << std::endl;
+      abort();
+    }
+    fTree = fFile->Get<TTree>(name.c_str());
+    fNEntries = fTree->GetEntries();
+  }
+};
+
+/// Reads one RNTuple cluster per batch with the bulk API, which returns the values of a column in a cluster as a
+/// contiguous array, so that the batch costs a page read and decode per column and no per-entry call
+class RColumnBatchReaderNTuple : public RColumnBatchReader {
+  using RNTupleReader = ROOT::Experimental::RNTupleReader;
+  using RNTupleModel = ROOT::Experimental::RNTupleModel;
+  using RFieldBase = ROOT::Experimental::RFieldBase;
+  using RClusterIndex = ROOT::Experimental::RClusterIndex;
+  using DescriptorId_t = ROOT::Experimental::DescriptorId_t;
+  template <typename T>
+  using RField = ROOT::Experimental::RField<T>;
+
+  std::string fPath;
+  std::string fNTupleName;
+  std::unique_ptr<RNTupleReader> fReader;
+  std::vector<RFieldBase::RBulk> fBulks;
+  /// All entries of the cluster are requested
+  std::unique_ptr<bool[]> fMaskReq;
+  std::size_t fMaskReqSize = 0;
+  DescriptorId_t fClusterId = ROOT::Experimental::kInvalidDescriptorId;
+
+protected:
+  void Connect() final {
+    // The fields are created here so that the bulks can be bound to them once the reader connected the model
+    auto model = RNTupleModel::Create();
+    std::vector<RFieldBase *> fields;
+    for (const auto &column : fColumns) {
+      std::unique_ptr<RFieldBase> field;
+      switch (column.fType) {
+        case EColumnType::kInt32: field = std::make_unique<RField<std::int32_t>>(column.fName); break;
+        case EColumnType::kFloat: field = std::make_unique<RField<float>>(column.fName); break;
+        case EColumnType::kDouble: field = std::make_unique<RField<double>>(column.fName); break;
+      }
+      fields.emplace_back(field.get());
+      model->AddField(std::move(field));
+    }
+    fReader = RNTupleReader::Open(std::move(model), fNTupleName, fPath);
+    for (auto field : fields)
+      fBulks.emplace_back(field->CreateBulk());
+    if (fReader->GetNEntries() > 0)
+      fClusterId = fReader->GetDescriptor().FindClusterId(0, 0);
+  }
+
+  std::size_t LoadBatch() final {
+    if (fClusterId == ROOT::Experimental::kInvalidDescriptorId)
+      return 0;
+    const auto &descriptor = fReader->GetDescriptor();
+    const std::size_t nEntries = descriptor.GetClusterDescriptor(fClusterId).GetNEntries();
+    if (nEntries > fMaskReqSize) {
+      fMaskReq = std::make_unique<bool[]>(nEntries);
+      std::fill_n(fMaskReq.get(), nEntries, true);
+      fMaskReqSize = nEntries;
+    }
+    for (std::size_t i = 0; i < fColumns.size(); ++i)
+      fColumns[i].fData = fBulks[i].ReadBulk(RClusterIndex(fClusterId, 0), fMaskReq.get(), nEntries);
+    fClusterId = descriptor.FindNextClusterId(fClusterId);
+    return nEntries;
+  }
+
+public:
+  RColumnBatchReaderNTuple(const std::string &path, const std::string &name) : fPath(path), fNTupleName(name) {}
+};
+
+} // anonymous namespace
+
+std::unique_ptr<RColumnBatchReader> CreateColumnBatchReaderTTree(const std::string &path, const std::string &name) {
+  return std::make_unique<RColumnBatchReaderTTree>(path, name);
+}
+
+std::unique_ptr<RColumnBatchReader> CreateColumnBatchReaderNTuple(const std::string &path, const std::string &name) {
+  return std::make_unique<RColumnBatchReaderNTuple>(path, name);
+}
@@ -5,6 +5,7 @@
 #include <parquet/arrow/writer.h>
 
 #include <cassert>
+#include <chrono>
 #include <cstdio>
 #include <memory>
 #include <unistd.h>
@@ -19,7 +20,8 @@ static const std::unordered_map<std::string, parquet::Compression::type> g_name2
 constexpr size_t kDefaultWriteTableChunkSize = 64000;
 
 static void Usage(char *progname) {
-  printf("Usage: %s -i <input ROOT file> -o <output parquet file> [-c none|zstd] [-s <WriteTable() chunk size>]\n", progname);
+  printf("Usage: %s -i <input ROOT file> -o <output parquet file> [-c none|zstd] [-s <WriteTable() chunk size>] [-b]\n"
+         "  -b: append to the Arrow builders in column batches of one chunk instead of row by row\n", progname);
 }
 
 std::shared_ptr<arrow::Schema> InitSchema() {
@@ -112,14 +114,104 @@ std::shared_ptr<arrow::Schema> InitSchema() {
     });
 }
 
+/// The array builders of the fields in `InitSchema()`, for ArrowTableBuilder and ArrowColumnBatch
+template <template <class...> class T>
+using Columns_t = T<
+  /*run*/arrow::Int32Builder,
+  /*luminosityBlock*/arrow::UInt32Builder,
+  /*event*/arrow::UInt64Builder,
+  /*HLT_IsoMu24_eta2p1*/arrow::BooleanBuilder,
+  /*HLT_IsoMu24*/arrow::BooleanBuilder,
+  /*HLT_IsoMu17_eta2p1_LooseIsoPFTau20*/arrow::BooleanBuilder,
+  /*PV_npvs*/arrow::Int32Builder,
+  /*PV_x*/arrow::FloatBuilder,
+  /*PV_y*/arrow::FloatBuilder,
+  /*PV_z*/arrow::FloatBuilder,
+  /*nMuon*/
+  /*Muon_pt*/ListAdapter<arrow::FloatBuilder>,
+  /*Muon_eta*/ListAdapter<arrow::FloatBuilder>,
+  /*Muon_phi*/ListAdapter<arrow::FloatBuilder>,
+  /*Muon_mass*/ListAdapter<arrow::FloatBuilder>,
+  /*Muon_charge*/ListAdapter<arrow::Int32Builder>,
+  /*Muon_pfRelIso03_all*/ListAdapter<arrow::FloatBuilder>,
+  /*Muon_pfRelIso04_all*/ListAdapter<arrow::FloatBuilder>,
+  /*Muon_tightId*/ListAdapter<arrow::BooleanBuilder>,
+  /*Muon_softId*/ListAdapter<arrow::BooleanBuilder>,
+  /*Muon_dxy*/ListAdapter<arrow::FloatBuilder>,
+  /*Muon_dxyErr*/ListAdapter<arrow::FloatBuilder>,
+  /*Muon_dz*/ListAdapter<arrow::FloatBuilder>,
+  /*Muon_dzErr*/ListAdapter<arrow::FloatBuilder>,
+  /*Muon_jetIdx*/ListAdapter<arrow::Int32Builder>,
+  /*Muon_genPartIdx*/ListAdapter<arrow::Int32Builder>,
+  /*nElectron*/
+  /*Electron_pt*/ListAdapter<arrow::FloatBuilder>,
+  /*Electron_eta*/ListAdapter<arrow::FloatBuilder>,
+  /*Electron_phi*/ListAdapter<arrow::FloatBuilder>,
+  /*Electron_mass*/ListAdapter<arrow::FloatBuilder>,
+  /*Electron_charge*/ListAdapter<arrow::Int32Builder>,
+  /*Electron_pfRelIso03_all*/ListAdapter<arrow::FloatBuilder>,
+  /*Electron_dxy*/ListAdapter<arrow::FloatBuilder>,
+  /*Electron_dxyErr*/ListAdapter<arrow::FloatBuilder>,
+  /*Electron_dz*/ListAdapter<arrow::FloatBuilder>,
+  /*Electron_dzErr*/ListAdapter<arrow::FloatBuilder>,
+  /*Electron_cutBasedId*/ListAdapter<arrow::BooleanBuilder>,
+  /*Electron_pfId*/ListAdapter<arrow::BooleanBuilder>,
+  /*Electron_jetIdx*/ListAdapter<arrow::Int32Builder>,
+  /*Electron_genPartIdx*/ListAdapter<arrow::Int32Builder>,
+  /*nTau*/
+  /*Tau_pt*/ListAdapter<arrow::FloatBuilder>,
+  /*Tau_eta*/ListAdapter<arrow::FloatBuilder>,
+  /*Tau_phi*/ListAdapter<arrow::FloatBuilder>,
+  /*Tau_mass*/ListAdapter<arrow::FloatBuilder>,
+  /*Tau_charge*/ListAdapter<arrow::Int32Builder>,
+  /*Tau_decayMode*/ListAdapter<arrow::Int32Builder>,
+  /*Tau_relIso_all*/ListAdapter<arrow::FloatBuilder>,
+  /*Tau_jetIdx*/ListAdapter<arrow::Int32Builder>,
+  /*Tau_genPartIdx*/ListAdapter<arrow::Int32Builder>,
+  /*Tau_idDecayMode*/ListAdapter<arrow::BooleanBuilder>,
+  /*Tau_idIsoRaw*/ListAdapter<arrow::FloatBuilder>,
+  /*Tau_idIsoVLoose*/ListAdapter<arrow::BooleanBuilder>,
+  /*Tau_idIsoLoose*/ListAdapter<arrow::BooleanBuilder>,
+  /*Tau_idIsoMedium*/ListAdapter<arrow::BooleanBuilder>,
+  /*Tau_idIsoTight*/ListAdapter<arrow::BooleanBuilder>,
+  /*Tau_idAntiEleLoose*/ListAdapter<arrow::BooleanBuilder>,
+  /*Tau_idAntiEleMedium*/ListAdapter<arrow::BooleanBuilder>,
+  /*Tau_idAntiEleTight*/ListAdapter<arrow::BooleanBuilder>,
+  /*Tau_idAntiMuLoose*/ListAdapter<arrow::BooleanBuilder>,
+  /*Tau_idAntiMuMedium*/ListAdapter<arrow::BooleanBuilder>,
+  /*Tau_idAntiMuTight*/ListAdapter<arrow::BooleanBuilder>,
+  /*MET_pt*/arrow::FloatBuilder,
+  /*MET_phi*/arrow::FloatBuilder,
+  /*MET_sumet*/arrow::FloatBuilder,
+  /*MET_significance*/arrow::FloatBuilder,
+  /*MET_CovXX*/arrow::FloatBuilder,
+  /*MET_CovXY*/arrow::FloatBuilder,
+  /*MET_CovYY*/arrow::FloatBuilder,
+  /*nJet*/
+  /*Jet_pt*/ListAdapter<arrow::FloatBuilder>,
+  /*Jet_eta*/ListAdapter<arrow::FloatBuilder>,
+  /*Jet_phi*/ListAdapter<arrow::FloatBuilder>,
+  /*Jet_mass*/ListAdapter<arrow::FloatBuilder>,
+  /*Jet_puId*/ListAdapter<arrow::BooleanBuilder>,
+  /*Jet_btag*/ListAdapter<arrow::FloatBuilder>,
+  /*nGenPart*/
+  /*GenPart_pt*/ListAdapter<arrow::FloatBuilder>,
+  /*GenPart_eta*/ListAdapter<arrow::FloatBuilder>,
+  /*GenPart_phi*/ListAdapter<arrow::FloatBuilder>,
+  /*GenPart_mass*/ListAdapter<arrow::FloatBuilder>,
+  /*GenPart_pdgId*/ListAdapter<arrow::Int32Builder>,
+  /*GenPart_status*/ListAdapter<arrow::Int32Builder>
+  >;
+
 int main(int argc, char **argv) {
   std::string inputPath;
   std::string outputPath;
   std::string compression{"none"};
   std::size_t chunkSize = kDefaultWriteTableChunkSize;
+  bool bulkAppend = false;
 
   int c;
-  while ((c = getopt(argc, argv, "hvi:o:c:s:")) != -1) {
+  while ((c = getopt(argc, argv, "hvi:o:c:s:b")) != -1) {
     switch (c) {
       case 'h':
       case 'v':
@@ -137,6 +229,9 @@ int main(int argc, char **argv) {
       case 's':
         chunkSize = std::atoi(optarg);
         break;
+      case 'b':
+        bulkAppend = true;
+        break;
       default:
         fprintf(stderr, "Unknown option: -%c\n", c);
         Usage(argv[0]);
@@ -165,99 +260,16 @@ int main(int argc, char **argv) {
   PARQUET_THROW_NOT_OK(parquet::arrow::FileWriter::Open(*schema, arrow::default_memory_pool(), outfile, props.build(),
 							&writer));
 
-  ArrowTableBuilder<
-    /*run*/arrow::Int32Builder,
-    /*luminosityBlock*/arrow::UInt32Builder,
-    /*event*/arrow::UInt64Builder,
-    /*HLT_IsoMu24_eta2p1*/arrow::BooleanBuilder,
-    /*HLT_IsoMu24*/arrow::BooleanBuilder,
-    /*HLT_IsoMu17_eta2p1_LooseIsoPFTau20*/arrow::BooleanBuilder,
-    /*PV_npvs*/arrow::Int32Builder,
-    /*PV_x*/arrow::FloatBuilder,
-    /*PV_y*/arrow::FloatBuilder,
-    /*PV_z*/arrow::FloatBuilder,
-    /*nMuon*/
-    /*Muon_pt*/ListAdapter<arrow::FloatBuilder>,
-    /*Muon_eta*/ListAdapter<arrow::FloatBuilder>,
-    /*Muon_phi*/ListAdapter<arrow::FloatBuilder>,
-    /*Muon_mass*/ListAdapter<arrow::FloatBuilder>,
-    /*Muon_charge*/ListAdapter<arrow::Int32Builder>,
-    /*Muon_pfRelIso03_all*/ListAdapter<arrow::FloatBuilder>,
-    /*Muon_pfRelIso04_all*/ListAdapter<arrow::FloatBuilder>,
-    /*Muon_tightId*/ListAdapter<arrow::BooleanBuilder>,
-    /*Muon_softId*/ListAdapter<arrow::BooleanBuilder>,
-    /*Muon_dxy*/ListAdapter<arrow::FloatBuilder>,
-    /*Muon_dxyErr*/ListAdapter<arrow::FloatBuilder>,
-    /*Muon_dz*/ListAdapter<arrow::FloatBuilder>,
-    /*Muon_dzErr*/ListAdapter<arrow::FloatBuilder>,
-    /*Muon_jetIdx*/ListAdapter<arrow::Int32Builder>,
-    /*Muon_genPartIdx*/ListAdapter<arrow::Int32Builder>,
-    /*nElectron*/
-    /*Electron_pt*/ListAdapter<arrow::FloatBuilder>,
-    /*Electron_eta*/ListAdapter<arrow::FloatBuilder>,
-    /*Electron_phi*/ListAdapter<arrow::FloatBuilder>,
-    /*Electron_mass*/ListAdapter<arrow::FloatBuilder>,
-    /*Electron_charge*/ListAdapter<arrow::Int32Builder>,
-    /*Electron_pfRelIso03_all*/ListAdapter<arrow::FloatBuilder>,
-    /*Electron_dxy*/ListAdapter<arrow::FloatBuilder>,
-    /*Electron_dxyErr*/ListAdapter<arrow::FloatBuilder>,
-    /*Electron_dz*/ListAdapter<arrow::FloatBuilder>,
-    /*Electron_dzErr*/ListAdapter<arrow::FloatBuilder>,
-    /*Electron_cutBasedId*/ListAdapter<arrow::BooleanBuilder>,
-    /*Electron_pfId*/ListAdapter<arrow::BooleanBuilder>,
-    /*Electron_jetIdx*/ListAdapter<arrow::Int32Builder>,
-    /*Electron_genPartIdx*/ListAdapter<arrow::Int32Builder>,
-    /*nTau*/
-    /*Tau_pt*/ListAdapter<arrow::FloatBuilder>,
-    /*Tau_eta*/ListAdapter<arrow::FloatBuilder>,
-    /*Tau_phi*/ListAdapter<arrow::FloatBuilder>,
-    /*Tau_mass*/ListAdapter<arrow::FloatBuilder>,
-    /*Tau_charge*/ListAdapter<arrow::Int32Builder>,
-    /*Tau_decayMode*/ListAdapter<arrow::Int32Builder>,
-    /*Tau_relIso_all*/ListAdapter<arrow::FloatBuilder>,
-    /*Tau_jetIdx*/ListAdapter<arrow::Int32Builder>,
-    /*Tau_genPartIdx*/ListAdapter<arrow::Int32Builder>,
-    /*Tau_idDecayMode*/ListAdapter<arrow::BooleanBuilder>,
-    /*Tau_idIsoRaw*/ListAdapter<arrow::FloatBuilder>,
-    /*Tau_idIsoVLoose*/ListAdapter<arrow::BooleanBuilder>,
-    /*Tau_idIsoLoose*/ListAdapter<arrow::BooleanBuilder>,
-    /*Tau_idIsoMedium*/ListAdapter<arrow::BooleanBuilder>,
-    /*Tau_idIsoTight*/ListAdapter<arrow::BooleanBuilder>,
-    /*Tau_idAntiEleLoose*/ListAdapter<arrow::BooleanBuilder>,
-    /*Tau_idAntiEleMedium*/ListAdapter<arrow::BooleanBuilder>,
-    /*Tau_idAntiEleTight*/ListAdapter<arrow::BooleanBuilder>,
-    /*Tau_idAntiMuLoose*/ListAdapter<arrow::BooleanBuilder>,
-    /*Tau_idAntiMuMedium*/ListAdapter<arrow::BooleanBuilder>,
-    /*Tau_idAntiMuTight*/ListAdapter<arrow::BooleanBuilder>,
-    /*MET_pt*/arrow::FloatBuilder,
-    /*MET_phi*/arrow::FloatBuilder,
-    /*MET_sumet*/arrow::FloatBuilder,
-    /*MET_significance*/arrow::FloatBuilder,
-    /*MET_CovXX*/arrow::FloatBuilder,
-    /*MET_CovXY*/arrow::FloatBuilder,
-    /*MET_CovYY*/arrow::FloatBuilder,
-    /*nJet*/
-    /*Jet_pt*/ListAdapter<arrow::FloatBuilder>,
-    /*Jet_eta*/ListAdapter<arrow::FloatBuilder>,
-    /*Jet_phi*/ListAdapter<arrow::FloatBuilder>,
-    /*Jet_mass*/ListAdapter<arrow::FloatBuilder>,
-    /*Jet_puId*/ListAdapter<arrow::BooleanBuilder>,
-    /*Jet_btag*/ListAdapter<arrow::FloatBuilder>,
-    /*nGenPart*/
-    /*GenPart_pt*/ListAdapter<arrow::FloatBuilder>,
-    /*GenPart_eta*/ListAdapter<arrow::FloatBuilder>,
-    /*GenPart_phi*/ListAdapter<arrow::FloatBuilder>,
-    /*GenPart_mass*/ListAdapter<arrow::FloatBuilder>,
-    /*GenPart_pdgId*/ListAdapter<arrow::Int32Builder>,
-    /*GenPart_status*/ListAdapter<arrow::Int32Builder>
-    > tblBuilder(schema,
-		 chunkSize,
-		 [&writer,chunkSize](std::shared_ptr<arrow::Table> table) { writer->WriteTable(*table, chunkSize); });
+  Columns_t<ArrowTableBuilder> tblBuilder(schema,
+					  chunkSize,
+					  [&writer,chunkSize](std::shared_ptr<arrow::Table> table) { writer->WriteTable(*table, chunkSize); });
+  Columns_t<ArrowColumnBatch> batch;
 
+  auto ts_start = std::chrono::steady_clock::now();
   size_t nEvent = 0;
   while (reader.NextEvent()) {
     const auto &row = reader.fEvent;
-    tblBuilder << std::make_tuple(row.run,
+    auto values = std::make_tuple(row.run,
 				  row.luminosityBlock,
 				  row.event,
 				  row.HLT_IsoMu24_eta2p1,
@@ -338,10 +350,25 @@ int main(int argc, char **argv) {
 				  std::make_pair(row.GenPart_status, row.nGenPart)
 				  );
 
+    if (bulkAppend) {
+      batch.Append(values);
+      if (batch.GetCount() == chunkSize) {
+        tblBuilder.AppendColumns(batch);
+        batch.Clear();
+      }
+    } else {
+      tblBuilder << values;
+    }
+
     if (reader.fPos % 100000 == 0)
       printf(" ... processed %d events\n", reader.fPos);
     nEvent++;
   }
+  if (batch.GetCount())
+    tblBuilder.AppendColumns(batch);
+  auto ts_end = std::chrono::steady_clock::now();
   printf("[done] processed %d events\n", reader.fPos);
+  printf("Runtime-Conversion (%s append): %ldus\n", bulkAppend ? "bulk" : "row-wise",
+         std::chrono::duration_cast<std::chrono::microseconds>(ts_end - ts_start).count());
   return 0;
 }
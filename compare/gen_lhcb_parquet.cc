@@ -5,6 +5,7 @@
 #include <parquet/arrow/writer.h>
 
 #include <cassert>
+#include <chrono>
 #include <cstdio>
 #include <memory>
 #include <unistd.h>
@@ -19,7 +20,8 @@ static const std::unordered_map<std::string, parquet::Compression::type> g_name2
 constexpr size_t kDefaultWriteTableChunkSize = 64000;
 
 static void Usage(char *progname) {
-  printf("Usage: %s -i <input ROOT file> -o <output parquet file> [-c none|zstd] [-s <WriteTable() chunk size>]\n", progname);
+  printf("Usage: %s -i <input ROOT file> -o <output parquet file> [-c none|zstd] [-s <WriteTable() chunk size>] [-b]\n"
+         "  -b: append to the Arrow builders in column batches of one chunk instead of row by row\n", progname);
 }
 
 std::shared_ptr<arrow::Schema> InitSchema() {
@@ -54,14 +56,46 @@ std::shared_ptr<arrow::Schema> InitSchema() {
     });
 }
 
+/// The array builders of the fields in `InitSchema()`, for ArrowTableBuilder and ArrowColumnBatch
+template <template <class...> class T>
+using Columns_t = T<
+  /*B_FlightDistance*/arrow::DoubleBuilder,
+  /*B_VertexChi2*/arrow::DoubleBuilder,
+  /*H1_PX*/arrow::DoubleBuilder,
+  /*H1_PY*/arrow::DoubleBuilder,
+  /*H1_PZ*/arrow::DoubleBuilder,
+  /*H1_ProbK*/arrow::DoubleBuilder,
+  /*H1_ProbPi*/arrow::DoubleBuilder,
+  /*H1_Charge*/arrow::Int32Builder,
+  /*H1_isMuon*/arrow::Int32Builder,
+  /*H1_IpChi2*/arrow::DoubleBuilder,
+  /*H2_PX*/arrow::DoubleBuilder,
+  /*H2_PY*/arrow::DoubleBuilder,
+  /*H2_PZ*/arrow::DoubleBuilder,
+  /*H2_ProbK*/arrow::DoubleBuilder,
+  /*H2_ProbPi*/arrow::DoubleBuilder,
+  /*H2_Charge*/arrow::Int32Builder,
+  /*H2_isMuon*/arrow::Int32Builder,
+  /*H2_IpChi2*/arrow::DoubleBuilder,
+  /*H3_PX*/arrow::DoubleBuilder,
+  /*H3_PY*/arrow::DoubleBuilder,
+  /*H3_PZ*/arrow::DoubleBuilder,
+  /*H3_ProbK*/arrow::DoubleBuilder,
+  /*H3_ProbPi*/arrow::DoubleBuilder,
+  /*H3_Charge*/arrow::Int32Builder,
+  /*H3_isMuon*/arrow::Int32Builder,
+  /*H3_IpChi2*/arrow::DoubleBuilder
+  >;
+
 int main(int argc, char **argv) {
   std::string inputPath;
   std::string outputPath;
   std::string compression{"none"};
   std::size_t chunkSize = kDefaultWriteTableChunkSize;
+  bool bulkAppend = false;
 
   int c;
-  while ((c = getopt(argc, argv, "hvi:o:c:s:")) != -1) {
+  while ((c = getopt(argc, argv, "hvi:o:c:s:b")) != -1) {
     switch (c) {
       case 'h':
       case 'v':
@@ -79,6 +113,9 @@ int main(int argc, char **argv) {
       case 's':
         chunkSize = std::atoi(optarg);
         break;
+      case 'b':
+        bulkAppend = true;
+        break;
       default:
         fprintf(stderr, "Unknown option: -%c\n", c);
         Usage(argv[0]);
@@ -107,49 +144,39 @@ int main(int argc, char **argv) {
   PARQUET_THROW_NOT_OK(parquet::arrow::FileWriter::Open(*schema, arrow::default_memory_pool(), outfile, props.build(),
 							&writer));
 
-  ArrowTableBuilder<
-    /*B_FlightDistance*/arrow::DoubleBuilder,
-    /*B_VertexChi2*/arrow::DoubleBuilder,
-    /*H1_PX*/arrow::DoubleBuilder,
-    /*H1_PY*/arrow::DoubleBuilder,
-    /*H1_PZ*/arrow::DoubleBuilder,
-    /*H1_ProbK*/arrow::DoubleBuilder,
-    /*H1_ProbPi*/arrow::DoubleBuilder,
-    /*H1_Charge*/arrow::Int32Builder,
-    /*H1_isMuon*/arrow::Int32Builder,
-    /*H1_IpChi2*/arrow::DoubleBuilder,
-    /*H2_PX*/arrow::DoubleBuilder,
-    /*H2_PY*/arrow::DoubleBuilder,
-    /*H2_PZ*/arrow::DoubleBuilder,
-    /*H2_ProbK*/arrow::DoubleBuilder,
-    /*H2_ProbPi*/arrow::DoubleBuilder,
-    /*H2_Charge*/arrow::Int32Builder,
-    /*H2_isMuon*/arrow::Int32Builder,
-    /*H2_IpChi2*/arrow::DoubleBuilder,
-    /*H3_PX*/arrow::DoubleBuilder,
-    /*H3_PY*/arrow::DoubleBuilder,
-    /*H3_PZ*/arrow::DoubleBuilder,
-    /*H3_ProbK*/arrow::DoubleBuilder,
-    /*H3_ProbPi*/arrow::DoubleBuilder,
-    /*H3_Charge*/arrow::Int32Builder,
-    /*H3_isMuon*/arrow::Int32Builder,
-    /*H3_IpChi2*/arrow::DoubleBuilder
-    > tblBuilder(schema,
-		 chunkSize,
-		 [&writer,chunkSize](std::shared_ptr<arrow::Table> table) { writer->WriteTable(*table, chunkSize); });
+  Columns_t<ArrowTableBuilder> tblBuilder(schema,
+					  chunkSize,
+					  [&writer,chunkSize](std::shared_ptr<arrow::Table> table) { writer->WriteTable(*table, chunkSize); });
+  Columns_t<ArrowColumnBatch> batch;
 
+  auto ts_start = std::chrono::steady_clock::now();
   size_t nEvent = 0;
   while (reader.NextEvent()) {
     const auto &row = reader.fEvent;
-    tblBuilder << std::make_tuple(row.B_FlightDistance, row.B_VertexChi2,
+    auto values = std::make_tuple(row.B_FlightDistance, row.B_VertexChi2,
 				  row.H1_PX, row.H1_PY, row.H1_PZ, row.H1_ProbK, row.H1_ProbPi, row.H1_Charge, row.H1_isMuon, row.H1_IpChi2,
 				  row.H2_PX, row.H2_PY, row.H2_PZ, row.H2_ProbK, row.H2_ProbPi, row.H2_Charge, row.H2_isMuon, row.H2_IpChi2,
 				  row.H3_PX, row.H3_PY, row.H3_PZ, row.H3_ProbK, row.H3_ProbPi, row.H3_Charge, row.H3_isMuon, row.H3_IpChi2);
 
+    if (bulkAppend) {
+      batch.Append(values);
+      if (batch.GetCount() == chunkSize) {
+        tblBuilder.AppendColumns(batch);
+        batch.Clear();
+      }
+    } else {
+      tblBuilder << values;
+    }
+
     if (reader.fPos % 100000 == 0)
       printf(" ... processed %d events\n", reader.fPos);
     nEvent++;
   }
+  if (batch.GetCount())
+    tblBuilder.AppendColumns(batch);
+  auto ts_end = std::chrono::steady_clock::now();
   printf("[done] processed %d events\n", reader.fPos);
+  printf("Runtime-Conversion (%s append): %ldus\n", bulkAppend ? "bulk" : "row-wise",
+         std::chrono::duration_cast<std::chrono::microseconds>(ts_end - ts_start).count());
   return 0;
 }
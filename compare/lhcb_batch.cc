@@ -0,0 +1,164 @@
+#include "column_batch_reader.h"
+
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#include <TApplication.h>
+#include <TCanvas.h>
+#include <TH1D.h>
+#include <TROOT.h>
+#include <TRootCanvas.h>
+#include <TStyle.h>
+#include <TSystem.h>
+
+constexpr double kKaonMassMeV = 493.677;
+
+static void Show(TH1D *h) {
+  auto app = TApplication("", nullptr, nullptr);
+
+  gStyle->SetTextFont(42);
+  auto c = TCanvas("c", "", 800, 700);
+  h->GetXaxis()->SetTitle("m_{KKK} [MeV/c^{2}]");
+  h->DrawCopy();
+  c.Modified();
+  c.Update();
+  static_cast<TRootCanvas*>(c.GetCanvasImp())
+     ->Connect("CloseWindow()", "TApplication", gApplication, "Terminate()");
+  app.Run();
+}
+
+static double GetP2(double px, double py, double pz)
+{
+   return px*px + py*py + pz*pz;
+}
+
+static double GetKE(double px, double py, double pz)
+{
+   double p2 = GetP2(px, py, pz);
+   return sqrt(p2 + kKaonMassMeV*kKaonMassMeV);
+}
+
+static void Usage(char *progname) {
+  printf("Usage: %s -i <input .root|.ntuple|.parquet|.h5 file> [-s]\n", progname);
+}
+
+int main(int argc, char **argv) {
+  std::string inputPath;
+  bool show = false;
+
+  int c;
+  while ((c = getopt(argc, argv, "hvi:s")) != -1) {
+    switch (c) {
+      case 'h':
+      case 'v':
+        Usage(argv[0]);
+        return 0;
+      case 'i':
+        inputPath = optarg;
+        break;
+      case 's':
+        show = true;
+        break;
+      default:
+        fprintf(stderr, "Unknown option: -%c\n", c);
+        Usage(argv[0]);
+        return 1;
+    }
+  }
+  assert(!inputPath.empty());
+
+  auto ts_init = std::chrono::steady_clock::now();
+
+  auto reader = RColumnBatchReader::Create(inputPath, "DecayTree");
+  const auto iH1_isMuon = reader->AddColumn<std::int32_t>("H1_isMuon");
+  const auto iH2_isMuon = reader->AddColumn<std::int32_t>("H2_isMuon");
+  const auto iH3_isMuon = reader->AddColumn<std::int32_t>("H3_isMuon");
+  const auto iH1_ProbK = reader->AddColumn<double>("H1_ProbK");
+  const auto iH2_ProbK = reader->AddColumn<double>("H2_ProbK");
+  const auto iH3_ProbK = reader->AddColumn<double>("H3_ProbK");
+  const auto iH1_ProbPi = reader->AddColumn<double>("H1_ProbPi");
+  const auto iH2_ProbPi = reader->AddColumn<double>("H2_ProbPi");
+  const auto iH3_ProbPi = reader->AddColumn<double>("H3_ProbPi");
+  const auto iH1_PX = reader->AddColumn<double>("H1_PX");
+  const auto iH1_PY = reader->AddColumn<double>("H1_PY");
+  const auto iH1_PZ = reader->AddColumn<double>("H1_PZ");
+  const auto iH2_PX = reader->AddColumn<double>("H2_PX");
+  const auto iH2_PY = reader->AddColumn<double>("H2_PY");
+  const auto iH2_PZ = reader->AddColumn<double>("H2_PZ");
+  const auto iH3_PX = reader->AddColumn<double>("H3_PX");
+  const auto iH3_PY = reader->AddColumn<double>("H3_PY");
+  const auto iH3_PZ = reader->AddColumn<double>("H3_PZ");
+
+  auto hMass = new TH1D("B_mass", "", 500, 5050, 5500);
+
+  std::chrono::steady_clock::time_point ts_first = std::chrono::steady_clock::now();
+  size_t count = 0;
+  while (std::size_t nEntries = reader->NextBatch()) {
+    printf("processed %lu k events\n", count / 1000);
+
+    auto H1_isMuon = reader->GetColumn<std::int32_t>(iH1_isMuon);
+    auto H2_isMuon = reader->GetColumn<std::int32_t>(iH2_isMuon);
+    auto H3_isMuon = reader->GetColumn<std::int32_t>(iH3_isMuon);
+    auto H1_ProbK = reader->GetColumn<double>(iH1_ProbK);
+    auto H2_ProbK = reader->GetColumn<double>(iH2_ProbK);
+    auto H3_ProbK = reader->GetColumn<double>(iH3_ProbK);
+    auto H1_ProbPi = reader->GetColumn<double>(iH1_ProbPi);
+    auto H2_ProbPi = reader->GetColumn<double>(iH2_ProbPi);
+    auto H3_ProbPi = reader->GetColumn<double>(iH3_ProbPi);
+    auto H1_PX = reader->GetColumn<double>(iH1_PX);
+    auto H1_PY = reader->GetColumn<double>(iH1_PY);
+    auto H1_PZ = reader->GetColumn<double>(iH1_PZ);
+    auto H2_PX = reader->GetColumn<double>(iH2_PX);
+    auto H2_PY = reader->GetColumn<double>(iH2_PY);
+    auto H2_PZ = reader->GetColumn<double>(iH2_PZ);
+    auto H3_PX = reader->GetColumn<double>(iH3_PX);
+    auto H3_PY = reader->GetColumn<double>(iH3_PY);
+    auto H3_PZ = reader->GetColumn<double>(iH3_PZ);
+
+    for (std::size_t i = 0; i < nEntries; ++i) {
+      if (H1_isMuon[i] || H2_isMuon[i] || H3_isMuon[i]) {
+        continue;
+      }
+
+      constexpr double prob_k_cut = 0.5;
+      if (H1_ProbK[i] < prob_k_cut) continue;
+      if (H2_ProbK[i] < prob_k_cut) continue;
+      if (H3_ProbK[i] < prob_k_cut) continue;
+
+      constexpr double prob_pi_cut = 0.5;
+      if (H1_ProbPi[i] > prob_pi_cut) continue;
+      if (H2_ProbPi[i] > prob_pi_cut) continue;
+      if (H3_ProbPi[i] > prob_pi_cut) continue;
+
+      double b_px = H1_PX[i] + H2_PX[i] + H3_PX[i];
+      double b_py = H1_PY[i] + H2_PY[i] + H3_PY[i];
+      double b_pz = H1_PZ[i] + H2_PZ[i] + H3_PZ[i];
+      double b_p2 = GetP2(b_px, b_py, b_pz);
+      double k1_E = GetKE(H1_PX[i], H1_PY[i], H1_PZ[i]);
+      double k2_E = GetKE(H2_PX[i], H2_PY[i], H2_PZ[i]);
+      double k3_E = GetKE(H3_PX[i], H3_PY[i], H3_PZ[i]);
+      double b_E = k1_E + k2_E + k3_E;
+      double b_mass = sqrt(b_E*b_E - b_p2);
+      hMass->Fill(b_mass);
+    }
+    count += nEntries;
+  }
+  auto ts_end = std::chrono::steady_clock::now();
+  auto runtime_init = std::chrono::duration_cast<std::chrono::microseconds>(ts_first - ts_init).count();
+  auto runtime_analyze = std::chrono::duration_cast<std::chrono::microseconds>(ts_end - ts_first).count();
+
+  std::cout << "Runtime-Initialization: " << runtime_init << "us" << std::endl;
+  std::cout << "Runtime-Analysis: " << runtime_analyze << "us" << std::endl;
+
+  if (show)
+    Show(hMass);
+  delete hMass;
+
+  return 0;
+}
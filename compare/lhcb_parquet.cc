@@ -1,8 +1,5 @@
 #include "util_arrow.h"
 
-#include <arrow/io/api.h>
-#include <parquet/arrow/reader.h>
-
 #include <cassert>
 #include <chrono>
 #include <cstdio>
@@ -80,13 +77,7 @@ int main(int argc, char **argv) {
 
   auto ts_init = std::chrono::steady_clock::now();
 
-  std::shared_ptr<arrow::io::ReadableFile> infile;
-  PARQUET_ASSIGN_OR_THROW(infile,
-			  arrow::io::ReadableFile::Open(inputPath));
-  std::unique_ptr<parquet::arrow::FileReader> reader;
-  PARQUET_THROW_NOT_OK(parquet::arrow::OpenFile(infile, arrow::default_memory_pool(),
-						&reader));
-  reader->set_use_threads(true);
+  auto reader = OpenParquetFile(inputPath);
 
   std::shared_ptr<arrow::Schema> schema;
   reader->GetSchema(&schema);
@@ -97,58 +88,57 @@ int main(int argc, char **argv) {
 				   "H1_PX", "H1_PY", "H1_PZ",
 				   "H2_PX", "H2_PY", "H2_PZ",
 				   "H3_PX", "H3_PY", "H3_PZ"});
-  std::shared_ptr<arrow::Table> table;
 
   auto hMass = new TH1D("B_mass", "", 500, 5050, 5500);
 
   std::chrono::steady_clock::time_point ts_first = std::chrono::steady_clock::now();
   size_t count = 0;
-  for (size_t row_group = 0, num_row_groups = reader->num_row_groups();
-       row_group < num_row_groups; ++row_group) {
+  // Row group N+1 is read in the background while the cuts run on row group N
+  RowGroupPrefetcher prefetcher(reader.get(), columns);
+  while (auto table = prefetcher.Next()) {
     printf("processed %lu k events\n", count / 1000);
 
-    reader->ReadRowGroup(row_group, columns, &table);
-    auto H1_isMuon = std::static_pointer_cast<Int32Array>(table->GetColumnByName("H1_isMuon")->chunk(0));
-    auto H2_isMuon = std::static_pointer_cast<Int32Array>(table->GetColumnByName("H2_isMuon")->chunk(0));
-    auto H3_isMuon = std::static_pointer_cast<Int32Array>(table->GetColumnByName("H3_isMuon")->chunk(0));
-    auto H1_ProbK = std::static_pointer_cast<DoubleArray>(table->GetColumnByName("H1_ProbK")->chunk(0));
-    auto H2_ProbK = std::static_pointer_cast<DoubleArray>(table->GetColumnByName("H2_ProbK")->chunk(0));
-    auto H3_ProbK = std::static_pointer_cast<DoubleArray>(table->GetColumnByName("H3_ProbK")->chunk(0));
-    auto H1_ProbPi = std::static_pointer_cast<DoubleArray>(table->GetColumnByName("H1_ProbPi")->chunk(0));
-    auto H2_ProbPi = std::static_pointer_cast<DoubleArray>(table->GetColumnByName("H2_ProbPi")->chunk(0));
-    auto H3_ProbPi = std::static_pointer_cast<DoubleArray>(table->GetColumnByName("H3_ProbPi")->chunk(0));
-    auto H1_PX = std::static_pointer_cast<DoubleArray>(table->GetColumnByName("H1_PX")->chunk(0));
-    auto H1_PY = std::static_pointer_cast<DoubleArray>(table->GetColumnByName("H1_PY")->chunk(0));
-    auto H1_PZ = std::static_pointer_cast<DoubleArray>(table->GetColumnByName("H1_PZ")->chunk(0));
-    auto H2_PX = std::static_pointer_cast<DoubleArray>(table->GetColumnByName("H2_PX")->chunk(0));
-    auto H2_PY = std::static_pointer_cast<DoubleArray>(table->GetColumnByName("H2_PY")->chunk(0));
-    auto H2_PZ = std::static_pointer_cast<DoubleArray>(table->GetColumnByName("H2_PZ")->chunk(0));
-    auto H3_PX = std::static_pointer_cast<DoubleArray>(table->GetColumnByName("H3_PX")->chunk(0));
-    auto H3_PY = std::static_pointer_cast<DoubleArray>(table->GetColumnByName("H3_PY")->chunk(0));
-    auto H3_PZ = std::static_pointer_cast<DoubleArray>(table->GetColumnByName("H3_PZ")->chunk(0));
-
-    for (int64_t i = 0; i < table->num_rows(); ++i) {
-      if (H1_isMuon->Value(i) || H2_isMuon->Value(i) || H3_isMuon->Value(i)) {
+    auto H1_isMuon = GetRawValues<Int32Array>(table, "H1_isMuon");
+    auto H2_isMuon = GetRawValues<Int32Array>(table, "H2_isMuon");
+    auto H3_isMuon = GetRawValues<Int32Array>(table, "H3_isMuon");
+    auto H1_ProbK = GetRawValues<DoubleArray>(table, "H1_ProbK");
+    auto H2_ProbK = GetRawValues<DoubleArray>(table, "H2_ProbK");
+    auto H3_ProbK = GetRawValues<DoubleArray>(table, "H3_ProbK");
+    auto H1_ProbPi = GetRawValues<DoubleArray>(table, "H1_ProbPi");
+    auto H2_ProbPi = GetRawValues<DoubleArray>(table, "H2_ProbPi");
+    auto H3_ProbPi = GetRawValues<DoubleArray>(table, "H3_ProbPi");
+    auto H1_PX = GetRawValues<DoubleArray>(table, "H1_PX");
+    auto H1_PY = GetRawValues<DoubleArray>(table, "H1_PY");
+    auto H1_PZ = GetRawValues<DoubleArray>(table, "H1_PZ");
+    auto H2_PX = GetRawValues<DoubleArray>(table, "H2_PX");
+    auto H2_PY = GetRawValues<DoubleArray>(table, "H2_PY");
+    auto H2_PZ = GetRawValues<DoubleArray>(table, "H2_PZ");
+    auto H3_PX = GetRawValues<DoubleArray>(table, "H3_PX");
+    auto H3_PY = GetRawValues<DoubleArray>(table, "H3_PY");
+    auto H3_PZ = GetRawValues<DoubleArray>(table, "H3_PZ");
+
+    for (int64_t i = 0, num_rows = table->num_rows(); i < num_rows; ++i) {
+      if (H1_isMuon[i] || H2_isMuon[i] || H3_isMuon[i]) {
 	continue;
       }
 
       constexpr double prob_k_cut = 0.5;
-      if (H1_ProbK->Value(i) < prob_k_cut) continue;
-      if (H2_ProbK->Value(i) < prob_k_cut) continue;
-      if (H3_ProbK->Value(i) < prob_k_cut) continue;
+      if (H1_ProbK[i] < prob_k_cut) continue;
+      if (H2_ProbK[i] < prob_k_cut) continue;
+      if (H3_ProbK[i] < prob_k_cut) continue;
 
       constexpr double prob_pi_cut = 0.5;
-      if (H1_ProbPi->Value(i) > prob_pi_cut) continue;
-      if (H2_ProbPi->Value(i) > prob_pi_cut) continue;
-      if (H3_ProbPi->Value(i) > prob_pi_cut) continue;
+      if (H1_ProbPi[i] > prob_pi_cut) continue;
+      if (H2_ProbPi[i] > prob_pi_cut) continue;
+      if (H3_ProbPi[i] > prob_pi_cut) continue;
 
-      double b_px = H1_PX->Value(i) + H2_PX->Value(i) + H3_PX->Value(i);
-      double b_py = H1_PY->Value(i) + H2_PY->Value(i) + H3_PY->Value(i);
-      double b_pz = H1_PZ->Value(i) + H2_PZ->Value(i) + H3_PZ->Value(i);
+      double b_px = H1_PX[i] + H2_PX[i] + H3_PX[i];
+      double b_py = H1_PY[i] + H2_PY[i] + H3_PY[i];
+      double b_pz = H1_PZ[i] + H2_PZ[i] + H3_PZ[i];
       double b_p2 = GetP2(b_px, b_py, b_pz);
-      double k1_E = GetKE(H1_PX->Value(i), H1_PY->Value(i), H1_PZ->Value(i));
-      double k2_E = GetKE(H2_PX->Value(i), H2_PY->Value(i), H2_PZ->Value(i));
-      double k3_E = GetKE(H3_PX->Value(i), H3_PY->Value(i), H3_PZ->Value(i));
+      double k1_E = GetKE(H1_PX[i], H1_PY[i], H1_PZ[i]);
+      double k2_E = GetKE(H2_PX[i], H2_PY[i], H2_PZ[i]);
+      double k3_E = GetKE(H3_PX[i], H3_PY[i], H3_PZ[i]);
       double b_E = k1_E + k2_E + k3_E;
       double b_mass = sqrt(b_E*b_E - b_p2);
       hMass->Fill(b_mass);
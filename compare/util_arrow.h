@@ -6,27 +6,46 @@
 #define UTIL_ARROW_H_
 
 #include <arrow/builder.h>
+#include <arrow/io/api.h>
 #include <arrow/table.h>
+#include <parquet/arrow/reader.h>
+#include <parquet/properties.h>
 
+#include <algorithm>
+#include <cstdint>
 #include <functional>
+#include <future>
 #include <memory>
 #include <stdexcept>
+#include <string>
 #include <tuple>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
+static inline void ThrowIfError(const arrow::Status &status)
+{
+  if (!status.ok())
+    throw std::runtime_error(status.message());
+}
+
+/// \brief Pointer to the contiguous values accepted by `AppendValues()` of the
+/// array builder `T`; booleans are passed as one byte per value.
+template <class T>
+using ArrowConstValuePtr_t = typename std::conditional<std::is_same<T, arrow::BooleanBuilder>::value,
+						       const uint8_t*,
+						       const typename T::value_type*>::type;
+
 /// \brief Adapter to use list fields (i.e. `arrow::list`) in ArrowTableBuilder
 ///
 template <class T>
 class ListAdapter {
-  using ConstValuePtr_t = typename std::conditional<std::is_same<T, arrow::BooleanBuilder>::value,
-				      const uint8_t*,
-				      const typename T::value_type*>::type;
+  using ConstValuePtr_t = ArrowConstValuePtr_t<T>;
 
   arrow::MemoryPool *pool = arrow::default_memory_pool();
   arrow::ListBuilder listBuilder;
   T *valueBuilder;
+  std::vector<int32_t> rebasedOffsets;
 public:
   using value_type = std::pair<const void* /*data*/, int /*size*/>;
 
@@ -39,10 +58,99 @@ public:
     return valueBuilder->AppendValues(reinterpret_cast<ConstValuePtr_t>(val.first), val.second);
   }
 
+  /// \brief Append `length` lists at once; the i-th list holds the elements
+  /// `values[offsets[i]]` to `values[offsets[i + 1] - 1]`
+  arrow::Status AppendColumn(ConstValuePtr_t values, const int32_t *offsets, int64_t length) {
+    // The list builder takes offsets into its own value array
+    rebasedOffsets.resize(length);
+    const int32_t base = valueBuilder->length() - offsets[0];
+    for (int64_t i = 0; i < length; ++i)
+      rebasedOffsets[i] = offsets[i] + base;
+    ARROW_RETURN_NOT_OK(listBuilder.AppendValues(rebasedOffsets.data(), length));
+    return valueBuilder->AppendValues(values + offsets[0], offsets[length] - offsets[0]);
+  }
+
+  /// \brief Reserve space for `length` lists; the number of elements is unknown
+  arrow::Status Reserve(int64_t length) { return listBuilder.Reserve(length); }
+
   arrow::Result<std::shared_ptr<arrow::Array>> Finish()
   { return listBuilder.Finish(); }
 };
 
+/// \brief Column-wise view of an array builder of ArrowTableBuilder.  A column
+/// batch (`column_type`) is a pointer to contiguous values; for list fields, it
+/// is a pair of the element values and of the `n + 1` list offsets.
+template <class T>
+struct ArrowColumn {
+  using column_type = ArrowConstValuePtr_t<T>;
+
+  /// \brief Collects the values of consecutive rows in contiguous memory
+  class Buffer {
+    std::vector<typename std::remove_const<typename std::remove_pointer<column_type>::type>::type> values;
+  public:
+    void Append(const typename T::value_type &val) { values.push_back(val); }
+    column_type Get() const { return values.data(); }
+    void Clear() { values.clear(); }
+  };
+
+  static arrow::Status Append(T &builder, column_type column, int64_t first, int64_t length)
+  { return builder.AppendValues(column + first, length); }
+};
+
+template <class T>
+struct ArrowColumn<ListAdapter<T>> {
+  using column_type = std::pair<ArrowConstValuePtr_t<T> /*values*/, const int32_t* /*offsets*/>;
+
+  class Buffer {
+    std::vector<typename std::remove_const<typename std::remove_pointer<ArrowConstValuePtr_t<T>>::type>::type> values;
+    std::vector<int32_t> offsets{0};
+  public:
+    void Append(const typename ListAdapter<T>::value_type &val) {
+      auto first = reinterpret_cast<ArrowConstValuePtr_t<T>>(val.first);
+      values.insert(values.end(), first, first + val.second);
+      offsets.push_back(values.size());
+    }
+    column_type Get() const { return {values.data(), offsets.data()}; }
+    void Clear() { values.clear(); offsets.resize(1); }
+  };
+
+  static arrow::Status Append(ListAdapter<T> &builder, const column_type &column, int64_t first, int64_t length)
+  { return builder.AppendColumn(column.first, column.second + first, length); }
+};
+
+/// \brief Row-wise staging area for the bulk interface of ArrowTableBuilder:
+/// rows are appended to plain vectors, one per column, which are then handed to
+/// `ArrowTableBuilder::AppendColumns()` in one go.
+template <class... Ts>
+class ArrowColumnBatch {
+  std::tuple<typename ArrowColumn<Ts>::Buffer...> buffers;
+  size_t count = 0;
+
+  template <std::size_t... Is>
+  void AppendImpl(const std::tuple<typename Ts::value_type...>& values,
+		  std::index_sequence<Is...>)
+  {
+    ((std::get<Is>(buffers).Append(std::get<Is>(values))), ...);
+  }
+
+public:
+  size_t GetCount() const { return count; }
+
+  void Append(const std::tuple<typename Ts::value_type...>& values) {
+    AppendImpl(values, std::index_sequence_for<Ts...>{});
+    ++count;
+  }
+
+  std::tuple<typename ArrowColumn<Ts>::column_type...> GetColumns() const {
+    return std::apply([](const auto&... args) { return std::make_tuple(args.Get()...); }, buffers);
+  }
+
+  void Clear() {
+    std::apply([](auto&... args) { (args.Clear(), ...); }, buffers);
+    count = 0;
+  }
+};
+
 /// \brief Helper class to build a `arrow::Table` when a given row limit is
 /// reached. The constructed table is handed over to a user-specified function.
 ///
@@ -68,6 +176,11 @@ class ArrowTableBuilder {
     count = 0;
   }
 
+  /// Builders are reset by `Finish()`; size them for a full table up front
+  void Reserve() {
+    std::apply([this](Ts&... args) { ((ThrowIfError(args.Reserve(rowLimit))), ...); }, arrayBuilder);
+  }
+
   template <std::size_t... Is>
   void AppendImpl(const std::tuple<typename Ts::value_type...>& values,
 		  std::index_sequence<Is...>)
@@ -75,9 +188,17 @@ class ArrowTableBuilder {
     ((std::get<Is>(arrayBuilder).Append(std::get<Is>(values))), ...);
   }
 
+  template <std::size_t... Is>
+  void AppendColumnsImpl(const std::tuple<typename ArrowColumn<Ts>::column_type...>& columns,
+			 size_t first, size_t length, std::index_sequence<Is...>)
+  {
+    ((ThrowIfError(ArrowColumn<Ts>::Append(std::get<Is>(arrayBuilder), std::get<Is>(columns),
+					   first, length))), ...);
+  }
+
 public:
   ArrowTableBuilder(std::shared_ptr<arrow::Schema> schema, size_t rowLimit, Callback_t cb)
-    : schema(schema), rowLimit(rowLimit), doSomethingWithTable(cb) {}
+    : schema(schema), rowLimit(rowLimit), doSomethingWithTable(cb) { Reserve(); }
   ~ArrowTableBuilder() { if (count) MakeTable(); }
 
   size_t GetCount() const { return count; }
@@ -86,9 +207,29 @@ public:
   /// i-th value in `values` shall be appended to `std::get<i>(arrayBuilder)`
   void Append(const std::tuple<typename Ts::value_type...>& values) {
     AppendImpl(values, std::index_sequence_for<Ts...>{});
-    if (++count == rowLimit)
+    if (++count == rowLimit) {
       MakeTable();
+      Reserve();
+    }
   }
+
+  /// \brief Append `nRows` rows given as one batch per column, see
+  /// ArrowColumn.  Tables are still emitted every `rowLimit` rows.
+  void AppendColumns(size_t nRows, const std::tuple<typename ArrowColumn<Ts>::column_type...>& columns) {
+    for (size_t first = 0; first < nRows; ) {
+      size_t length = std::min(nRows - first, rowLimit - count);
+      AppendColumnsImpl(columns, first, length, std::index_sequence_for<Ts...>{});
+      first += length;
+      count += length;
+      if (count == rowLimit) {
+	MakeTable();
+	Reserve();
+      }
+    }
+  }
+
+  void AppendColumns(const ArrowColumnBatch<Ts...>& batch)
+  { AppendColumns(batch.GetCount(), batch.GetColumns()); }
 };
 
 template <class... Ts>
@@ -113,4 +254,74 @@ GetColumnIndices(const std::shared_ptr<arrow::Schema> schema, const std::vector<
   return ret;
 }
 
+/// \brief Open a Parquet file for reading with multi-threaded column decoding.
+/// With pre-buffering, the column chunks of a row group are fetched in a few
+/// coalesced reads instead of one read per page.
+static inline std::unique_ptr<parquet::arrow::FileReader>
+OpenParquetFile(const std::string &path)
+{
+  std::shared_ptr<arrow::io::ReadableFile> infile;
+  PARQUET_ASSIGN_OR_THROW(infile, arrow::io::ReadableFile::Open(path));
+  parquet::ArrowReaderProperties properties;
+  properties.set_use_threads(true);
+  properties.set_pre_buffer(true);
+  parquet::arrow::FileReaderBuilder builder;
+  PARQUET_THROW_NOT_OK(builder.Open(infile));
+  std::unique_ptr<parquet::arrow::FileReader> reader;
+  PARQUET_THROW_NOT_OK(builder.properties(properties)->Build(&reader));
+  return reader;
+}
+
+/// \brief Reads the given columns of consecutive row groups.  The next row
+/// group is read on a background thread while the caller processes the current
+/// one.  The reader must not be used otherwise while the prefetcher is alive.
+class RowGroupPrefetcher {
+  parquet::arrow::FileReader *reader;
+  std::vector<int> columns;
+  int nextRowGroup = 0;
+  std::future<std::shared_ptr<arrow::Table>> pending;
+
+  void Issue() {
+    if (nextRowGroup >= reader->num_row_groups())
+      return;
+    pending = std::async(std::launch::async, [this, rowGroup = nextRowGroup++]() {
+      std::shared_ptr<arrow::Table> table;
+      PARQUET_THROW_NOT_OK(reader->ReadRowGroup(rowGroup, columns, &table));
+      // One chunk per column, such that the values of a column are contiguous
+      PARQUET_ASSIGN_OR_THROW(table, table->CombineChunks());
+      return table;
+    });
+  }
+
+public:
+  RowGroupPrefetcher(parquet::arrow::FileReader *reader, const std::vector<int> &columns)
+    : reader(reader), columns(columns) { Issue(); }
+
+  /// \brief Return the next row group, or `nullptr` after the last one
+  std::shared_ptr<arrow::Table> Next() {
+    if (!pending.valid())
+      return nullptr;
+    auto table = pending.get();
+    Issue();
+    return table;
+  }
+};
+
+/// \brief Return the values of a primitive column of a table read by
+/// `RowGroupPrefetcher`.  The pointer is valid as long as the table is.
+template <class ArrayT>
+static inline const typename ArrayT::value_type *
+GetRawValues(const std::shared_ptr<arrow::Table> &table, const std::string &name)
+{
+  return std::static_pointer_cast<ArrayT>(table->GetColumnByName(name)->chunk(0))->raw_values();
+}
+
+/// \brief Return the list array of a list column of a table read by
+/// `RowGroupPrefetcher`; use `raw_value_offsets()` and the `values()` array.
+static inline std::shared_ptr<arrow::ListArray>
+GetListArray(const std::shared_ptr<arrow::Table> &table, const std::string &name)
+{
+  return std::static_pointer_cast<arrow::ListArray>(table->GetColumnByName(name)->chunk(0));
+}
+
 #endif // UTIL_ARROW_H_
@@ -0,0 +1,341 @@
+#include <ROOT/RNTupleModel.hxx>
+#include <ROOT/RNTupleReader.hxx>
+#include <ROOT/RNTupleReadOptions.hxx>
+#include <ROOT/RNTupleView.hxx>
+
+#include <TROOT.h>
+#include <TSystem.h>
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "util.h"
+#include "TriggerRecord.hxx"
+
+#include <hdf5_hl.h>
+
+using ROOT::Experimental::RNTupleModel;
+using ROOT::Experimental::RNTupleReader;
+using ROOT::Experimental::RNTupleReadOptions;
+using ENTupleInfo = ROOT::Experimental::ENTupleInfo;
+
+/// The parts of a trigger record that are read
+enum class EAccessPattern {
+   kUnit,             ///< The WIBEth streams of a single detector unit
+   kTriggerPrimitive, ///< All trigger primitive streams
+   kFull              ///< The entire record
+};
+
+bool g_perf_stats = false;
+unsigned int g_cluster_bunch_size = 1;
+EAccessPattern g_access = EAccessPattern::kUnit;
+int g_unit = 0;
+
+static RNTupleReadOptions GetRNTupleOptions() {
+   RNTupleReadOptions options;
+   if (g_cluster_bunch_size < 1) {
+      options.SetClusterCache(RNTupleReadOptions::EClusterCache::kOff);
+   } else {
+      options.SetClusterBunchSize(g_cluster_bunch_size);
+   }
+   return options;
+}
+
+/// Touches every byte of the stream so that all access patterns and formats do the same work per byte read
+static std::uint64_t Checksum(const std::byte *data, std::size_t size) {
+   std::uint64_t sum = 0;
+   for (std::size_t i = 0; i < size; ++i)
+      sum += static_cast<unsigned char>(data[i]);
+   return sum;
+}
+
+static void PrintResults(std::chrono::steady_clock::time_point ts_init,
+                         std::chrono::steady_clock::time_point ts_first,
+                         std::uint64_t nevents, std::uint64_t nbytes, std::uint64_t checksum)
+{
+   auto ts_end = std::chrono::steady_clock::now();
+   auto runtime_init = std::chrono::duration_cast<std::chrono::microseconds>(ts_first - ts_init).count();
+   auto runtime_analyze = std::chrono::duration_cast<std::chrono::microseconds>(ts_end - ts_first).count();
+
+   std::cout << "Read " << nbytes / 1000 << " kB from " << nevents << " trigger records (checksum " << checksum
+             << ")" << std::endl;
+   std::cout << "Throughput: " << static_cast<double>(nbytes) / runtime_analyze << " MB/s, "
+             << nevents * 1e6 / runtime_analyze << " events/s" << std::endl;
+   std::cout << "Runtime-Initialization: " << runtime_init << "us" << std::endl;
+   std::cout << "Runtime-Analysis: " << runtime_analyze << "us" << std::endl;
+}
+
+
+static void NTupleDirect(const std::string &path) {
+   auto ts_init = std::chrono::steady_clock::now();
+
+   gSystem->Load("./libTriggerRecord.so");
+
+   auto model = RNTupleModel::Create();
+   auto options = GetRNTupleOptions();
+   auto ntuple = RNTupleReader::Open(std::move(model), "DUNE", path, options);
+   if (g_perf_stats)
+      ntuple->EnableMetrics();
+
+   std::uint64_t nevents = 0;
+   std::uint64_t nbytes = 0;
+   std::uint64_t checksum = 0;
+   auto addStream = [&](const TriggerRecord::Stream &stream) {
+      nbytes += stream.fData.size();
+      checksum += Checksum(stream.fData.data(), stream.fData.size());
+   };
+
+   std::chrono::steady_clock::time_point ts_first;
+   switch (g_access) {
+   case EAccessPattern::kUnit: {
+      // Only the columns of the requested unit are read
+      char fieldName[64];
+      snprintf(fieldName, sizeof(fieldName), "TriggerRecords.fDetectors.fUnit%03d", g_unit);
+      auto viewUnit = ntuple->GetView<TriggerRecord::DetectorUnit>(fieldName);
+      ts_first = std::chrono::steady_clock::now();
+      for (auto entryId : ntuple->GetEntryRange()) {
+         const auto &unit = viewUnit(entryId);
+         for (int s = 0; s < TriggerRecord::kNStreamsPerUnit; ++s) {
+            auto stream = reinterpret_cast<const TriggerRecord::Stream *>(
+               reinterpret_cast<const unsigned char *>(&unit) + TriggerRecord::kStreamOffsets[s]);
+            if (stream->fDataType == TriggerRecord::EDataType::kWIBEth)
+               addStream(*stream);
+         }
+         nevents++;
+      }
+      break;
+   }
+   case EAccessPattern::kTriggerPrimitive: {
+      auto viewTriggers = ntuple->GetView<TriggerRecord::Triggers>("TriggerRecords.fTriggers");
+      ts_first = std::chrono::steady_clock::now();
+      for (auto entryId : ntuple->GetEntryRange()) {
+         const auto &triggers = viewTriggers(entryId);
+         for (int s = 0; s < TriggerRecord::kNTriggers; ++s) {
+            auto stream = reinterpret_cast<const TriggerRecord::Stream *>(
+               reinterpret_cast<const unsigned char *>(&triggers) + TriggerRecord::kTriggerStreamOffsets[s]);
+            if (stream->fDataType == TriggerRecord::EDataType::kTriggerPrimitive)
+               addStream(*stream);
+         }
+         nevents++;
+      }
+      break;
+   }
+   case EAccessPattern::kFull: {
+      auto viewTR = ntuple->GetView<TriggerRecord>("TriggerRecords");
+      ts_first = std::chrono::steady_clock::now();
+      for (auto entryId : ntuple->GetEntryRange()) {
+         // The getters are non-const; the view's object is not modified
+         auto &tr = const_cast<TriggerRecord &>(viewTR(entryId));
+         for (int u = 0; u < TriggerRecord::kNUnits; ++u) {
+            for (int s = 0; s < TriggerRecord::kNStreamsPerUnit; ++s)
+               addStream(*tr.GetReadoutStream(u, s));
+         }
+         for (int s = 0; s < TriggerRecord::kNHWSignalsInterfaces; ++s)
+            addStream(*tr.GetHWSignalsInterfaceStream(s));
+         for (int s = 0; s < TriggerRecord::kNTriggers; ++s)
+            addStream(*tr.GetTriggerStream(s));
+         for (int s = 0; s < TriggerRecord::kNTRBuilders; ++s)
+            addStream(*tr.GetTRBuilderStream(s));
+         nevents++;
+      }
+      break;
+   }
+   }
+
+   PrintResults(ts_init, ts_first, nevents, nbytes, checksum);
+   if (g_perf_stats)
+      ntuple->PrintInfo(ENTupleInfo::kMetrics);
+}
+
+
+extern "C" herr_t FillGroups(hid_t loc_id, const char *name, const H5L_info_t *, void *groups)
+{
+   hid_t oid = H5Oopen(loc_id, name, H5P_DEFAULT);
+   H5O_info_t info;
+   H5Oget_info(oid, &info, H5O_INFO_BASIC);
+   if (info.type == H5O_TYPE_GROUP) {
+      static_cast<std::vector<std::string> *>(groups)->emplace_back(name);
+   }
+   H5Oclose(oid);
+   return 0;
+}
+
+extern "C" herr_t FillDatasets(hid_t loc_id, const char *name, const H5L_info_t *, void *datasets)
+{
+   hid_t oid = H5Oopen(loc_id, name, H5P_DEFAULT);
+   H5O_info_t info;
+   H5Oget_info(oid, &info, H5O_INFO_BASIC);
+   if (info.type == H5O_TYPE_DATASET) {
+      static_cast<std::vector<std::string> *>(datasets)->emplace_back(name);
+   }
+   H5Oclose(oid);
+   return 0;
+}
+
+/// Matches the raw data set names of the original file against the access pattern, following the name
+/// conventions used by gen_dune to map data sets to streams
+static bool IsSelected(const std::string &ds) {
+   switch (g_access) {
+   case EAccessPattern::kUnit: {
+      if (ds.find("Detector_Readout") != 0 || ds.find("WIBEth") == std::string::npos)
+         return false;
+      auto tail = ds.substr(17);
+      int unit = -1;
+      sscanf(tail.substr(0, tail.find_first_of("_")).c_str(), "%x", &unit);
+      return unit == g_unit;
+   }
+   case EAccessPattern::kTriggerPrimitive:
+      return ds.find("Trigger") == 0 && ds.find("Trigger_Primitive") != std::string::npos;
+   case EAccessPattern::kFull:
+      return true;
+   }
+   return false;
+}
+
+static void H5Direct(const std::string &path) {
+   auto ts_init = std::chrono::steady_clock::now();
+
+   auto fid = H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+   assert(fid >= 0);
+   auto gid_root = H5Gopen(fid, "/", H5P_DEFAULT);
+   assert(gid_root >= 0);
+
+   std::vector<std::string> triggerRecords;
+   H5Literate(gid_root, H5_INDEX_NAME, H5_ITER_NATIVE, NULL, FillGroups, &triggerRecords);
+
+   std::uint64_t nevents = 0;
+   std::uint64_t nbytes = 0;
+   std::uint64_t checksum = 0;
+   std::vector<std::byte> buffer;
+   std::vector<std::string> datasets;
+
+   auto ts_first = std::chrono::steady_clock::now();
+   for (const auto &tr : triggerRecords) {
+      auto gid_tr = H5Gopen(gid_root, tr.c_str(), H5P_DEFAULT);
+      assert(gid_tr >= 0);
+      auto gid_rawdata = H5Gopen(gid_tr, "RawData", H5P_DEFAULT);
+      assert(gid_rawdata >= 0);
+
+      datasets.clear();
+      H5Literate(gid_rawdata, H5_INDEX_NAME, H5_ITER_NATIVE, NULL, FillDatasets, &datasets);
+      for (const auto &ds : datasets) {
+         if (!IsSelected(ds))
+            continue;
+
+         auto did = H5Dopen2(gid_rawdata, ds.c_str(), H5P_DEFAULT);
+         assert(did >= 0);
+         auto sid = H5Dget_space(did);
+         assert(sid >= 0);
+         auto size = H5Sget_simple_extent_npoints(sid);
+         assert(size >= 0);
+         buffer.resize(size);
+         auto retval = H5Dread(did, H5T_STD_I8LE, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer.data());
+         assert(retval >= 0);
+         nbytes += size;
+         checksum += Checksum(buffer.data(), size);
+         H5Sclose(sid);
+         H5Dclose(did);
+      }
+
+      H5Gclose(gid_rawdata);
+      H5Gclose(gid_tr);
+      nevents++;
+   }
+
+   PrintResults(ts_init, ts_first, nevents, nbytes, checksum);
+
+   H5Gclose(gid_root);
+   H5Fclose(fid);
+}
+
+
+static void Usage(const char *progname) {
+  printf("%s [-i input.ntuple/hdf5] [-a unit|tp|full (access pattern)] [-u detector unit (0)] [-m(t)]\n"
+         "   [-p(erformance stats)] [-x cluster bunch size]\n",
+         progname);
+}
+
+int main(int argc, char **argv) {
+   auto ts_init = std::chrono::steady_clock::now();
+
+   std::string path;
+   std::string access;
+   int c;
+   while ((c = getopt(argc, argv, "hvpmi:x:a:u:")) != -1) {
+      switch (c) {
+      case 'h':
+      case 'v':
+         Usage(argv[0]);
+         return 0;
+      case 'i':
+         path = optarg;
+         break;
+      case 'p':
+         g_perf_stats = true;
+         break;
+      case 'm':
+         ROOT::EnableImplicitMT();
+         break;
+      case 'x':
+         g_cluster_bunch_size = atoi(optarg);
+         break;
+      case 'a':
+         access = optarg;
+         if (access == "unit") {
+            g_access = EAccessPattern::kUnit;
+         } else if (access == "tp") {
+            g_access = EAccessPattern::kTriggerPrimitive;
+         } else if (access == "full") {
+            g_access = EAccessPattern::kFull;
+         } else {
+            fprintf(stderr, "Unknown access pattern: %s\n", optarg);
+            return 1;
+         }
+         break;
+      case 'u':
+         g_unit = atoi(optarg);
+         break;
+      default:
+         fprintf(stderr, "Unknown option: -%c\n", c);
+         Usage(argv[0]);
+         return 1;
+      }
+   }
+   if (path.empty()) {
+      Usage(argv[0]);
+      return 1;
+   }
+   if (g_unit < 0 || g_unit >= TriggerRecord::kNUnits) {
+      fprintf(stderr, "Detector unit must be in [0, %d)\n", TriggerRecord::kNUnits);
+      return 1;
+   }
+
+   auto suffix = GetSuffix(path);
+   switch (GetFileFormat(suffix)) {
+   case FileFormats::kNtuple:
+      NTupleDirect(path);
+      break;
+   case FileFormats::kH5:
+      H5Direct(path);
+      break;
+   default:
+      std::cerr << "Invalid file format: " << suffix << std::endl;
+      return 1;
+   }
+
+   auto ts_end = std::chrono::steady_clock::now();
+   auto runtime_main = std::chrono::duration_cast<std::chrono::microseconds>(ts_end - ts_init).count();
+   std::cout << "Runtime-Main: " << runtime_main << "us" << std::endl;
+
+   return 0;
+}
@@ -0,0 +1,211 @@
+// Compares plain compression of the trigger record streams with compression after the per data type
+// stream transform (adc_codec.h): compression ratio and decode throughput, i.e. decompression plus the
+// inverse transform.  Every stream is compressed in pages like RNTuple would do and verified after decoding.
+
+#include <ROOT/RNTupleModel.hxx>
+#include <ROOT/RNTupleReader.hxx>
+#include <ROOT/RNTupleView.hxx>
+#include <ROOT/RNTupleZip.hxx>
+
+#include <TSystem.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "adc_codec.h"
+#include "util.h"
+#include "TriggerRecord.hxx"
+
+using ROOT::Experimental::RNTupleModel;
+using ROOT::Experimental::RNTupleReader;
+using RNTupleCompressor = ROOT::Experimental::Detail::RNTupleCompressor;
+using RNTupleDecompressor = ROOT::Experimental::Detail::RNTupleDecompressor;
+
+static const char *GetDataTypeName(TriggerRecord::EDataType type)
+{
+   switch (type) {
+   case TriggerRecord::EDataType::kWIBEth: return "WIBEth";
+   case TriggerRecord::EDataType::kDAPHNEStream: return "DAPHNEStream";
+   case TriggerRecord::EDataType::kTriggerRecordHeader: return "TriggerRecordHeader";
+   case TriggerRecord::EDataType::kTriggerCandidate: return "TriggerCandidate";
+   case TriggerRecord::EDataType::kTriggerActivity: return "TriggerActivity";
+   case TriggerRecord::EDataType::kTriggerPrimitive: return "TriggerPrimitive";
+   case TriggerRecord::EDataType::kHardwareSignal: return "HardwareSignal";
+   }
+   return "unknown";
+}
+
+struct RCodecStats {
+   std::uint64_t fNBytesRaw = 0;
+   std::uint64_t fNBytesZipped = 0;
+   double fDecodeSeconds = 0.0;
+};
+
+/// Encodes, compresses, decompresses, and decodes streams with a given transform and compression setting
+class RCodecBenchmark {
+   const RStreamTransform &fTransform;
+   int fCompression;
+   std::size_t fPageSize;
+
+   RNTupleCompressor &fCompressor;
+   RNTupleDecompressor &fDecompressor;
+   std::vector<std::byte> fEncoded;
+   std::vector<std::byte> fUnzipped;
+   std::vector<std::byte> fDecoded;
+   /// Compressed pages of the current stream and their uncompressed size
+   std::vector<std::pair<std::vector<unsigned char>, std::size_t>> fPages;
+
+public:
+   RCodecStats fStats;
+
+   RCodecBenchmark(const RStreamTransform &transform, int compression, std::size_t pageSize,
+                   RNTupleCompressor &compressor, RNTupleDecompressor &decompressor)
+      : fTransform(transform), fCompression(compression), fPageSize(pageSize), fCompressor(compressor),
+        fDecompressor(decompressor)
+   {
+   }
+
+   void Process(const ROOT::RVec<std::byte> &data)
+   {
+      fTransform.Encode(data.data(), data.size(), fEncoded);
+      fPages.clear();
+      for (std::size_t offset = 0; offset < fEncoded.size(); offset += fPageSize) {
+         const auto size = std::min(fPageSize, fEncoded.size() - offset);
+         const auto zippedSize = fCompressor(fEncoded.data() + offset, size, fCompression);
+         auto zipped = reinterpret_cast<const unsigned char *>(fCompressor.GetZipBuffer());
+         fPages.emplace_back(std::vector<unsigned char>(zipped, zipped + zippedSize), size);
+         fStats.fNBytesZipped += zippedSize;
+      }
+      fStats.fNBytesRaw += data.size();
+
+      auto ts_start = std::chrono::steady_clock::now();
+      fUnzipped.resize(fEncoded.size());
+      std::size_t offset = 0;
+      for (const auto &[zipped, size] : fPages) {
+         fDecompressor(zipped.data(), zipped.size(), size, fUnzipped.data() + offset);
+         offset += size;
+      }
+      fTransform.Decode(fUnzipped.data(), fUnzipped.size(), fDecoded);
+      fStats.fDecodeSeconds +=
+         std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - ts_start).count() /
+         1e6;
+
+      if (fDecoded != data) {
+         std::cerr << "Round-trip mismatch with transform " << fTransform.GetName() << std::endl;
+         abort();
+      }
+   }
+};
+
+static void Usage(const char *progname)
+{
+   printf("%s -i <input.ntuple> [-c compression (repeatable; default zstd lz4)] [-b <page size in kB (64)>]\n",
+          progname);
+}
+
+int main(int argc, char **argv)
+{
+   std::string path;
+   std::vector<std::string> compressions;
+   std::size_t pageSize = 64 * 1024;
+   int c;
+   while ((c = getopt(argc, argv, "hvi:c:b:")) != -1) {
+      switch (c) {
+      case 'h':
+      case 'v':
+         Usage(argv[0]);
+         return 0;
+      case 'i':
+         path = optarg;
+         break;
+      case 'c':
+         compressions.emplace_back(optarg);
+         break;
+      case 'b':
+         pageSize = std::max(1, atoi(optarg)) * 1024;
+         break;
+      default:
+         fprintf(stderr, "Unknown option: -%c\n", c);
+         Usage(argv[0]);
+         return 1;
+      }
+   }
+   if (path.empty()) {
+      Usage(argv[0]);
+      return 1;
+   }
+   if (compressions.empty())
+      compressions = {"zstd", "lz4"};
+
+   gSystem->Load("./libTriggerRecord.so");
+
+   auto ntuple = RNTupleReader::Open(RNTupleModel::Create(), "DUNE", path);
+   auto viewTR = ntuple->GetView<TriggerRecord>("TriggerRecords");
+
+   // Per data type and compression: plain compression and compression after the transform
+   std::map<std::pair<TriggerRecord::EDataType, std::string>, std::pair<RCodecBenchmark, RCodecBenchmark>> benchmarks;
+   static const RIdentityTransform identity;
+   RNTupleCompressor compressor;
+   RNTupleDecompressor decompressor;
+   auto processStream = [&](const TriggerRecord::Stream &stream) {
+      if (stream.fData.empty())
+         return;
+      for (const auto &compression : compressions) {
+         auto key = std::make_pair(stream.fDataType, compression);
+         auto itr = benchmarks.find(key);
+         if (itr == benchmarks.end()) {
+            const auto settings = GetCompressionSettings(compression);
+            itr = benchmarks
+                     .emplace(std::piecewise_construct, std::forward_as_tuple(key),
+                              std::forward_as_tuple(
+                                 RCodecBenchmark(identity, settings, pageSize, compressor, decompressor),
+                                 RCodecBenchmark(GetStreamTransform(stream.fDataType), settings, pageSize,
+                                                 compressor, decompressor)))
+                     .first;
+         }
+         itr->second.first.Process(stream.fData);
+         itr->second.second.Process(stream.fData);
+      }
+   };
+
+   for (auto entryId : ntuple->GetEntryRange()) {
+      // The getters are non-const; the view's object is not modified
+      auto &tr = const_cast<TriggerRecord &>(viewTR(entryId));
+      for (int u = 0; u < TriggerRecord::kNUnits; ++u) {
+         for (int s = 0; s < TriggerRecord::kNStreamsPerUnit; ++s)
+            processStream(*tr.GetReadoutStream(u, s));
+      }
+      for (int s = 0; s < TriggerRecord::kNHWSignalsInterfaces; ++s)
+         processStream(*tr.GetHWSignalsInterfaceStream(s));
+      for (int s = 0; s < TriggerRecord::kNTriggers; ++s)
+         processStream(*tr.GetTriggerStream(s));
+      for (int s = 0; s < TriggerRecord::kNTRBuilders; ++s)
+         processStream(*tr.GetTRBuilderStream(s));
+   }
+
+   printf("%-20s %-6s %-12s %12s %8s %14s\n", "data type", "zip", "transform", "raw [MB]", "ratio", "decode [MB/s]");
+   for (const auto &[key, bms] : benchmarks) {
+      for (const auto *bm : {&bms.first, &bms.second}) {
+         const auto &stats = bm->fStats;
+         const auto transformName =
+            (bm == &bms.first) ? identity.GetName() : GetStreamTransform(key.first).GetName();
+         printf("%-20s %-6s %-12s %12.2f %8.2f %14.1f\n", GetDataTypeName(key.first), key.second.c_str(),
+                transformName, stats.fNBytesRaw / 1e6, double(stats.fNBytesRaw) / stats.fNBytesZipped,
+                stats.fNBytesRaw / 1e6 / stats.fDecodeSeconds);
+      }
+   }
+
+   return 0;
+}
@@ -3,27 +3,480 @@
  */
 
 #define _FILE_OFFSET_BITS 64
-#define FUSE_USE_VERSION 26
+#define FUSE_USE_VERSION 31
 
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <fuse.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
+#include <deque>
+#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "io_trace.h"
 
 using namespace std;
 
+/// A trace record and the log file it belongs to
+struct TraceEntry {
+  IoTraceRecord record;
+  int fd_log;
+};
+
+/**
+ * Trace records of a single FUSE worker thread.  Single producer (the worker)
+ * and single consumer (the drain thread); if the drain thread falls behind,
+ * records are dropped rather than stalling the read.  When the worker exits,
+ * the ring is reused by another thread once it is drained.
+ */
+struct TraceRing {
+  static const uint64_t kCapacity = 1 << 16;
+
+  TraceEntry entries[kCapacity];
+  alignas(64) atomic<uint64_t> head{0};
+  alignas(64) atomic<uint64_t> tail{0};
+  atomic<uint64_t> ndropped{0};
+  /// The worker exited; protected by the tracer's lock
+  bool is_released = false;
+
+  void Push(const TraceEntry &entry) {
+    uint64_t h = head.load(memory_order_relaxed);
+    if (h - tail.load(memory_order_acquire) == kCapacity) {
+      ndropped.fetch_add(1, memory_order_relaxed);
+      return;
+    }
+    entries[h % kCapacity] = entry;
+    head.store(h + 1, memory_order_release);
+  }
+};
+
+/**
+ * Collects the trace rings of all worker threads and periodically writes
+ * their records to the per-file logs.  Log files are closed by the drain
+ * thread, after the records that precede the release have been written.
+ * FUSE starts and stops worker threads on demand, so the rings of exited
+ * threads are kept on a free list instead of allocating one per thread.
+ */
+class Tracer {
+ public:
+  void Start() {
+    is_stopped_ = false;
+    drain_thread_ = thread(&Tracer::DrainMain, this);
+  }
+
+  void Stop() {
+    {
+      lock_guard<mutex> guard(lock_);
+      is_stopped_ = true;
+    }
+    cond_stop_.notify_one();
+    drain_thread_.join();
+    Drain();
+    uint64_t ndropped = 0;
+    for (auto &r : rings_)
+      ndropped += r->ndropped.load();
+    if (ndropped > 0)
+      fprintf(stderr, "fuse_forward: dropped %lu trace records\n", ndropped);
+  }
+
+  void Push(const TraceEntry &entry) {
+    thread_local RingOwner owner;
+    if (owner.ring == NULL) {
+      owner.tracer = this;
+      owner.ring = AcquireRing();
+    }
+    owner.ring->Push(entry);
+  }
+
+  void CloseLog(int fd_log) {
+    lock_guard<mutex> guard(lock_);
+    pending_close_.push_back(fd_log);
+  }
+
+ private:
+  /// Hands the ring of a worker thread back to the tracer when the thread exits
+  struct RingOwner {
+    Tracer *tracer = NULL;
+    TraceRing *ring = NULL;
+    ~RingOwner() {
+      if (ring != NULL)
+        tracer->ReleaseRing(ring);
+    }
+  };
+
+  TraceRing *AcquireRing() {
+    lock_guard<mutex> guard(lock_);
+    if (!free_rings_.empty()) {
+      TraceRing *ring = free_rings_.back();
+      free_rings_.pop_back();
+      return ring;
+    }
+    rings_.emplace_back(new TraceRing());
+    return rings_.back().get();
+  }
+
+  void ReleaseRing(TraceRing *ring) {
+    lock_guard<mutex> guard(lock_);
+    ring->is_released = true;
+  }
+
+  void DrainMain() {
+    unique_lock<mutex> guard(lock_);
+    while (!is_stopped_) {
+      cond_stop_.wait_for(guard, chrono::milliseconds(10));
+      guard.unlock();
+      Drain();
+      guard.lock();
+    }
+  }
+
+  void Drain() {
+    vector<TraceRing *> rings;
+    vector<TraceRing *> released;
+    vector<int> closes;
+    {
+      lock_guard<mutex> guard(lock_);
+      for (auto &r : rings_) {
+        rings.push_back(r.get());
+        if (r->is_released)
+          released.push_back(r.get());
+      }
+      closes.swap(pending_close_);
+    }
+
+    // All reads of a released file were pushed before the release, so they
+    // are in the rings by now
+    for (auto r : rings) {
+      uint64_t t = r->tail.load(memory_order_relaxed);
+      uint64_t h = r->head.load(memory_order_acquire);
+      for (; t < h; ++t) {
+        const TraceEntry &entry = r->entries[t % TraceRing::kCapacity];
+        batches_[entry.fd_log].push_back(entry.record);
+      }
+      r->tail.store(h, memory_order_release);
+    }
+    // The workers of released rings have exited before the rings were
+    // collected above, so these rings are empty now
+    {
+      lock_guard<mutex> guard(lock_);
+      for (auto r : released) {
+        r->is_released = false;
+        free_rings_.push_back(r);
+      }
+    }
+    for (auto &b : batches_) {
+      if (b.second.empty())
+        continue;
+      ssize_t nbytes = write(b.first, b.second.data(),
+                             b.second.size() * sizeof(IoTraceRecord));
+      assert(nbytes == static_cast<ssize_t>(
+                         b.second.size() * sizeof(IoTraceRecord)));
+      (void)nbytes;
+      b.second.clear();
+    }
+
+    for (auto fd_log : closes) {
+      batches_.erase(fd_log);
+      close(fd_log);
+    }
+  }
+
+  mutex lock_;
+  condition_variable cond_stop_;
+  bool is_stopped_ = true;
+  thread drain_thread_;
+  vector<unique_ptr<TraceRing>> rings_;
+  /// Drained rings of exited threads, ready for reuse
+  vector<TraceRing *> free_rings_;
+  vector<int> pending_close_;
+  /// Only used by the drain thread
+  map<int, vector<IoTraceRecord>> batches_;
+};
+
+/**
+ * Emulates a slower storage device on top of the physical file system.  Every
+ * read completes no earlier than the fixed request latency after it was
+ * issued.  Seek and transfer time are spent on a single device that serves
+ * one read at a time: the seek penalty is proportional to the distance from
+ * the end of the previous read, the transfer time follows from the bandwidth.
+ * A read from another file than the previous one counts as the longest seek.
+ */
+class StorageModel {
+ public:
+  StorageModel(uint64_t latency_ns, uint64_t bandwidth_bps,
+               double seek_ns_per_byte, uint64_t seek_max_ns)
+    : latency_ns_(latency_ns)
+    , bandwidth_bps_(bandwidth_bps)
+    , seek_ns_per_byte_(seek_ns_per_byte)
+    , seek_max_ns_(seek_max_ns)
+  { }
+
+  bool IsActive() const {
+    return (latency_ns_ > 0) || (bandwidth_bps_ > 0) || (seek_ns_per_byte_ > 0);
+  }
+
+  /// Returns the time when a read issued at t_issue_ns is complete
+  uint64_t Schedule(uint64_t t_issue_ns, int fd, uint64_t offset,
+                    uint32_t size)
+  {
+    uint64_t t_ready_ns = t_issue_ns + latency_ns_;
+    if ((bandwidth_bps_ == 0) && (seek_ns_per_byte_ == 0))
+      return t_ready_ns;
+
+    uint64_t transfer_ns = 0;
+    if (bandwidth_bps_ > 0)
+      transfer_ns = static_cast<uint64_t>(size) * 1000000000 / bandwidth_bps_;
+
+    lock_guard<mutex> guard(lock_);
+    uint64_t seek_ns = 0;
+    if (fd != head_fd_) {
+      seek_ns = seek_max_ns_;
+    } else {
+      uint64_t distance = (offset > head_offset_) ?
+                          offset - head_offset_ : head_offset_ - offset;
+      seek_ns = distance * seek_ns_per_byte_;
+      if (seek_max_ns_ > 0)
+        seek_ns = min(seek_ns, seek_max_ns_);
+    }
+    uint64_t t_done_ns = max(t_ready_ns, busy_until_ns_) + seek_ns +
+                         transfer_ns;
+    busy_until_ns_ = t_done_ns;
+    head_fd_ = fd;
+    head_offset_ = offset + size;
+    return t_done_ns;
+  }
+
+ private:
+  uint64_t latency_ns_;
+  uint64_t bandwidth_bps_;
+  double seek_ns_per_byte_;
+  uint64_t seek_max_ns_;
+
+  mutex lock_;
+  uint64_t busy_until_ns_ = 0;
+  int head_fd_ = -1;
+  uint64_t head_offset_ = 0;
+};
+
+/**
+ * State of an open file, shared between fuse_file_info::fh and pending
+ * prefetch requests.  The file and its log are closed with the last reference.
+ */
+struct OpenFile {
+  OpenFile(int f, int f_log, const struct stat &info)
+    : fd(f), fd_log(f_log), dev(info.st_dev), ino(info.st_ino)
+    , size(info.st_size)
+  { }
+  ~OpenFile();
+
+  int fd;
+  int fd_log;
+  /// Identifies the file in the block cache across open() calls
+  dev_t dev;
+  ino_t ino;
+  /// The physical files are not modified while mounted
+  uint64_t size;
+
+  /// Access history for the prefetch policies
+  mutex lock;
+  uint64_t last_offset = 0;
+  uint64_t last_end = 0;
+  int64_t last_stride = 0;
+  /// End of the furthest range queued for prefetching
+  uint64_t prefetch_end = 0;
+};
+
+enum class ReadPolicy { kNone, kLru, kSequential, kStride };
+
+/// Byte counters of a read that went through the block cache
+struct ReadStats {
+  uint64_t latency_ns = 0;
+  uint64_t delay_ns = 0;
+  uint32_t size_hit = 0;
+};
+
+/**
+ * LRU cache of fixed-size, aligned file blocks.  The last block of a file may
+ * be short.
+ */
+class BlockCache {
+ public:
+  struct Key {
+    dev_t dev;
+    ino_t ino;
+    uint64_t block;
+    bool operator==(const Key &other) const {
+      return (dev == other.dev) && (ino == other.ino) && (block == other.block);
+    }
+  };
+
+  BlockCache(uint64_t capacity, uint32_t block_size)
+    : capacity_(max<uint64_t>(1, capacity / block_size))
+    , block_size_(block_size)
+  { }
+
+  uint32_t block_size() const { return block_size_; }
+
+  /**
+   * Copies up to len bytes from position from of the block into dst.  Returns
+   * false if the block is not cached; otherwise the size of the block is
+   * stored in *size.
+   */
+  bool Get(const Key &key, uint32_t from, uint32_t len, char *dst,
+           uint32_t *size)
+  {
+    lock_guard<mutex> guard(lock_);
+    auto itr = index_.find(key);
+    if (itr == index_.end())
+      return false;
+    lru_.splice(lru_.begin(), lru_, itr->second);
+    const vector<char> &data = itr->second->second;
+    *size = data.size();
+    if (from < data.size())
+      memcpy(dst, data.data() + from, min<size_t>(len, data.size() - from));
+    return true;
+  }
+
+  bool Contains(const Key &key) {
+    lock_guard<mutex> guard(lock_);
+    return index_.count(key) > 0;
+  }
+
+  void Put(const Key &key, const char *data, uint32_t size) {
+    lock_guard<mutex> guard(lock_);
+    if (index_.count(key) > 0)
+      return;
+    lru_.emplace_front(key, vector<char>(data, data + size));
+    index_[key] = lru_.begin();
+    if (lru_.size() > capacity_) {
+      index_.erase(lru_.back().first);
+      lru_.pop_back();
+    }
+  }
+
+ private:
+  struct KeyHash {
+    size_t operator()(const Key &k) const {
+      return hash<uint64_t>()(k.block) ^ (hash<uint64_t>()(k.ino) << 1) ^
+             (hash<uint64_t>()(k.dev) << 2);
+    }
+  };
+  typedef list<pair<Key, vector<char>>> LruList;
+
+  uint64_t capacity_;  ///< in blocks
+  uint32_t block_size_;
+  mutex lock_;
+  LruList lru_;
+  unordered_map<Key, LruList::iterator, KeyHash> index_;
+};
+
+struct PrefetchRequest {
+  shared_ptr<OpenFile> file;
+  uint64_t offset;
+  uint64_t size;
+};
+
+/**
+ * Background thread that reads the ranges queued by the sequential and the
+ * stride policy into the block cache.  Requests beyond a fixed queue length
+ * are dropped.
+ */
+class Prefetcher {
+ public:
+  static const unsigned kMaxQueue = 64;
+
+  void Start() {
+    is_stopped_ = false;
+    worker_ = thread(&Prefetcher::WorkerMain, this);
+  }
+
+  void Stop() {
+    {
+      lock_guard<mutex> guard(lock_);
+      is_stopped_ = true;
+    }
+    cond_.notify_one();
+    worker_.join();
+    queue_.clear();
+  }
+
+  void Enqueue(const PrefetchRequest &request) {
+    {
+      lock_guard<mutex> guard(lock_);
+      if (is_stopped_ || (queue_.size() >= kMaxQueue))
+        return;
+      queue_.push_back(request);
+    }
+    cond_.notify_one();
+  }
+
+ private:
+  void WorkerMain();
+
+  mutex lock_;
+  condition_variable cond_;
+  bool is_stopped_ = true;
+  deque<PrefetchRequest> queue_;
+  thread worker_;
+};
+
 string *g_phys_path;
 string *g_log_path;
-map<int, int> *g_fd2log;
+Tracer *g_tracer;
+StorageModel *g_storage_model;
+ReadPolicy g_read_policy;
+/// Reply with the physical file descriptor instead of reading the data
+bool g_splice;
+BlockCache *g_block_cache;
+Prefetcher *g_prefetcher;
+uint64_t g_readahead;
+uint64_t g_t0_ns;
+/// Bytes returned to the kernel, thereof served from the block cache, and
+/// bytes read from the physical file system including prefetching
+atomic<uint64_t> g_nbytes_read{0};
+atomic<uint64_t> g_nbytes_hit{0};
+atomic<uint64_t> g_nbytes_storage{0};
+
+OpenFile::~OpenFile() {
+  close(fd);
+  g_tracer->CloseLog(fd_log);
+}
+
+static uint64_t GetTimestampNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static uint32_t GetThreadId() {
+  thread_local uint32_t tid = syscall(SYS_gettid);
+  return tid;
+}
+
+static double GetEnvNumber(const char *name) {
+  const char *value = getenv(name);
+  return (value == NULL) ? 0.0 : atof(value);
+}
 
 static string GetRealPath(const char *path) {
   return (*g_phys_path) + string(path);
@@ -42,7 +495,9 @@ static int MkFuseRetval(int retval) {
 }
 
 
-static int ff_getattr(const char *path, struct stat *info) {
+static int ff_getattr(const char *path, struct stat *info,
+                      struct fuse_file_info *fi)
+{
   string real_path = GetRealPath(path);
   int retval = lstat(real_path.c_str(), info);
   return MkFuseRetval(retval);
@@ -53,36 +508,298 @@ static int ff_open(const char *path, struct fuse_file_info *fi) {
   string real_path = GetRealPath(path);
   int fd = open(real_path.c_str(), fi->flags);
   if (fd >= 0) {
-    fi->fh = fd;
+    struct stat info;
+    int retval = fstat(fd, &info);
+    assert(retval == 0);
+    (void)retval;
     int fd_log = open(GetLogPath(real_path).c_str(),
        O_CREAT | O_APPEND | O_WRONLY, 0644);
     assert(fd_log >= 0);
-    (*g_fd2log)[fd] = fd_log;
+    fi->fh = reinterpret_cast<intptr_t>(
+      new shared_ptr<OpenFile>(new OpenFile(fd, fd_log, info)));
   }
   return MkFuseRetval(fd);
 }
 
 
-static int ff_read(
+static void PushTrace(const OpenFile &file, uint64_t t_start,
+                      uint64_t offset, uint32_t size, uint32_t size_req,
+                      const ReadStats &stats, uint32_t flags)
+{
+  TraceEntry entry;
+  entry.record.timestamp_ns = t_start - g_t0_ns;
+  entry.record.latency_ns = stats.latency_ns;
+  entry.record.delay_ns = stats.delay_ns;
+  entry.record.offset = offset;
+  entry.record.size = size;
+  entry.record.size_req = size_req;
+  entry.record.size_hit = stats.size_hit;
+  entry.record.flags = flags;
+  entry.record.thread = GetThreadId();
+  entry.record.fd = file.fd;
+  entry.fd_log = file.fd_log;
+  g_tracer->Push(entry);
+}
+
+
+/// Sleeps until a storage read issued at t_start is complete in the model
+static void EmulateDelay(const OpenFile &file, uint64_t t_start,
+                         uint64_t t_end, uint64_t offset, uint32_t nbytes,
+                         ReadStats *stats)
+{
+  if (g_storage_model->IsActive()) {
+    uint64_t t_done = g_storage_model->Schedule(t_start, file.fd, offset,
+                                                nbytes);
+    if (t_done > t_end) {
+      stats->delay_ns += t_done - t_end;
+      struct timespec ts;
+      ts.tv_sec = t_done / 1000000000;
+      ts.tv_nsec = t_done % 1000000000;
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+             EINTR) { }
+    }
+  }
+}
+
+
+/// Reads from the physical file, delayed according to the storage model
+static int StorageRead(const OpenFile &file, char *buf, size_t size,
+                       uint64_t offset, ReadStats *stats)
+{
+  uint64_t t_start = GetTimestampNs();
+  int nbytes = pread(file.fd, buf, size, offset);
+  if (nbytes < 0)
+    return -errno;
+  uint64_t t_end = GetTimestampNs();
+  stats->latency_ns += t_end - t_start;
+  g_nbytes_storage.fetch_add(nbytes, memory_order_relaxed);
+  EmulateDelay(file, t_start, t_end, offset, nbytes, stats);
+  return nbytes;
+}
+
+
+/**
+ * Reads nblocks blocks starting at first_block from storage, adds them to the
+ * block cache and leaves them in *buf.  Returns the number of bytes read,
+ * which is short at the end of the file.
+ */
+static int FetchBlocks(const OpenFile &file, uint64_t first_block,
+                       uint64_t nblocks, vector<char> *buf, ReadStats *stats)
+{
+  uint32_t block_size = g_block_cache->block_size();
+  buf->resize(nblocks * block_size);
+  int nbytes = StorageRead(file, buf->data(), buf->size(),
+                           first_block * block_size, stats);
+  if (nbytes <= 0)
+    return nbytes;
+  for (uint64_t i = 0; i * block_size < static_cast<uint64_t>(nbytes); ++i) {
+    BlockCache::Key key{file.dev, file.ino, first_block + i};
+    uint32_t this_size = min<uint64_t>(block_size, nbytes - i * block_size);
+    g_block_cache->Put(key, buf->data() + i * block_size, this_size);
+  }
+  return nbytes;
+}
+
+
+/// Serves a read from the block cache, fetching runs of missing blocks
+static int CachedRead(const OpenFile &file, char *buf, size_t size,
+                      uint64_t offset, ReadStats *stats)
+{
+  uint32_t block_size = g_block_cache->block_size();
+  vector<char> fetched;
+  size_t copied = 0;
+  while (copied < size) {
+    uint64_t pos = offset + copied;
+    uint64_t block = pos / block_size;
+    uint32_t from = pos - block * block_size;
+    size_t len = min<size_t>(block_size - from, size - copied);
+    uint32_t available;
+    BlockCache::Key key{file.dev, file.ino, block};
+    if (g_block_cache->Get(key, from, len, buf + copied, &available)) {
+      size_t n = (available > from) ? min<size_t>(len, available - from) : 0;
+      stats->size_hit += n;
+      copied += n;
+      if (n < len)
+        break;
+      continue;
+    }
+
+    uint64_t last_block = (offset + size - 1) / block_size;
+    uint64_t end_block = block + 1;
+    while ((end_block <= last_block) &&
+           !g_block_cache->Contains({file.dev, file.ino, end_block}))
+    {
+      end_block++;
+    }
+    int nbytes = FetchBlocks(file, block, end_block - block, &fetched, stats);
+    if (nbytes < 0)
+      return nbytes;
+    size_t n = (static_cast<uint64_t>(nbytes) > from) ?
+               min<size_t>(size - copied, nbytes - from) : 0;
+    memcpy(buf + copied, fetched.data() + from, n);
+    copied += n;
+    if (static_cast<uint64_t>(nbytes) < (end_block - block) * block_size)
+      break;
+  }
+  return copied;
+}
+
+
+void Prefetcher::WorkerMain() {
+  uint32_t block_size = g_block_cache->block_size();
+  vector<char> buf;
+  unique_lock<mutex> guard(lock_);
+  while (true) {
+    cond_.wait(guard, [this]{ return is_stopped_ || !queue_.empty(); });
+    if (is_stopped_)
+      return;
+    PrefetchRequest request = queue_.front();
+    queue_.pop_front();
+    guard.unlock();
+
+    const OpenFile &file = *request.file;
+    uint64_t block = request.offset / block_size;
+    uint64_t end_block = (request.offset + request.size + block_size - 1) /
+                         block_size;
+    while (block < end_block) {
+      if (g_block_cache->Contains({file.dev, file.ino, block})) {
+        block++;
+        continue;
+      }
+      uint64_t run_end = block + 1;
+      while ((run_end < end_block) &&
+             !g_block_cache->Contains({file.dev, file.ino, run_end}))
+      {
+        run_end++;
+      }
+      ReadStats stats;
+      uint64_t t_start = GetTimestampNs();
+      int nbytes = FetchBlocks(file, block, run_end - block, &buf, &stats);
+      if (nbytes <= 0)
+        break;
+      PushTrace(file, t_start, block * block_size, nbytes, buf.size(), stats,
+                kIoTraceFlagPrefetch);
+      if (static_cast<uint64_t>(nbytes) < buf.size())
+        break;
+      block = run_end;
+    }
+
+    request.file.reset();
+    guard.lock();
+  }
+}
+
+
+/// Updates the access history of the file and queues prefetch requests
+static void Prefetch(const shared_ptr<OpenFile> &file, uint64_t offset,
+                     uint32_t size)
+{
+  if (size == 0)
+    return;
+  OpenFile &f = *file;
+  uint64_t end = offset + size;
+  PrefetchRequest request{file, 0, 0};
+  {
+    lock_guard<mutex> guard(f.lock);
+    int64_t stride = offset - f.last_offset;
+    if (g_read_policy == ReadPolicy::kSequential) {
+      if (offset == f.last_end) {
+        request.offset = max(end, f.prefetch_end);
+        if (request.offset < end + g_readahead)
+          request.size = end + g_readahead - request.offset;
+      }
+    } else if ((stride > 0) && (stride == f.last_stride)) {
+      // Up to g_readahead bytes in reads of the current size along the stride
+      uint64_t depth = max<uint64_t>(1, g_readahead / size);
+      for (uint64_t i = 1; i <= depth; ++i) {
+        uint64_t o = offset + i * stride;
+        if (o < f.prefetch_end)
+          continue;
+        g_prefetcher->Enqueue({file, o, size});
+        f.prefetch_end = o + size;
+      }
+    }
+    f.last_stride = stride;
+    f.last_offset = offset;
+    f.last_end = end;
+    if (request.size > 0)
+      f.prefetch_end = request.offset + request.size;
+  }
+  if (request.size > 0)
+    g_prefetcher->Enqueue(request);
+}
+
+
+/**
+ * Without a block cache, the data is read directly from the physical file and
+ * the trace records the latency of the pread.  With FF_SPLICE, the reply
+ * instead refers to the physical file descriptor and FUSE splices the data
+ * from the file into /dev/fuse without copying it through user space.  The
+ * transfer happens after we return, so the traced latency is only the time
+ * spent in the handler.
+ */
+static int ff_read_buf(
   const char *path,
-  char *buf,
+  struct fuse_bufvec **bufp,
   size_t size,
   off_t offset,
   struct fuse_file_info *fi)
 {
-  int nbytes = pread(fi->fh, buf, size, offset);
-  if (nbytes < 0)
-    return -errno;
-  dprintf((*g_fd2log)[fi->fh], "%ld %d\n", offset, nbytes);
-  return nbytes;
+  const shared_ptr<OpenFile> &file =
+    *reinterpret_cast<shared_ptr<OpenFile> *>(fi->fh);
+  uint64_t t_start = GetTimestampNs();
+  ReadStats stats;
+  struct fuse_bufvec *bufvec =
+    static_cast<struct fuse_bufvec *>(malloc(sizeof(struct fuse_bufvec)));
+  *bufvec = FUSE_BUF_INIT(size);
+  int nbytes;
+  uint32_t flags = 0;
+  if ((g_read_policy == ReadPolicy::kNone) && g_splice) {
+    uint64_t offset_u = offset;
+    nbytes = (offset_u < file->size) ? min<uint64_t>(size, file->size - offset_u)
+                                     : 0;
+    bufvec->buf[0].size = nbytes;
+    bufvec->buf[0].flags =
+      static_cast<enum fuse_buf_flags>(FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK);
+    bufvec->buf[0].fd = file->fd;
+    bufvec->buf[0].pos = offset;
+    flags = kIoTraceFlagSplice;
+    uint64_t t_end = GetTimestampNs();
+    stats.latency_ns = t_end - t_start;
+    g_nbytes_storage.fetch_add(nbytes, memory_order_relaxed);
+    EmulateDelay(*file, t_start, t_end, offset, nbytes, &stats);
+  } else {
+    // Freed by FUSE together with the bufvec
+    char *mem = static_cast<char *>(malloc(max<size_t>(size, 1)));
+    if (g_read_policy == ReadPolicy::kNone)
+      nbytes = StorageRead(*file, mem, size, offset, &stats);
+    else
+      nbytes = CachedRead(*file, mem, size, offset, &stats);
+    if (nbytes < 0) {
+      free(mem);
+      free(bufvec);
+      return nbytes;
+    }
+    bufvec->buf[0].size = nbytes;
+    bufvec->buf[0].mem = mem;
+  }
+  *bufp = bufvec;
+
+  PushTrace(*file, t_start, offset, nbytes, size, stats, flags);
+  g_nbytes_read.fetch_add(nbytes, memory_order_relaxed);
+  g_nbytes_hit.fetch_add(stats.size_hit, memory_order_relaxed);
+  if ((g_read_policy == ReadPolicy::kSequential) ||
+      (g_read_policy == ReadPolicy::kStride))
+  {
+    Prefetch(file, offset, nbytes);
+  }
+  return 0;
 }
 
 
 static int ff_release(const char *path, struct fuse_file_info *fi) {
-  int retval = close(fi->fh);
-  close((*g_fd2log)[fi->fh]);
-  g_fd2log->erase(fi->fh);
-  return MkFuseRetval(retval);
+  delete reinterpret_cast<shared_ptr<OpenFile> *>(fi->fh);
+  return 0;
 }
 
 
@@ -101,12 +818,14 @@ int ff_readdir(
   void *buf,
   fuse_fill_dir_t filler,
   off_t offset,
-  struct fuse_file_info *fi)
+  struct fuse_file_info *fi,
+  enum fuse_readdir_flags flags)
 {
   DIR *dirp = reinterpret_cast<DIR *>(fi->fh);
   struct dirent *entry;
   while ((entry = readdir(dirp)) != NULL) {
-    int retval = filler(buf, entry->d_name, NULL, 0);
+    int retval = filler(buf, entry->d_name, NULL, 0,
+                        static_cast<enum fuse_fill_dir_flags>(0));
     assert(retval == 0);
   }
   return 0;
@@ -119,6 +838,33 @@ int ff_releasedir(const char *path, struct fuse_file_info *fi) {
 }
 
 
+// Called after fuse_main() daemonized, so the drain thread survives the fork
+static void *ff_init(struct fuse_conn_info *conn, struct fuse_config *cfg) {
+  // Replies from the physical file descriptor are spliced into /dev/fuse
+  if (g_splice)
+    conn->want |= conn->capable & (FUSE_CAP_SPLICE_WRITE | FUSE_CAP_SPLICE_MOVE);
+  g_t0_ns = GetTimestampNs();
+  g_tracer->Start();
+  g_prefetcher->Start();
+  return NULL;
+}
+
+
+static void ff_destroy(void *private_data) {
+  // Pending prefetch requests hold open files whose logs need the tracer
+  g_prefetcher->Stop();
+  g_tracer->Stop();
+
+  double seconds = (GetTimestampNs() - g_t0_ns) / 1e9;
+  uint64_t nbytes_read = g_nbytes_read.load();
+  fprintf(stderr, "fuse_forward: read %.1f MB in %.1f s (%.1f MB/s), "
+          "%.1f%% from cache, %.1f MB from storage\n",
+          nbytes_read / 1e6, seconds, nbytes_read / 1e6 / seconds,
+          nbytes_read ? 100.0 * g_nbytes_hit.load() / nbytes_read : 0.0,
+          g_nbytes_storage.load() / 1e6);
+}
+
+
 int main(int argc, char **argv) {
   if (getenv("FF_PHYS_PATH") == NULL) {
     printf("Set environment variable FF_PHYS_PATH\n");
@@ -138,17 +884,52 @@ int main(int argc, char **argv) {
     printf("FF_LOG_PATH must be absolute\n");
     return 1;
   }
-  g_fd2log = new map<int, int>();
+  g_tracer = new Tracer();
+  // Storage emulation, disabled unless at least one of the parameters is set
+  g_storage_model = new StorageModel(
+    GetEnvNumber("FF_EMU_LATENCY_US") * 1000,
+    GetEnvNumber("FF_EMU_BANDWIDTH_MBS") * 1000 * 1000,
+    GetEnvNumber("FF_EMU_SEEK_US_PER_GB") / 1000 / 1000,
+    GetEnvNumber("FF_EMU_SEEK_MAX_US") * 1000);
+
+  // Read policy: none, lru (block cache only), seq (sequential read-ahead
+  // into the block cache), stride (strided read-ahead into the block cache)
+  string policy = getenv("FF_POLICY") ? getenv("FF_POLICY") : "none";
+  if (policy == "none") {
+    g_read_policy = ReadPolicy::kNone;
+  } else if (policy == "lru") {
+    g_read_policy = ReadPolicy::kLru;
+  } else if (policy == "seq") {
+    g_read_policy = ReadPolicy::kSequential;
+  } else if (policy == "stride") {
+    g_read_policy = ReadPolicy::kStride;
+  } else {
+    printf("FF_POLICY must be one of none, lru, seq, stride\n");
+    return 1;
+  }
+  // Splicing only applies to the none policy; the trace then records the
+  // handler time instead of the pread latency
+  g_splice = GetEnvNumber("FF_SPLICE") != 0;
+  uint64_t cache_size = GetEnvNumber("FF_CACHE_MB") * 1024 * 1024;
+  uint32_t block_size = GetEnvNumber("FF_CACHE_BLOCK_KB") * 1024;
+  g_readahead = GetEnvNumber("FF_READAHEAD_KB") * 1024;
+  g_block_cache = new BlockCache(cache_size ? cache_size : 256 * 1024 * 1024,
+                                 block_size ? block_size : 128 * 1024);
+  if (g_readahead == 0)
+    g_readahead = 1024 * 1024;
+  g_prefetcher = new Prefetcher();
 
   struct fuse_operations ff_operations;
   memset(&ff_operations, 0, sizeof(ff_operations));
   ff_operations.getattr = ff_getattr;
   ff_operations.open = ff_open;
-  ff_operations.read = ff_read;
+  ff_operations.read_buf = ff_read_buf;
   ff_operations.release = ff_release;
   ff_operations.opendir = ff_opendir;
   ff_operations.readdir = ff_readdir;
   ff_operations.releasedir = ff_releasedir;
+  ff_operations.init = ff_init;
+  ff_operations.destroy = ff_destroy;
 
   int retval = fuse_main(argc, argv, &ff_operations, NULL);
   return retval;
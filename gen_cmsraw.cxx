@@ -9,18 +9,31 @@
 #include <TFile.h>
 #include <TH1F.h>
 #include <TLeaf.h>
+#include <TROOT.h>
 #include <TTree.h>
 #include <TTreeReader.h>
 #include <TTreeReaderValue.h>
 #include <TTreeReaderArray.h>
 #include <TSystem.h>
 
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include <sys/stat.h>
+
 #include <unistd.h>
 
 #include "util.h"
@@ -31,6 +44,58 @@ using RFieldBase = ROOT::Experimental::Detail::RFieldBase;
 using RNTupleWriter = ROOT::Experimental::RNTupleWriter;
 using RNTupleWriteOptions = ROOT::Experimental::RNTupleWriteOptions;
 
+using RawEvent = std::vector<std::vector<unsigned char>>;
+
+// Counts heap allocations of the whole process in order to report allocations per event
+static std::atomic<std::uint64_t> gNAllocations{0};
+
+void *operator new(std::size_t size) {
+   gNAllocations.fetch_add(1, std::memory_order_relaxed);
+   if (void *p = malloc(size ? size : 1))
+      return p;
+   throw std::bad_alloc();
+}
+void *operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, std::size_t) noexcept { free(p); }
+void operator delete[](void *p, std::size_t) noexcept { free(p); }
+
+/// Hands event buffers from the tree reader thread to the ntuple writer thread and back.  A small, fixed
+/// number of buffers circulates, so that the inner vectors keep their capacity from event to event.
+class EventQueue {
+   std::mutex fLock;
+   std::condition_variable fCondVar;
+   std::deque<RawEvent *> fEvents;
+   bool fIsClosed = false;
+
+public:
+   void Push(RawEvent *event) {
+      {
+         std::lock_guard<std::mutex> guard(fLock);
+         fEvents.push_back(event);
+      }
+      fCondVar.notify_one();
+   }
+   /// Returns nullptr once the queue is closed and empty
+   RawEvent *Pop() {
+      std::unique_lock<std::mutex> guard(fLock);
+      fCondVar.wait(guard, [this] { return !fEvents.empty() || fIsClosed; });
+      if (fEvents.empty())
+         return nullptr;
+      auto event = fEvents.front();
+      fEvents.pop_front();
+      return event;
+   }
+   void Close() {
+      {
+         std::lock_guard<std::mutex> guard(fLock);
+         fIsClosed = true;
+      }
+      fCondVar.notify_all();
+   }
+};
+
 void Usage(char *progname) {
    std::cout << "Usage: " << progname << " -o <ntuple output dir> -c <compression> -o <tree input>"
              << std::endl;
@@ -74,24 +139,65 @@ int main(int argc, char **argv) {
    std::string outputFile = outputDir + "/cmsraw~" + compressionShorthand + ".ntuple";
    std::cout << "Converting " << inputPath << " --> " << outputFile << std::endl;
 
+   ROOT::EnableThreadSafety();
    auto file = TFile::Open(inputPath.c_str());
    auto tree = file->Get<TTree>("Events");
    auto model = RNTupleModel::Create();
-   auto vNtuple = model->MakeField<std::vector<std::vector<unsigned char>>>("v");
+   auto vNtuple = model->MakeField<RawEvent>("v");
    RNTupleWriteOptions options;
    options.SetCompression(compressionSettings);
    options.SetNumElementsPerPage(100000);
    auto ntuple = RNTupleWriter::Recreate(std::move(model), "Events", outputFile, options);
 
-   TTreeReader reader(tree);
-   TTreeReaderValue<std::vector<std::vector<unsigned char>>> vTree(reader, "v");
+   // The tree deserializes directly into one of the circulating buffers; the writer swaps the buffer
+   // with the ntuple's field value instead of deep-copying the FED payloads.
+   constexpr unsigned kNBuffers = 4;
+   std::vector<std::unique_ptr<RawEvent>> buffers;
+   EventQueue freeEvents;
+   EventQueue fullEvents;
+   for (unsigned i = 0; i < kNBuffers; ++i) {
+      buffers.emplace_back(std::make_unique<RawEvent>());
+      freeEvents.Push(buffers.back().get());
+   }
+
+   auto ts_start = std::chrono::steady_clock::now();
+   const auto nAllocationsStart = gNAllocations.load();
+
+   std::thread reader([&]() {
+      RawEvent *event = freeEvents.Pop();
+      tree->SetBranchAddress("v", &event);
+      for (Long64_t i = 0, nEntries = tree->GetEntries(); i < nEntries; ++i) {
+         if (i > 0)
+            event = freeEvents.Pop();
+         tree->GetEntry(i);
+         fullEvents.Push(event);
+      }
+      tree->ResetBranchAddresses();
+      fullEvents.Close();
+   });
 
    // Fills the ntuple with entries from the TTree.
    int count = 0;
-   while(reader.Next()) {
-      *vNtuple = *vTree;
+   std::uint64_t nBytesPayload = 0;
+   while (auto event = fullEvents.Pop()) {
+      std::swap(*vNtuple, *event);
+      freeEvents.Push(event);
+      for (const auto &fed : *vNtuple)
+         nBytesPayload += fed.size();
       ntuple->Fill();
       if (++count % 1000 == 0)
          std::cout << "Wrote " << count << " events" << std::endl;
    }
+   reader.join();
+   ntuple.reset();
+
+   const auto nAllocations = gNAllocations.load() - nAllocationsStart;
+   auto seconds =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - ts_start).count() / 1e6;
+   struct stat info;
+   stat(outputFile.c_str(), &info);
+   std::cout << "Converted " << count << " events in " << seconds << "s" << std::endl;
+   std::cout << "Write throughput: " << nBytesPayload / 1e6 / seconds << " MB/s payload, "
+             << info.st_size / 1e6 / seconds << " MB/s on disk" << std::endl;
+   std::cout << "Allocations per event: " << (count ? double(nAllocations) / count : 0.0) << std::endl;
 }
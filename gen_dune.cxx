@@ -6,15 +6,27 @@
 #include <TSystem.h>
 #include <TROOT.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <utility>
 
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "util.h"
@@ -26,27 +38,25 @@ using ROOT::Experimental::RNTupleModel;
 using ROOT::Experimental::RNTupleWriter;
 using ROOT::Experimental::RNTupleWriteOptions;
 
-std::vector<std::string> gLastGroups;
-extern "C" herr_t FillGroups(hid_t loc_id, const char *name, const H5L_info_t *, void *)
+extern "C" herr_t FillGroups(hid_t loc_id, const char *name, const H5L_info_t *, void *groups)
 {
    hid_t oid = H5Oopen(loc_id, name, H5P_DEFAULT);
    H5O_info_t info;
    H5Oget_info(oid, &info, H5O_INFO_BASIC);
    if (info.type == H5O_TYPE_GROUP) {
-      gLastGroups.emplace_back(name);
+      static_cast<std::vector<std::string> *>(groups)->emplace_back(name);
    }
    H5Oclose(oid);
    return 0;
 }
 
-std::vector<std::string> gLastDatasets;
-extern "C" herr_t FillDatasets(hid_t loc_id, const char *name, const H5L_info_t *, void *)
+extern "C" herr_t FillDatasets(hid_t loc_id, const char *name, const H5L_info_t *, void *datasets)
 {
    hid_t oid = H5Oopen(loc_id, name, H5P_DEFAULT);
    H5O_info_t info;
    H5Oget_info(oid, &info, H5O_INFO_BASIC);
    if (info.type == H5O_TYPE_DATASET) {
-      gLastDatasets.emplace_back(name);
+      static_cast<std::vector<std::string> *>(datasets)->emplace_back(name);
    }
    H5Oclose(oid);
    return 0;
@@ -91,9 +101,226 @@ static std::uint32_t GetUInt32Attr(hid_t did, const std::string &name)
    return value;
 }
 
+/// Uninitialized memory for the data of one stream; only grows
+struct StreamBuffer {
+   std::unique_ptr<std::byte[]> fData;
+   std::size_t fCapacity = 0;
+};
+
+/// A trigger record in flight between the reader threads and the writer
+struct RecordSlot {
+   std::unique_ptr<ROOT::Experimental::REntry> fEntry;
+   /// The data of the streams of the slot's record; the RVec of a stream adopts the stream's buffer
+   std::unordered_map<TriggerRecord::Stream *, StreamBuffer> fBuffers;
+   /// Streams filled by the previous use of this slot; cleared if the next record does not have them
+   std::vector<TriggerRecord::Stream *> fStreams;
+   /// Number of the trigger record that may use or currently uses this slot
+   std::size_t fIndex = 0;
+   bool fIsReady = false;
+   std::uint64_t fNBytes = 0;
+};
+
+/// Serializes all calls into the HDF5 library, which is not necessarily built thread-safe
+static std::mutex gH5Lock;
+
+static TriggerRecord::Stream *GetStream(TriggerRecord *ptrTR, const std::string &ds)
+{
+   TriggerRecord::Stream *stream = nullptr;
+
+   int streamId = 0;
+   if (ds.find("Detector_Readout") == 0) {
+      auto tail = ds.substr(17);
+      sscanf(tail.substr(0, tail.find_first_of("_")).c_str(), "%x", &streamId);
+      stream = ptrTR->GetReadoutStream(streamId, 0);
+      assert(streamId < TriggerRecord::kNUnits);
+   } else if (ds.find("HW_Signals_Interface") == 0) {
+      auto tail = ds.substr(21);
+      sscanf(tail.substr(0, tail.find_first_of("_")).c_str(), "%x", &streamId);
+      stream = ptrTR->GetHWSignalsInterfaceStream(streamId);
+      assert(streamId < TriggerRecord::kNHWSignalsInterfaces);
+   } else if (ds.find("TR_Builder") == 0) {
+      auto tail = ds.substr(11);
+      sscanf(tail.substr(0, tail.find_first_of("_")).c_str(), "%x", &streamId);
+      stream = ptrTR->GetTRBuilderStream(streamId);
+      assert(streamId < TriggerRecord::kNTRBuilders);
+   } else if (ds.find("Trigger") == 0) {
+      auto tail = ds.substr(8);
+      sscanf(tail.substr(0, tail.find_first_of("_")).c_str(), "%x", &streamId);
+      stream = ptrTR->GetTriggerStream(streamId);
+      assert(streamId < TriggerRecord::kNTriggers);
+   }
+   assert(stream);
+
+   if (ds.find("TriggerRecordHeader") != std::string::npos) {
+      stream->fDataType = TriggerRecord::EDataType::kTriggerRecordHeader;
+   } else if (ds.find("Trigger_Primitive") != std::string::npos) {
+      stream->fDataType = TriggerRecord::EDataType::kTriggerPrimitive;
+   } else if (ds.find("Trigger_Activity") != std::string::npos) {
+      stream->fDataType = TriggerRecord::EDataType::kTriggerActivity;
+   } else if (ds.find("Trigger_Candidate") != std::string::npos) {
+      stream->fDataType = TriggerRecord::EDataType::kTriggerCandidate;
+   } else if (ds.find("DAPHNEStream") != std::string::npos) {
+      stream->fDataType = TriggerRecord::EDataType::kDAPHNEStream;
+   } else if (ds.find("WIBEth") != std::string::npos) {
+      stream->fDataType = TriggerRecord::EDataType::kWIBEth;
+   } else if (ds.find("Hardware_Signal") != std::string::npos) {
+      stream->fDataType = TriggerRecord::EDataType::kHardwareSignal;
+   } else {
+      assert(false && "invalid data type");
+   }
+   return stream;
+}
+
+/// Reads the trigger record group `tr` into the slot's entry; returns the number of raw data bytes
+static std::uint64_t ReadTriggerRecord(hid_t gid_root, const std::string &tr, int fd, RecordSlot &slot)
+{
+   auto ptrTR = slot.fEntry->GetPtr<TriggerRecord>("TriggerRecords");
+   assert(ptrTR);
+
+   assert(tr.find("TriggerRecord", 0) == 0);
+   auto trNameTail = tr.substr(13);
+   auto posDot = trNameTail.find_first_of(".", 0);
+   assert(posDot > 0 && posDot != std::string::npos);
+   ptrTR->fTRID = std::stoi(trNameTail.substr(0, posDot));
+   ptrTR->fSliceID = std::stoi(trNameTail.substr(posDot + 1));
+
+   // Raw data sets to be read outside the lock: stream, offset in the file, size
+   std::vector<std::tuple<TriggerRecord::Stream *, haddr_t, hsize_t>> contiguous;
+   std::vector<TriggerRecord::Stream *> streams;
+   std::uint64_t nBytes = 0;
+   {
+      std::lock_guard<std::mutex> guard(gH5Lock);
+      auto gid_tr = H5Gopen(gid_root, tr.c_str(), H5P_DEFAULT);
+      assert(gid_tr >= 0);
+      auto gid_rawdata = H5Gopen(gid_tr, "RawData", H5P_DEFAULT);
+      assert(gid_rawdata >= 0);
+
+      ptrTR->fFragmentTypeSourceIdMap = GetStringAttr(gid_tr, "fragment_type_source_id_map");
+      ptrTR->fRecordHeaderSourceId = GetStringAttr(gid_tr, "record_header_source_id");
+      ptrTR->fSourceIdPathMap = GetStringAttr(gid_tr, "source_id_path_map");
+      ptrTR->fSubdetectorSourceIdMap = GetStringAttr(gid_tr, "subdetector_source_id_map");
+
+      std::vector<std::string> datasets;
+      H5Literate(gid_rawdata, H5_INDEX_NAME, H5_ITER_NATIVE, NULL, FillDatasets, &datasets);
+
+      for (const auto &ds: datasets) {
+         auto did = H5Dopen2(gid_rawdata, ds.c_str(), H5P_DEFAULT);
+         assert(did >= 0);
+
+         assert(H5Tequal(H5Dget_type(did), H5T_STD_I8LE));
+
+         auto sid = H5Dget_space(did);
+         assert(sid >= 0);
+
+         assert(H5Sget_simple_extent_type(sid) == H5S_SIMPLE);
+
+         // Stored as a 2D array, actually a 1D array
+         auto ndims = H5Sget_simple_extent_ndims(sid);
+         assert(ndims == 2);
+         hsize_t dims[2];
+         ndims = H5Sget_simple_extent_dims(sid, dims, NULL);
+         assert(ndims == 2);
+         assert(dims[1] == 1);
+
+         auto stream = GetStream(&*ptrTR, ds);
+         streams.emplace_back(stream);
+         // The buffers are reused from previous records and never zero-filled; the raw data overwrites them
+         auto &buffer = slot.fBuffers[stream];
+         if (buffer.fCapacity < dims[0]) {
+            buffer.fData.reset(new std::byte[dims[0]]);
+            buffer.fCapacity = dims[0];
+         }
+         stream->fData = ROOT::RVec<std::byte>(buffer.fData.get(), dims[0]);
+         nBytes += dims[0];
+
+         auto offset = H5Dget_offset(did);
+         if (offset != HADDR_UNDEF) {
+            contiguous.emplace_back(stream, offset, dims[0]);
+         } else {
+            auto retval = H5Dread(did, H5T_STD_I8LE, H5S_ALL, H5S_ALL, H5P_DEFAULT, stream->fData.data());
+            assert(retval >= 0);
+         }
+
+         H5Sclose(sid);
+         H5Dclose(did);
+      }
+
+      H5Gclose(gid_rawdata);
+      H5Gclose(gid_tr);
+   }
+
+   for (const auto &[stream, offset, size] : contiguous) {
+      std::size_t nread = 0;
+      while (nread < size) {
+         auto n = pread(fd, stream->fData.data() + nread, size - nread, offset + nread);
+         if (n <= 0) {
+            perror("cannot read raw data");
+            abort();
+         }
+         nread += n;
+      }
+   }
+
+   // Streams of the previous record in this slot that are absent from the current one are reset entirely, so that
+   // they are written like the streams of a fresh record (including the data type).  Their buffers stay with the
+   // slot for later records.
+   std::sort(streams.begin(), streams.end());
+   for (auto stream : slot.fStreams) {
+      if (!std::binary_search(streams.begin(), streams.end(), stream))
+         *stream = {};
+   }
+   slot.fStreams = std::move(streams);
+
+   return nBytes;
+}
+
+// Looks up every stream of a trigger record `nIterations` times from `nThreads` concurrent threads,
+// i.e. the access pattern of the reader threads.  Returns the number of lookups per second.
+static double BenchmarkStreamLookup(unsigned nThreads, std::size_t nIterations)
+{
+   auto tr = std::make_unique<TriggerRecord>();
+   std::atomic<std::size_t> checksum{0};
+
+   auto worker = [&](unsigned threadId) {
+      std::size_t sum = 0;
+      for (std::size_t i = 0; i < nIterations; ++i) {
+         for (int u = 0; u < TriggerRecord::kNUnits; ++u) {
+            for (int s = 0; s < TriggerRecord::kNStreamsPerUnit; ++s)
+               sum += reinterpret_cast<std::uintptr_t>(tr->GetReadoutStream(u, s));
+         }
+         for (int s = 0; s < TriggerRecord::kNHWSignalsInterfaces; ++s)
+            sum += reinterpret_cast<std::uintptr_t>(tr->GetHWSignalsInterfaceStream(s));
+         for (int s = 0; s < TriggerRecord::kNTRBuilders; ++s)
+            sum += reinterpret_cast<std::uintptr_t>(tr->GetTRBuilderStream(s));
+         for (int s = 0; s < TriggerRecord::kNTriggers; ++s)
+            sum += reinterpret_cast<std::uintptr_t>(tr->GetTriggerStream(s));
+         sum += threadId;
+      }
+      checksum += sum;
+   };
+
+   auto ts_start = std::chrono::steady_clock::now();
+   std::vector<std::thread> threads;
+   for (unsigned i = 0; i < nThreads; ++i)
+      threads.emplace_back(worker, i);
+   for (auto &t : threads)
+      t.join();
+   auto seconds =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - ts_start).count() / 1e6;
+
+   const std::size_t nStreams = TriggerRecord::kNUnits * TriggerRecord::kNStreamsPerUnit +
+                                TriggerRecord::kNHWSignalsInterfaces + TriggerRecord::kNTRBuilders +
+                                TriggerRecord::kNTriggers;
+   // Print the checksum so that the lookups cannot be optimized away
+   std::cout << "Stream lookup checksum: " << checksum << std::endl;
+   return nThreads * nIterations * nStreams / seconds;
+}
+
 static void Usage(char *progname)
 {
-   std::cout << "Usage: " << progname << " -o <ntuple file> -c <compression> [-m(t)] -i <input.hdf5>"
+   std::cout << "Usage: " << progname << " -o <ntuple file> -c <compression> [-m(t)] [-j <reader threads>] "
+             << "-i <input.hdf5>" << std::endl
+             << "       " << progname << " -b <iterations> [-j <threads>]  (stream lookup benchmark)"
              << std::endl;
 }
 
@@ -103,9 +330,11 @@ int main(int argc, char **argv)
    std::string outputFile;
    int compressionSettings = 0;
    std::string compressionShorthand = "none";
+   unsigned nReaders = 4;
+   std::size_t nLookupIterations = 0;
 
    int c;
-   while ((c = getopt(argc, argv, "hvi:o:c:m")) != -1) {
+   while ((c = getopt(argc, argv, "hvi:o:c:mj:b:")) != -1) {
       switch (c) {
       case 'h':
       case 'v':
@@ -124,6 +353,12 @@ int main(int argc, char **argv)
       case 'm':
          ROOT::EnableImplicitMT();
          break;
+      case 'j':
+         nReaders = std::max(1, atoi(optarg));
+         break;
+      case 'b':
+         nLookupIterations = std::max(1, atoi(optarg));
+         break;
       default:
          fprintf(stderr, "Unknown option: -%c\n", c);
          Usage(argv[0]);
@@ -131,6 +366,13 @@ int main(int argc, char **argv)
       }
    }
 
+   if (nLookupIterations > 0) {
+      auto lookupsPerSecond = BenchmarkStreamLookup(nReaders, nLookupIterations);
+      std::cout << "Stream lookups with " << nReaders << " threads: " << lookupsPerSecond / 1e6 << " Mlookups/s"
+                << std::endl;
+      return 0;
+   }
+
    RNTupleWriteOptions options;
    options.SetCompression(compressionSettings);
 
@@ -165,113 +407,79 @@ int main(int argc, char **argv)
    dataModel->MakeField<TriggerRecord>("TriggerRecords");
    auto dataWriter = RNTupleWriter::Append(std::move(dataModel), "DUNE", *file, options);
 
-   H5Literate(gid_root, H5_INDEX_NAME, H5_ITER_NATIVE, NULL, FillGroups, NULL);
+   std::vector<std::string> triggerRecords;
+   H5Literate(gid_root, H5_INDEX_NAME, H5_ITER_NATIVE, NULL, FillGroups, &triggerRecords);
 
-   for (const auto &tr : gLastGroups) {
-      auto gid_tr = H5Gopen(gid_root, tr.c_str(), H5P_DEFAULT);
-      assert(gid_tr >= 0);
-      auto gid_rawdata = H5Gopen(gid_tr, "RawData", H5P_DEFAULT);
-      assert(gid_rawdata >= 0);
-
-      auto entry = dataWriter->CreateEntry();
-      auto ptrTR = entry->GetPtr<TriggerRecord>("TriggerRecords");
-      assert(ptrTR);
-
-      assert(tr.find("TriggerRecord", 0) == 0);
-      auto trNameTail = tr.substr(13);
-      auto posDot = trNameTail.find_first_of(".", 0);
-      assert(posDot > 0 && posDot != std::string::npos);
-      ptrTR->fTRID = std::stoi(trNameTail.substr(0, posDot));
-      ptrTR->fSliceID = std::stoi(trNameTail.substr(posDot + 1));
-      std::cout << "writing trigger record " << ptrTR->fTRID << "." << ptrTR->fSliceID << std::endl;
-      ptrTR->fFragmentTypeSourceIdMap = GetStringAttr(gid_tr, "fragment_type_source_id_map");
-      ptrTR->fRecordHeaderSourceId = GetStringAttr(gid_tr, "record_header_source_id");
-      ptrTR->fSourceIdPathMap = GetStringAttr(gid_tr, "source_id_path_map");
-      ptrTR->fSubdetectorSourceIdMap = GetStringAttr(gid_tr, "subdetector_source_id_map");
-
-      gLastDatasets.clear();
-      H5Literate(gid_rawdata, H5_INDEX_NAME, H5_ITER_NATIVE, NULL, FillDatasets, NULL);
-
-      for (const auto &ds: gLastDatasets) {
-         auto did = H5Dopen2(gid_rawdata, ds.c_str(), H5P_DEFAULT);
-         assert(did >= 0);
-
-         assert(H5Tequal(H5Dget_type(did), H5T_STD_I8LE));
+   // Raw data of contiguous data sets is read with pread() outside the HDF5 lock
+   int fd = open(inputFile.c_str(), O_RDONLY);
+   assert(fd >= 0);
 
-         auto sid = H5Dget_space(did);
-         assert(sid >= 0);
-
-         assert(H5Sget_simple_extent_type(sid) == H5S_SIMPLE);
-
-         // Stored as a 2D array, actually a 1D array
-         auto ndims = H5Sget_simple_extent_ndims(sid);
-         assert(ndims == 2);
-         hsize_t dims[2];
-         ndims = H5Sget_simple_extent_dims(sid, dims, NULL);
-         assert(ndims == 2);
-         assert(dims[1] == 1);
-
-         TriggerRecord::Stream *stream = nullptr;
-
-         // printf("Dataset %s\n", ds.c_str());
-
-         int streamId = 0;
-         if (ds.find("Detector_Readout") == 0) {
-            auto tail = ds.substr(17);
-            sscanf(tail.substr(0, tail.find_first_of("_")).c_str(), "%x", &streamId);
-            stream = ptrTR->GetReadoutStream(streamId, 0);
-            assert(streamId < TriggerRecord::kNUnits);
-         } else if (ds.find("HW_Signals_Interface") == 0) {
-            auto tail = ds.substr(21);
-            sscanf(tail.substr(0, tail.find_first_of("_")).c_str(), "%x", &streamId);
-            stream = ptrTR->GetHWSignalsInterfaceStream(streamId);
-            assert(streamId < TriggerRecord::kNHWSignalsInterfaces);
-         } else if (ds.find("TR_Builder") == 0) {
-            auto tail = ds.substr(11);
-            sscanf(tail.substr(0, tail.find_first_of("_")).c_str(), "%x", &streamId);
-            stream = ptrTR->GetTRBuilderStream(streamId);
-            assert(streamId < TriggerRecord::kNTRBuilders);
-         } else if (ds.find("Trigger") == 0) {
-            auto tail = ds.substr(8);
-            sscanf(tail.substr(0, tail.find_first_of("_")).c_str(), "%x", &streamId);
-            stream = ptrTR->GetTriggerStream(streamId);
-            assert(streamId < TriggerRecord::kNTriggers);
+   // Ring of trigger record slots: record i is read into slot i % nSlots.  The writer consumes the slots
+   // in order and returns them to the readers; the entries and their stream buffers are reused.
+   const std::size_t nSlots = 2 * nReaders;
+   std::vector<RecordSlot> slots(nSlots);
+   for (std::size_t i = 0; i < nSlots; ++i) {
+      slots[i].fEntry = dataWriter->CreateEntry();
+      slots[i].fIndex = i;
+   }
+   std::mutex slotLock;
+   std::condition_variable slotCondVar;
+   std::atomic<std::size_t> nextRecord{0};
+
+   auto ts_start = std::chrono::steady_clock::now();
+
+   auto reader = [&]() {
+      for (std::size_t i = nextRecord++; i < triggerRecords.size(); i = nextRecord++) {
+         auto &slot = slots[i % nSlots];
+         {
+            std::unique_lock<std::mutex> guard(slotLock);
+            slotCondVar.wait(guard, [&] { return slot.fIndex == i && !slot.fIsReady; });
          }
-         assert(stream);
-
-         if (ds.find("TriggerRecordHeader") != std::string::npos) {
-            stream->fDataType = TriggerRecord::EDataType::kTriggerRecordHeader;
-         } else if (ds.find("Trigger_Primitive") != std::string::npos) {
-            stream->fDataType = TriggerRecord::EDataType::kTriggerPrimitive;
-         } else if (ds.find("Trigger_Activity") != std::string::npos) {
-            stream->fDataType = TriggerRecord::EDataType::kTriggerActivity;
-         } else if (ds.find("Trigger_Candidate") != std::string::npos) {
-            stream->fDataType = TriggerRecord::EDataType::kTriggerCandidate;
-         } else if (ds.find("DAPHNEStream") != std::string::npos) {
-            stream->fDataType = TriggerRecord::EDataType::kDAPHNEStream;
-         } else if (ds.find("WIBEth") != std::string::npos) {
-            stream->fDataType = TriggerRecord::EDataType::kWIBEth;
-         } else if (ds.find("Hardware_Signal") != std::string::npos) {
-            stream->fDataType = TriggerRecord::EDataType::kHardwareSignal;
-         } else {
-            assert(false && "invalid data type");
+         slot.fNBytes = ReadTriggerRecord(gid_root, triggerRecords[i], fd, slot);
+         {
+            std::lock_guard<std::mutex> guard(slotLock);
+            slot.fIsReady = true;
          }
-         stream->fData.resize(dims[0]);
-         auto retval = H5Dread(did, H5T_STD_I8LE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &stream->fData[0]);
-         assert(retval >= 0);
-
-         std::cout << "    adding stream " << ds << " " << streamId << std::endl;
-
-         H5Sclose(sid);
-         H5Dclose(did);
+         slotCondVar.notify_all();
       }
-
-      H5Gclose(gid_rawdata);
-      H5Gclose(gid_tr);
-
-      dataWriter->Fill(*entry);
+   };
+   std::vector<std::thread> readers;
+   for (unsigned i = 0; i < nReaders; ++i)
+      readers.emplace_back(reader);
+
+   std::uint64_t nBytes = 0;
+   for (std::size_t i = 0; i < triggerRecords.size(); ++i) {
+      auto &slot = slots[i % nSlots];
+      {
+         std::unique_lock<std::mutex> guard(slotLock);
+         slotCondVar.wait(guard, [&] { return slot.fIndex == i && slot.fIsReady; });
+      }
+      auto ptrTR = slot.fEntry->GetPtr<TriggerRecord>("TriggerRecords");
+      std::cout << "writing trigger record " << ptrTR->fTRID << "." << ptrTR->fSliceID << " ("
+                << slot.fNBytes / 1000 << " kB)" << std::endl;
+      dataWriter->Fill(*slot.fEntry);
+      nBytes += slot.fNBytes;
+      {
+         std::lock_guard<std::mutex> guard(slotLock);
+         slot.fIsReady = false;
+         slot.fIndex = i + nSlots;
+      }
+      slotCondVar.notify_all();
    }
+   for (auto &t : readers)
+      t.join();
+   dataWriter.reset();
+   file->Close();
+
+   auto seconds =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - ts_start).count() / 1e6;
+   struct stat info;
+   stat(outputFile.c_str(), &info);
+   std::cout << "Converted " << triggerRecords.size() << " trigger records in " << seconds << "s: "
+             << nBytes / 1e6 / seconds << " MB/s raw data, " << info.st_size / 1e6 / seconds << " MB/s written"
+             << std::endl;
 
+   close(fd);
    H5Gclose(gid_root);
    H5Fclose(fid);
 
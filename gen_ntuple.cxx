@@ -0,0 +1,504 @@
+#include <ROOT/RField.hxx>
+#include <ROOT/RLogger.hxx>
+#include <ROOT/RNTupleModel.hxx>
+#include <ROOT/RNTupleWriteOptions.hxx>
+#include <ROOT/RNTupleWriter.hxx>
+
+#include <TBranch.h>
+#include <TClass.h>
+#include <TFile.h>
+#include <TKey.h>
+#include <TLeaf.h>
+#include <TROOT.h>
+#include <TTree.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util.h"
+
+using REntry = ROOT::Experimental::REntry;
+using RFieldBase = ROOT::Experimental::RFieldBase;
+using RNTupleModel = ROOT::Experimental::RNTupleModel;
+using RNTupleWriteOptions = ROOT::Experimental::RNTupleWriteOptions;
+using RNTupleWriter = ROOT::Experimental::RNTupleWriter;
+using RRecordField = ROOT::Experimental::RRecordField;
+using RVectorField = ROOT::Experimental::RVectorField;
+
+/// Output bytes of one variant; printed as output throughput over the time of the pass that wrote it
+struct ConversionStats {
+   std::string fCompression;
+   std::uint64_t fBytesOut = 0;
+   double fSeconds = 0.0;
+};
+
+/// Page and cluster size of one point of the layout sweep; zero means the RNTuple default
+struct Layout {
+   std::string fPageSizeName;
+   std::string fClusterSizeName;
+   std::size_t fPageSize = 0;
+   std::size_t fClusterSize = 0;
+
+   /// The layout becomes part of the data set name, e.g. B2HHH+P64k+C50M~zstd.ntuple
+   std::string GetTag() const
+   {
+      std::string tag;
+      if (fPageSize)
+         tag += "+P" + fPageSizeName;
+      if (fClusterSize)
+         tag += "+C" + fClusterSizeName;
+      return tag;
+   }
+};
+
+static void Usage(char *progname)
+{
+   std::cout << "Usage: " << progname << " -i <sample~none.root> -o <ntuple-path> [-t <tree name>] "
+             << "[-c <compression> ...] [-p <page sizes>] [-k <cluster sizes>] [-j <variants per pass>]"
+             << std::endl
+             << "  Reads the tree once and fills every entry into all requested compression variants; with -j, "
+             << "the tree is read once per group of <variants per pass> variants." << std::endl
+             << "  Default compressions: none lz4 zlib lzma zstd" << std::endl
+             << "  Page and cluster sizes are comma-separated lists such as 16k,64k,1M; every combination "
+             << "of layout and compression is written to <sample>+P<page>+C<cluster>~<compression>.ntuple"
+             << std::endl;
+}
+
+/// Parses sizes such as 64k, 50M, or 1G
+static std::size_t ParseSize(const std::string &str)
+{
+   char *end;
+   std::size_t size = strtoull(str.c_str(), &end, 10);
+   switch (*end) {
+   case '\0':
+      break;
+   case 'k':
+   case 'K':
+      size *= 1024;
+      break;
+   case 'm':
+   case 'M':
+      size *= 1024 * 1024;
+      break;
+   case 'g':
+   case 'G':
+      size *= 1024 * 1024 * 1024;
+      break;
+   default:
+      size = 0;
+   }
+   if (size == 0) {
+      std::cerr << "Invalid size: " << str << std::endl;
+      exit(1);
+   }
+   return size;
+}
+
+static std::uint64_t GetSize(const std::string &path)
+{
+   struct stat info;
+   if (stat(path.c_str(), &info) != 0)
+      return 0;
+   return info.st_size;
+}
+
+static double GetSeconds(std::chrono::steady_clock::time_point start)
+{
+   auto diff = std::chrono::steady_clock::now() - start;
+   return std::chrono::duration_cast<std::chrono::microseconds>(diff).count() / 1e6;
+}
+
+/// Use the only TTree in the file if no tree name is given
+static std::string FindTreeName(const std::string &inputFile)
+{
+   std::unique_ptr<TFile> file(TFile::Open(inputFile.c_str()));
+   if (!file || file->IsZombie()) {
+      std::cerr << "Cannot open " << inputFile << std::endl;
+      exit(1);
+   }
+   std::string treeName;
+   for (auto key : TRangeDynCast<TKey>(file->GetListOfKeys())) {
+      if (std::string(key->GetClassName()) != "TTree")
+         continue;
+      if (!treeName.empty() && treeName != key->GetName()) {
+         std::cerr << "Multiple trees in " << inputFile << ", use -t to select one" << std::endl;
+         exit(1);
+      }
+      treeName = key->GetName();
+   }
+   if (treeName.empty()) {
+      std::cerr << "No tree found in " << inputFile << std::endl;
+      exit(1);
+   }
+   return treeName;
+}
+
+/// Reads the tree entry by entry and provides every entry to the writers of all variants, so that the tree is
+/// read only once.  The schema follows RNTupleImporter: a leaf becomes a field of its type, a fixed-size array
+/// an std::array field, an object branch a field of its class, and the leaf-count arrays that share a count leaf
+/// one collection of records, onto which the count leaf name is projected as the collection size.  The tree
+/// reads into buffers owned by this class, and the entries of all writers are bound to these buffers.
+class RTreeFanOut {
+   /// A top-level field and the value read by the tree
+   struct RTopField {
+      std::string fName;
+      std::string fTypeName;
+      void *fValue;
+   };
+
+   /// One leaf-count array as a member of the collection record
+   struct RCollectionItem {
+      std::string fName;
+      std::string fTypeName;
+      std::size_t fSize;
+      std::size_t fOffset;
+      const unsigned char *fBuffer;
+   };
+
+   /// The leaf-count arrays with the same count leaf, packed into records for the collection field
+   struct RCollection {
+      std::string fFieldName;
+      TLeaf *fCountLeaf = nullptr;
+      std::vector<RCollectionItem> fItems;
+      std::size_t fRecordSize = 0;
+      std::size_t fRecordAlignment = 1;
+      /// The value of the collection field: the records of the current entry
+      std::vector<char> fValue;
+   };
+
+   TTree *fTree;
+   std::vector<std::unique_ptr<unsigned char[]>> fLeafBuffers;
+   /// Branch addresses of the object branches; sized before the addresses are taken
+   std::vector<void *> fObjects;
+   std::vector<TClass *> fObjectClasses;
+   std::vector<RTopField> fFields;
+   std::vector<RCollection> fCollections;
+
+   static std::string GetFieldTypeName(TLeaf *leaf)
+   {
+      static const std::map<std::string, std::string> kTypeNames{
+         {"Bool_t", "bool"},           {"Char_t", "std::int8_t"},    {"UChar_t", "std::uint8_t"},
+         {"Short_t", "std::int16_t"},  {"UShort_t", "std::uint16_t"}, {"Int_t", "std::int32_t"},
+         {"UInt_t", "std::uint32_t"},  {"Long64_t", "std::int64_t"},  {"ULong64_t", "std::uint64_t"},
+         {"Float_t", "float"},         {"Double_t", "double"}};
+      auto itr = kTypeNames.find(leaf->GetTypeName());
+      if (itr == kTypeNames.end()) {
+         std::cerr << "Leaf " << leaf->GetName() << " has unsupported type " << leaf->GetTypeName() << std::endl;
+         exit(1);
+      }
+      if (leaf->GetLenStatic() > 1)
+         return "std::array<" + itr->second + "," + std::to_string(leaf->GetLenStatic()) + ">";
+      return itr->second;
+   }
+
+   unsigned char *AllocateLeafBuffer(std::size_t size)
+   {
+      fLeafBuffers.emplace_back(std::make_unique<unsigned char[]>(size));
+      return fLeafBuffers.back().get();
+   }
+
+public:
+   explicit RTreeFanOut(TTree *tree) : fTree(tree)
+   {
+      std::vector<TBranch *> branches;
+      std::set<TLeaf *> countLeaves;
+      std::size_t nObjects = 0;
+      for (auto branch : TRangeDynCast<TBranch>(fTree->GetListOfBranches())) {
+         if (branch->GetListOfBranches()->GetEntries() > 0) {
+            std::cerr << "Branch " << branch->GetName() << " is split, which is not supported" << std::endl;
+            exit(1);
+         }
+         if (*branch->GetClassName()) {
+            nObjects++;
+         } else if (branch->GetListOfLeaves()->GetEntries() != 1) {
+            std::cerr << "Branch " << branch->GetName() << " has a leaf list, which is not supported" << std::endl;
+            exit(1);
+         } else if (auto countLeaf = static_cast<TLeaf *>(branch->GetListOfLeaves()->At(0))->GetLeafCount()) {
+            countLeaves.insert(countLeaf);
+         }
+         branches.emplace_back(branch);
+      }
+      fObjects.resize(nObjects, nullptr);
+
+      std::map<TLeaf *, std::size_t> collectionIdx;
+      for (auto branch : branches) {
+         if (*branch->GetClassName()) {
+            auto cl = TClass::GetClass(branch->GetClassName());
+            fObjectClasses.emplace_back(cl);
+            auto &object = fObjects[fObjectClasses.size() - 1];
+            object = cl->New();
+            fTree->SetBranchAddress(branch->GetName(), &object);
+            fFields.emplace_back(RTopField{branch->GetName(), branch->GetClassName(), object});
+            continue;
+         }
+
+         auto leaf = static_cast<TLeaf *>(branch->GetListOfLeaves()->At(0));
+         const std::size_t elementSize = leaf->GetLenType() * leaf->GetLenStatic();
+         auto countLeaf = leaf->GetLeafCount();
+         if (!countLeaf) {
+            auto buffer = AllocateLeafBuffer(elementSize);
+            fTree->SetBranchAddress(branch->GetName(), buffer);
+            // Count leaves are only represented by the projected collection size
+            if (countLeaves.count(leaf) == 0)
+               fFields.emplace_back(RTopField{branch->GetName(), GetFieldTypeName(leaf), buffer});
+            continue;
+         }
+
+         auto buffer = AllocateLeafBuffer(elementSize * std::max(1, countLeaf->GetMaximum()));
+         fTree->SetBranchAddress(branch->GetName(), buffer);
+         auto itr = collectionIdx.find(countLeaf);
+         if (itr == collectionIdx.end()) {
+            itr = collectionIdx.emplace(countLeaf, fCollections.size()).first;
+            fCollections.emplace_back();
+            fCollections.back().fFieldName = "_collection" + std::to_string(itr->second);
+            fCollections.back().fCountLeaf = countLeaf;
+         }
+         // Members are laid out like in RRecordField: every member aligned to its element type
+         auto &collection = fCollections[itr->second];
+         const std::size_t alignment = leaf->GetLenType();
+         collection.fRecordSize = (collection.fRecordSize + alignment - 1) / alignment * alignment;
+         collection.fItems.emplace_back(
+            RCollectionItem{leaf->GetName(), GetFieldTypeName(leaf), elementSize, collection.fRecordSize, buffer});
+         collection.fRecordSize += elementSize;
+         collection.fRecordAlignment = std::max(collection.fRecordAlignment, alignment);
+      }
+      for (auto &collection : fCollections) {
+         const auto alignment = collection.fRecordAlignment;
+         collection.fRecordSize = (collection.fRecordSize + alignment - 1) / alignment * alignment;
+      }
+   }
+
+   ~RTreeFanOut()
+   {
+      fTree->ResetBranchAddresses();
+      for (std::size_t i = 0; i < fObjects.size(); ++i)
+         fObjectClasses[i]->Destructor(fObjects[i]);
+   }
+
+   RTreeFanOut(const RTreeFanOut &) = delete;
+   RTreeFanOut &operator=(const RTreeFanOut &) = delete;
+
+   /// Every writer gets its own model of the same schema
+   std::unique_ptr<RNTupleModel> CreateModel() const
+   {
+      auto model = RNTupleModel::CreateBare();
+      for (const auto &field : fFields)
+         model->AddField(RFieldBase::Create(field.fName, field.fTypeName).Unwrap());
+      for (const auto &collection : fCollections) {
+         std::vector<std::unique_ptr<RFieldBase>> items;
+         for (const auto &item : collection.fItems)
+            items.emplace_back(RFieldBase::Create(item.fName, item.fTypeName).Unwrap());
+         auto record = std::make_unique<RRecordField>("_0", std::move(items));
+         if (record->GetValueSize() != collection.fRecordSize) {
+            std::cerr << "Unexpected record layout of " << collection.fCountLeaf->GetName() << std::endl;
+            exit(1);
+         }
+         const auto fieldName = collection.fFieldName;
+         model->AddField(std::make_unique<RVectorField>(fieldName, std::move(record)));
+         model
+            ->AddProjectedField(RFieldBase::Create(collection.fCountLeaf->GetName(),
+                                                   "ROOT::Experimental::RNTupleCardinality<std::uint32_t>")
+                                   .Unwrap(),
+                                [fieldName](const std::string &) { return fieldName; })
+            .ThrowOnError();
+      }
+      return model;
+   }
+
+   /// Binds the fields of an entry of a model created by CreateModel() to the values read from the tree
+   void BindEntry(REntry &entry)
+   {
+      for (const auto &field : fFields)
+         entry.BindRawPtr(field.fName, field.fValue);
+      for (auto &collection : fCollections)
+         entry.BindRawPtr(collection.fFieldName, &collection.fValue);
+   }
+
+   /// Reads the entry from the tree and packs the leaf-count arrays into the collection records
+   void ReadEntry(Long64_t entry)
+   {
+      fTree->GetEntry(entry);
+      for (auto &collection : fCollections) {
+         const auto nRecords = static_cast<std::size_t>(collection.fCountLeaf->GetValue());
+         collection.fValue.resize(nRecords * collection.fRecordSize);
+         for (const auto &item : collection.fItems) {
+            for (std::size_t i = 0; i < nRecords; ++i) {
+               memcpy(collection.fValue.data() + i * collection.fRecordSize + item.fOffset,
+                      item.fBuffer + i * item.fSize, item.fSize);
+            }
+         }
+      }
+   }
+};
+
+/// One output file: a compression and layout variant with its own writer
+struct Variant {
+   Layout fLayout;
+   ConversionStats fStats;
+   std::string fOutputFile;
+   std::unique_ptr<RNTupleWriter> fWriter;
+   std::unique_ptr<REntry> fEntry;
+};
+
+/// Opens the writer of a variant.  Every variant is written from the tree entries rather than derived from
+/// another ntuple because the cluster size target refers to compressed data: each compression has its own
+/// cluster boundaries.
+static void OpenVariant(const std::string &ntupleName, RTreeFanOut &fanOut, Variant *variant)
+{
+   RNTupleWriteOptions options;
+   options.SetCompression(GetCompressionSettings(variant->fStats.fCompression));
+   const auto &layout = variant->fLayout;
+   if (layout.fPageSize)
+      options.SetApproxUnzippedPageSize(layout.fPageSize);
+   if (layout.fClusterSize) {
+      options.SetMaxUnzippedClusterSize(std::max(options.GetMaxUnzippedClusterSize(), 10 * layout.fClusterSize));
+      options.SetApproxZippedClusterSize(layout.fClusterSize);
+   }
+   unlink(variant->fOutputFile.c_str());
+   variant->fWriter = RNTupleWriter::Recreate(fanOut.CreateModel(), ntupleName, variant->fOutputFile, options);
+   variant->fEntry = variant->fWriter->GetModel().CreateBareEntry();
+   fanOut.BindEntry(*variant->fEntry);
+}
+
+int main(int argc, char **argv)
+{
+   std::string inputFile;
+   std::string outputPath = ".";
+   std::string treeName;
+   std::vector<std::string> compressions;
+   std::vector<std::string> pageSizes;
+   std::vector<std::string> clusterSizes;
+   // By default, all variants are filled from a single pass over the tree
+   std::size_t nPerPass = 0;
+
+   int c;
+   while ((c = getopt(argc, argv, "hvi:o:t:c:p:k:j:")) != -1) {
+      switch (c) {
+      case 'h':
+      case 'v':
+         Usage(argv[0]);
+         return 0;
+      case 'i':
+         inputFile = optarg;
+         break;
+      case 'o':
+         outputPath = optarg;
+         break;
+      case 't':
+         treeName = optarg;
+         break;
+      case 'c':
+         // Validates the shorthand
+         GetCompressionSettings(optarg);
+         compressions.emplace_back(optarg);
+         break;
+      case 'p':
+         pageSizes = SplitString(optarg, ',');
+         break;
+      case 'k':
+         clusterSizes = SplitString(optarg, ',');
+         break;
+      case 'j':
+         nPerPass = std::max(1, atoi(optarg));
+         break;
+      default:
+         fprintf(stderr, "Unknown option: -%c\n", c);
+         Usage(argv[0]);
+         return 1;
+      }
+   }
+   if (inputFile.empty()) {
+      Usage(argv[0]);
+      return 1;
+   }
+   if (compressions.empty())
+      compressions = {"none", "lz4", "zlib", "lzma", "zstd"};
+   if (treeName.empty())
+      treeName = FindTreeName(inputFile);
+
+   // The writers of all variants compress their pages concurrently in the implicit MT pool
+   ROOT::EnableThreadSafety();
+#ifdef R__USE_IMT
+   ROOT::EnableImplicitMT();
+#endif
+   auto noWarn = ROOT::Experimental::RLogScopedVerbosity(ROOT::Experimental::NTupleLog(),
+                                                         ROOT::Experimental::ELogLevel::kError);
+
+   // The data set name is the input file name without the "~none.root" or ".root" suffix
+   std::string dsName = StripSuffix(GetFileName(inputFile));
+   dsName = dsName.substr(0, dsName.find('~'));
+   auto GetOutputFile = [&](const std::string &compression, const std::string &layoutTag = "") {
+      return outputPath + "/" + dsName + layoutTag + "~" + compression + ".ntuple";
+   };
+   std::cout << std::fixed << std::setprecision(1);
+
+   // Every combination of page size, cluster size, and compression is a separate variant; without -p and -k,
+   // there is one (default) layout
+   if (pageSizes.empty())
+      pageSizes.emplace_back("");
+   if (clusterSizes.empty())
+      clusterSizes.emplace_back("");
+   std::vector<Variant> variants;
+   for (const auto &p : pageSizes) {
+      for (const auto &k : clusterSizes) {
+         Layout layout{p, k, p.empty() ? 0 : ParseSize(p), k.empty() ? 0 : ParseSize(k)};
+         for (const auto &compression : compressions) {
+            variants.emplace_back();
+            variants.back().fLayout = layout;
+            variants.back().fStats.fCompression = compression;
+            variants.back().fOutputFile = GetOutputFile(compression, layout.GetTag());
+         }
+      }
+   }
+   if (nPerPass == 0)
+      nPerPass = variants.size();
+
+   std::unique_ptr<TFile> file(TFile::Open(inputFile.c_str()));
+   auto tree = file->Get<TTree>(treeName.c_str());
+   const auto nEntries = tree->GetEntries();
+   const auto bytesIn = GetSize(inputFile);
+   RTreeFanOut fanOut(tree);
+
+   auto ts_start = std::chrono::steady_clock::now();
+   for (std::size_t first = 0; first < variants.size(); first += nPerPass) {
+      const std::size_t last = std::min(first + nPerPass, variants.size());
+      auto ts_pass = std::chrono::steady_clock::now();
+      for (std::size_t v = first; v < last; ++v)
+         OpenVariant(treeName, fanOut, &variants[v]);
+      for (Long64_t i = 0; i < nEntries; ++i) {
+         fanOut.ReadEntry(i);
+         for (std::size_t v = first; v < last; ++v)
+            variants[v].fWriter->Fill(*variants[v].fEntry);
+      }
+      for (std::size_t v = first; v < last; ++v) {
+         variants[v].fEntry.reset();
+         variants[v].fWriter.reset();
+      }
+      const auto seconds = GetSeconds(ts_pass);
+      std::cout << inputFile << ": read once for " << last - first << " variants in " << seconds << "s, "
+                << bytesIn / 1e6 / seconds << " MB/s in" << std::endl;
+      for (std::size_t v = first; v < last; ++v) {
+         auto &stats = variants[v].fStats;
+         stats.fSeconds = seconds;
+         stats.fBytesOut = GetSize(variants[v].fOutputFile);
+         std::cout << "  " << variants[v].fOutputFile << ": " << stats.fBytesOut / 1e6 / stats.fSeconds
+                   << " MB/s out (" << stats.fBytesOut / 1e6 << " MB)" << std::endl;
+      }
+   }
+   std::cout << "Total: " << GetSeconds(ts_start) << "s" << std::endl;
+
+   return 0;
+}
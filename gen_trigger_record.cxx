@@ -2,8 +2,13 @@
 #include <cstdio>
 #include <string>
 
+#include <unistd.h>
+
 static void Usage() {
-   printf("gen_trigger_record <output.hxx>\n");
+   printf("gen_trigger_record [-l members|units|flat] <output.hxx>\n");
+   printf("  members: TriggerRecord, every readout stream is a named member (default)\n");
+   printf("  units:   TriggerRecordUnits, a std::vector<Stream> per detector unit\n");
+   printf("  flat:    TriggerRecordFlat, one std::vector<Stream> of all readout streams plus a unit index\n");
 }
 
 static constexpr int kNStreamsPerUnit = 40;
@@ -12,30 +17,96 @@ static constexpr int kNTriggers = 10;
 static constexpr int kNHWSignalsInterfaces = 10;
 static constexpr int kNTRBuilders = 10;
 
+// Schema shape of the readout streams.  The HW signal, trigger, and TR builder streams are named members
+// in all layouts.
+enum class ELayout { kMembers, kUnits, kFlat };
+
+// Writes the named stream members and their compile-time offset table for the small stream groups
+static void WriteStreamGroup(FILE *f, const char *structName, const char *memberPrefix, const char *tableName,
+                             int nStreams)
+{
+   fprintf(f,
+"   struct %s {\n",
+   structName);
+
+   for (int i = 0; i < nStreams; ++i) {
+      fprintf(f,
+"      Stream %s%03d;\n",
+              memberPrefix, i);
+   };
+
+   fprintf(f,
+"   };\n"
+"   static constexpr std::size_t %s[%d] = {\n",
+   tableName, nStreams);
+
+   for (int i = 0; i < nStreams; i++) {
+      fprintf(f,
+"      offsetof(%s, %s%03d),\n",
+      structName, memberPrefix, i);
+   }
+
+   fprintf(f,
+"   };\n"
+"\n"
+   );
+}
+
 int main(int argc, char **argv)
 {
-   if (argc < 2 || std::string(argv[1]) == "-h") {
+   ELayout layout = ELayout::kMembers;
+   int c;
+   while ((c = getopt(argc, argv, "hl:")) != -1) {
+      switch (c) {
+      case 'h':
+         Usage();
+         return 0;
+      case 'l':
+         if (std::string(optarg) == "members") {
+            layout = ELayout::kMembers;
+         } else if (std::string(optarg) == "units") {
+            layout = ELayout::kUnits;
+         } else if (std::string(optarg) == "flat") {
+            layout = ELayout::kFlat;
+         } else {
+            Usage();
+            return 1;
+         }
+         break;
+      default:
+         Usage();
+         return 1;
+      }
+   }
+   if (optind >= argc) {
       Usage();
       return 0;
    }
 
-   FILE *f = fopen(argv[1], "w+");
+   const char *className = "TriggerRecord";
+   if (layout == ELayout::kUnits)
+      className = "TriggerRecordUnits";
+   else if (layout == ELayout::kFlat)
+      className = "TriggerRecordFlat";
+
+   FILE *f = fopen(argv[optind], "w+");
    assert(f);
 
    fprintf(f,
-"#ifndef TriggerRecord_H\n"
-"#define TriggerRecord_H\n"
+"#ifndef %s_H\n"
+"#define %s_H\n"
 "\n"
 "// THIS FILE IS GENERATED!\n"
 "\n"
 "#include <Rtypes.h>\n"
+"#include <ROOT/RVec.hxx>\n"
 "\n"
 "#include <cstddef>\n"
 "#include <cstdint>\n"
 "#include <string>\n"
 "#include <vector>\n"
 "\n"
-"class TriggerRecord {\n"
+"class %s {\n"
 "public:\n"
 "   static constexpr int kNStreamsPerUnit = %d;\n"
 "   static constexpr int kNUnits = %d;\n"
@@ -55,68 +126,82 @@ int main(int argc, char **argv)
 "\n"
 "   struct Stream {\n"
 "      EDataType fDataType;\n"
-"      std::vector<std::byte> fData;\n"
+"      ROOT::RVec<std::byte> fData;\n"
 "   };\n"
-"\n"
-"   struct DetectorUnit {\n",
+"\n",
+   className, className, className,
    kNStreamsPerUnit, kNUnits, kNTriggers, kNHWSignalsInterfaces, kNTRBuilders);
 
-   for (unsigned i = 0; i < kNStreamsPerUnit; ++i) {
+   // Offsets of the streams within their enclosing struct, computed at compile time.  A readout stream of the
+   // members layout is located by the offset of its unit within fDetectors plus the offset of the stream within
+   // the unit; the units layout only needs the unit offset.
+   if (layout == ELayout::kMembers) {
       fprintf(f,
+"   struct DetectorUnit {\n"
+      );
+
+      for (unsigned i = 0; i < kNStreamsPerUnit; ++i) {
+         fprintf(f,
 "      Stream fStream%03d;\n",
-              i);
-   };
+                 i);
+      };
 
-   fprintf(f,
+      fprintf(f,
 "   };\n"
-"\n"
-"   struct Detectors {\n"
-   );
+"   static constexpr std::size_t kStreamOffsets[%d] = {\n",
+      kNStreamsPerUnit);
 
-   for (unsigned i = 0; i < kNUnits; ++i) {
-      fprintf(f,
-"      DetectorUnit fUnit%03d;\n",
-              i);
-   };
+      for (unsigned i = 0; i < kNStreamsPerUnit; i++) {
+         fprintf(f,
+"      offsetof(DetectorUnit, fStream%03d),\n",
+         i);
+      }
 
-   fprintf(f,
+      fprintf(f,
 "   };\n"
 "\n"
-"   struct HWSignalsInterfaces {\n"
-   );
+      );
+   }
 
-   for (unsigned i = 0; i < kNHWSignalsInterfaces; ++i) {
+   if (layout != ELayout::kFlat) {
       fprintf(f,
-"      Stream fHWSignalStream%03d;\n",
-              i);
-   };
+"   struct Detectors {\n"
+      );
 
-   fprintf(f,
-"   };\n"
-"\n"
-"   struct Triggers {\n"
-   );
+      for (unsigned i = 0; i < kNUnits; ++i) {
+         if (layout == ELayout::kMembers) {
+            fprintf(f,
+"      DetectorUnit fUnit%03d;\n",
+                    i);
+         } else {
+            fprintf(f,
+"      std::vector<Stream> fUnit%03d;\n",
+                    i);
+         }
+      };
 
-   for (unsigned i = 0; i < kNTriggers; ++i) {
       fprintf(f,
-"      Stream fTriggerStream%03d;\n",
-              i);
-   };
-
-   fprintf(f,
 "   };\n"
-"   struct TRBuilders {\n"
-   );
+"   static constexpr std::size_t kUnitOffsets[%d] = {\n",
+      kNUnits);
 
-   for (unsigned i = 0; i < kNTRBuilders; ++i) {
-      fprintf(f,
-"      Stream fTRBuilderStream%03d;\n",
-              i);
-   };
+      for (unsigned i = 0; i < kNUnits; i++) {
+         fprintf(f,
+"      offsetof(Detectors, fUnit%03d),\n",
+         i);
+      }
 
-   fprintf(f,
+      fprintf(f,
 "   };\n"
 "\n"
+      );
+   }
+
+   WriteStreamGroup(f, "HWSignalsInterfaces", "fHWSignalStream", "kHWSignalStreamOffsets", kNHWSignalsInterfaces);
+   WriteStreamGroup(f, "Triggers", "fTriggerStream", "kTriggerStreamOffsets", kNTriggers);
+   WriteStreamGroup(f, "TRBuilders", "fTRBuilderStream", "kTRBuilderStreamOffsets", kNTRBuilders);
+
+   fprintf(f,
 "   std::uint64_t fTRID;\n"
 "   std::uint64_t fSliceID;\n"
 "   std::string fFragmentTypeSourceIdMap;\n"
@@ -124,94 +209,111 @@ int main(int argc, char **argv)
 "   std::string fSourceIdPathMap;\n"
 "   std::string fSubdetectorSourceIdMap;\n"
 "\n"
+   );
+
+   if (layout == ELayout::kFlat) {
+      fprintf(f,
+"   // Readout streams ordered by unit; the streams of unit i are [fUnitIndex[i], fUnitIndex[i + 1])\n"
+"   std::vector<Stream> fReadoutStreams;\n"
+"   std::vector<std::uint32_t> fUnitIndex;\n"
+      );
+   } else {
+      fprintf(f,
 "   Detectors fDetectors;\n"
+      );
+   }
+
+   fprintf(f,
 "   HWSignalsInterfaces fHWInterfaces;\n"
 "   Triggers fTriggers;\n"
 "   TRBuilders fTRBuilders;\n"
 "\n"
-"   Stream *GetReadoutStream(int detId, int streamId)\n"
-"   {\n"
-"      static bool kIsInitialized = false;\n"
-"      static size_t kStreamOffsets[%d][%d];\n"
-"      if (!kIsInitialized) {\n",
-   kNUnits, kNStreamsPerUnit);
-
-   for (unsigned i = 0; i < kNUnits; i++) {
-      for (unsigned j = 0; j < kNStreamsPerUnit; j++) {
-         fprintf(f,
-"         kStreamOffsets[%d][%d] = offsetof(TriggerRecord, fDetectors.fUnit%03d.fStream%03d);\n",
-         i, j, i, j);
-      }
-   }
+   );
 
-   fprintf(f,
-"         kIsInitialized = true;\n"
-"      }\n"
-"      return reinterpret_cast<Stream *>(reinterpret_cast<unsigned char *>(this) + kStreamOffsets[detId][streamId]);\n"
+   // The vector layouts are created with all readout streams present, so that the same data can be stored in
+   // every layout and stream pointers stay valid during filling.
+   switch (layout) {
+   case ELayout::kMembers:
+      break;
+   case ELayout::kUnits:
+      fprintf(f,
+"   %s()\n"
+"   {\n"
+"      for (int i = 0; i < kNUnits; ++i)\n"
+"         GetUnit(i).resize(kNStreamsPerUnit);\n"
 "   }\n"
 "\n"
-"   Stream *GetHWSignalsInterfaceStream(int id)\n"
+"   std::vector<Stream> &GetUnit(int detId)\n"
 "   {\n"
-"      static bool kIsInitialized = false;\n"
-"      static size_t kStreamOffsets[%d];\n"
-"      if (!kIsInitialized) {\n",
-   kNHWSignalsInterfaces);
-
-   for (unsigned i = 0; i < kNHWSignalsInterfaces; i++) {
+"      return *reinterpret_cast<std::vector<Stream> *>(reinterpret_cast<unsigned char *>(&fDetectors) +\n"
+"                                                      kUnitOffsets[detId]);\n"
+"   }\n"
+"\n",
+      className);
+      break;
+   case ELayout::kFlat:
       fprintf(f,
-"         kStreamOffsets[%d] = offsetof(TriggerRecord, fHWInterfaces.fHWSignalStream%03d);\n",
-      i, i);
+"   %s() : fReadoutStreams(kNUnits * kNStreamsPerUnit), fUnitIndex(kNUnits + 1)\n"
+"   {\n"
+"      for (int i = 0; i <= kNUnits; ++i)\n"
+"         fUnitIndex[i] = i * kNStreamsPerUnit;\n"
+"   }\n"
+"\n",
+      className);
+      break;
    }
 
    fprintf(f,
-"         kIsInitialized = true;\n"
-"      }\n"
-"      return reinterpret_cast<Stream *>(reinterpret_cast<unsigned char *>(this) + kStreamOffsets[id]);\n"
+"   static Stream *GetStreamAt(void *base, std::size_t offset)\n"
+"   {\n"
+"      return reinterpret_cast<Stream *>(reinterpret_cast<unsigned char *>(base) + offset);\n"
 "   }\n"
 "\n"
-"   Stream *GetTRBuilderStream(int id)\n"
+"   Stream *GetReadoutStream(int detId, int streamId)\n"
 "   {\n"
-"      static bool kIsInitialized = false;\n"
-"      static size_t kStreamOffsets[%d];\n"
-"      if (!kIsInitialized) {\n",
-   kNTRBuilders);
+   );
 
-   for (unsigned i = 0; i < kNTRBuilders; i++) {
+   switch (layout) {
+   case ELayout::kMembers:
       fprintf(f,
-"         kStreamOffsets[%d] = offsetof(TriggerRecord, fTRBuilders.fTRBuilderStream%03d);\n",
-      i, i);
+"      return GetStreamAt(&fDetectors, kUnitOffsets[detId] + kStreamOffsets[streamId]);\n"
+      );
+      break;
+   case ELayout::kUnits:
+      fprintf(f,
+"      return &GetUnit(detId)[streamId];\n"
+      );
+      break;
+   case ELayout::kFlat:
+      fprintf(f,
+"      return &fReadoutStreams[fUnitIndex[detId] + streamId];\n"
+      );
+      break;
    }
 
    fprintf(f,
-"         kIsInitialized = true;\n"
-"      }\n"
-"      return reinterpret_cast<Stream *>(reinterpret_cast<unsigned char *>(this) + kStreamOffsets[id]);\n"
+"   }\n"
+"\n"
+"   Stream *GetHWSignalsInterfaceStream(int id)\n"
+"   {\n"
+"      return GetStreamAt(&fHWInterfaces, kHWSignalStreamOffsets[id]);\n"
+"   }\n"
+"\n"
+"   Stream *GetTRBuilderStream(int id)\n"
+"   {\n"
+"      return GetStreamAt(&fTRBuilders, kTRBuilderStreamOffsets[id]);\n"
 "   }\n"
 "\n"
 "   Stream *GetTriggerStream(int id)\n"
 "   {\n"
-"      static bool kIsInitialized = false;\n"
-"      static size_t kStreamOffsets[%d];\n"
-"      if (!kIsInitialized) {\n",
-   kNTriggers);
-
-   for (unsigned i = 0; i < kNTriggers; i++) {
-      fprintf(f,
-"         kStreamOffsets[%d] = offsetof(TriggerRecord, fTriggers.fTriggerStream%03d);\n",
-      i, i);
-   }
-
-   fprintf(f,
-"         kIsInitialized = true;\n"
-"      }\n"
-"      return reinterpret_cast<Stream *>(reinterpret_cast<unsigned char *>(this) + kStreamOffsets[id]);\n"
+"      return GetStreamAt(&fTriggers, kTriggerStreamOffsets[id]);\n"
 "   }\n"
 "\n"
-"   ClassDefNV(TriggerRecord, 1)\n"
+"   ClassDefNV(%s, 1)\n"
 "};\n"
 "\n"
-"#endif // TriggerRecord_H\n"
-   );
+"#endif // %s_H\n",
+   className, className);
 
    fclose(f);
    return 0;
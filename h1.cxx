@@ -32,10 +32,12 @@
 #include <vector>
 #include <utility>
 
+#include "spill_file.h"
 #include "util.h"
 
 bool g_perf_stats = false;
 bool g_show = false;
+bool g_stream = false;
 int g_cluster_bunch_size = 1;
 
 static ROOT::Experimental::RNTupleReadOptions GetRNTupleOptions() {
@@ -130,7 +132,7 @@ static void Show(TH1D *hdmd, TH2D *h2) {
 static void TreeDirect(const std::string &path) {
    auto ts_init = std::chrono::steady_clock::now();
 
-   auto file = OpenOrDownload(path);
+   auto file = g_stream ? OpenOrStream(path) : OpenOrDownload(path);
    auto tree = file->Get<TTree>("h42");
 
    TTreePerfStats *ps = nullptr;
@@ -257,13 +259,15 @@ static void NTupleDirect(const std::string &path) {
    using RNTupleReader = ROOT::Experimental::RNTupleReader;
 
    // Trigger download if needed.
-   delete OpenOrDownload(path);
+   if (!g_stream)
+      delete OpenOrDownload(path);
 
    auto ts_init = std::chrono::steady_clock::now();
 
    auto model = RNTupleModel::Create();
    auto options = GetRNTupleOptions();
-   auto ntuple = RNTupleReader::Open(std::move(model), "h42", path, options);
+   auto ntuple = g_stream ? OpenNTupleOrStream(std::move(model), "h42", path, options)
+                          : RNTupleReader::Open(std::move(model), "h42", path, options);
    if (g_perf_stats)
       ntuple->EnableMetrics();
 
@@ -402,7 +406,7 @@ static void Rdf(ROOT::RDataFrame &df) {
 
 static void Usage(const char *progname) {
   printf("%s [-i input.root/ntuple] [-r(df)] [-m(t)] [-p(erformance stats)] [-x cluster bunch size]\n"
-         "   [-s(show)] [-m(t)]\n", progname);
+         "   [-s(show)] [-m(t)] [-w (process while downloading)]\n", progname);
 }
 
 int main(int argc, char **argv) {
@@ -411,7 +415,7 @@ int main(int argc, char **argv) {
    bool use_rdf = false;
    std::string path;
    int c;
-   while ((c = getopt(argc, argv, "hvpsri:mx:")) != -1) {
+   while ((c = getopt(argc, argv, "hvpsri:mx:w")) != -1) {
       switch (c) {
       case 'h':
       case 'v':
@@ -435,6 +439,9 @@ int main(int argc, char **argv) {
       case 'x':
          g_cluster_bunch_size = atoi(optarg);
          break;
+      case 'w':
+         g_stream = true;
+         break;
       default:
          fprintf(stderr, "Unknown option: -%c\n", c);
          Usage(argv[0]);
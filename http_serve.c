@@ -0,0 +1,338 @@
+/*
+ * Minimal HTTP/1.1 file server with byte-range support and artificial latency.
+ * Serves the files of one directory for the streaming benchmarks without root
+ * privileges (cf. add_latency, which needs tc/netem on a real network device).
+ */
+
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HDR_LEN 8192
+#define MAX_RANGES 1024
+#define BOUNDARY "HTTPSERVEBOUNDARY"
+
+static const char *g_root = ".";
+static int g_latency_ms = 0;
+static int g_verbose = 0;
+
+struct range {
+  uint64_t first;
+  uint64_t last;
+};
+
+void Usage(char *progname) {
+  printf("Usage: %s -d <document root> [-p port (8080)] [-l latency ms (0)] [-v(erbose)]\n",
+         progname);
+}
+
+static void Delay() {
+  if (g_latency_ms <= 0)
+    return;
+  struct timespec ts;
+  ts.tv_sec = g_latency_ms / 1000;
+  ts.tv_nsec = (long)(g_latency_ms % 1000) * 1000000L;
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+static int WriteAll(int fd, const void *buf, size_t len) {
+  const char *p = buf;
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    p += n;
+    len -= n;
+  }
+  return 0;
+}
+
+static int SendRange(int sock, int fd, uint64_t first, uint64_t last) {
+  off_t offset = first;
+  size_t len = last - first + 1;
+  while (len > 0) {
+    ssize_t n = sendfile(sock, fd, &offset, len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    if (n == 0)
+      return -1;
+    len -= n;
+  }
+  return 0;
+}
+
+static int SendStatus(int sock, int code, const char *reason) {
+  char hdr[256];
+  int n = snprintf(hdr, sizeof(hdr),
+                   "HTTP/1.1 %d %s\r\nContent-Length: 0\r\n\r\n", code, reason);
+  return WriteAll(sock, hdr, n);
+}
+
+/* Parses "bytes=a-b,c-,-d" into ranges; returns the number of ranges, 0 if no or
+ * an unsupported Range header is given, -1 if unsatisfiable */
+static int ParseRanges(const char *spec, uint64_t size, struct range *ranges) {
+  if (strncmp(spec, "bytes=", 6) != 0)
+    return 0;
+  spec += 6;
+  int nranges = 0;
+  while (*spec && nranges < MAX_RANGES) {
+    while (*spec == ' ' || *spec == ',')
+      spec++;
+    if (!*spec)
+      break;
+    char *end;
+    uint64_t first, last;
+    if (*spec == '-') {
+      uint64_t suffix = strtoull(spec + 1, &end, 10);
+      if (suffix == 0)
+        return -1;
+      first = (suffix > size) ? 0 : size - suffix;
+      last = size - 1;
+    } else {
+      first = strtoull(spec, &end, 10);
+      if (*end != '-')
+        return 0;
+      spec = end + 1;
+      if (*spec >= '0' && *spec <= '9') {
+        last = strtoull(spec, &end, 10);
+      } else {
+        last = size - 1;
+        end = (char *)spec;
+      }
+      if (last >= size)
+        last = size - 1;
+    }
+    if (first > last || first >= size)
+      return -1;
+    ranges[nranges].first = first;
+    ranges[nranges].last = last;
+    nranges++;
+    spec = end;
+  }
+  return nranges;
+}
+
+static int ServeFile(int sock, const char *method, const char *url, const char *range_spec) {
+  char path[4096];
+  const char *name = strrchr(url, '/');
+  name = name ? name + 1 : url;
+  /* Only flat file names below the document root */
+  if (!*name || strstr(name, "..")) {
+    return SendStatus(sock, 404, "Not Found");
+  }
+  int path_len = snprintf(path, sizeof(path), "%s/%s", g_root, name);
+  if (path_len < 0 || (size_t)path_len >= sizeof(path))
+    return SendStatus(sock, 414, "URI Too Long");
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return SendStatus(sock, 404, "Not Found");
+  struct stat info;
+  fstat(fd, &info);
+  uint64_t size = info.st_size;
+  int is_head = (strcmp(method, "HEAD") == 0);
+
+  static __thread struct range ranges[MAX_RANGES];
+  int nranges = range_spec ? ParseRanges(range_spec, size, ranges) : 0;
+  char hdr[HDR_LEN];
+  int retval = 0;
+  int n;
+
+  if (nranges < 0) {
+    n = snprintf(hdr, sizeof(hdr),
+                 "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%lu\r\n"
+                 "Content-Length: 0\r\n\r\n", size);
+    retval = WriteAll(sock, hdr, n);
+  } else if (nranges == 0) {
+    n = snprintf(hdr, sizeof(hdr),
+                 "HTTP/1.1 200 OK\r\nAccept-Ranges: bytes\r\nContent-Length: %lu\r\n"
+                 "Content-Type: application/octet-stream\r\n\r\n", size);
+    retval = WriteAll(sock, hdr, n);
+    if (!retval && !is_head && size > 0)
+      retval = SendRange(sock, fd, 0, size - 1);
+  } else if (nranges == 1) {
+    n = snprintf(hdr, sizeof(hdr),
+                 "HTTP/1.1 206 Partial Content\r\nAccept-Ranges: bytes\r\n"
+                 "Content-Range: bytes %lu-%lu/%lu\r\nContent-Length: %lu\r\n"
+                 "Content-Type: application/octet-stream\r\n\r\n",
+                 ranges[0].first, ranges[0].last, size, ranges[0].last - ranges[0].first + 1);
+    retval = WriteAll(sock, hdr, n);
+    if (!retval && !is_head)
+      retval = SendRange(sock, fd, ranges[0].first, ranges[0].last);
+  } else {
+    /* Vector read: multipart/byteranges response, first compute the total length */
+    char part[256];
+    uint64_t content_length = 0;
+    for (int i = 0; i < nranges; ++i) {
+      content_length += snprintf(part, sizeof(part),
+        "\r\n--" BOUNDARY "\r\nContent-Type: application/octet-stream\r\n"
+        "Content-Range: bytes %lu-%lu/%lu\r\n\r\n", ranges[i].first, ranges[i].last, size);
+      content_length += ranges[i].last - ranges[i].first + 1;
+    }
+    content_length += strlen("\r\n--" BOUNDARY "--\r\n");
+    n = snprintf(hdr, sizeof(hdr),
+                 "HTTP/1.1 206 Partial Content\r\nAccept-Ranges: bytes\r\n"
+                 "Content-Type: multipart/byteranges; boundary=" BOUNDARY "\r\n"
+                 "Content-Length: %lu\r\n\r\n", content_length);
+    retval = WriteAll(sock, hdr, n);
+    for (int i = 0; !retval && !is_head && i < nranges; ++i) {
+      n = snprintf(part, sizeof(part),
+        "\r\n--" BOUNDARY "\r\nContent-Type: application/octet-stream\r\n"
+        "Content-Range: bytes %lu-%lu/%lu\r\n\r\n", ranges[i].first, ranges[i].last, size);
+      retval = WriteAll(sock, part, n);
+      if (!retval)
+        retval = SendRange(sock, fd, ranges[i].first, ranges[i].last);
+    }
+    if (!retval && !is_head)
+      retval = WriteAll(sock, "\r\n--" BOUNDARY "--\r\n", strlen("\r\n--" BOUNDARY "--\r\n"));
+  }
+
+  if (g_verbose)
+    fprintf(stderr, "%s %s [%d ranges] %s\n", method, name, nranges, range_spec ? range_spec : "");
+  close(fd);
+  return retval;
+}
+
+/* Reads one request header block; returns its length or -1 on EOF/error */
+static int ReadRequest(int sock, char *buf, int *filled) {
+  while (1) {
+    buf[*filled] = '\0';
+    char *end = strstr(buf, "\r\n\r\n");
+    if (end)
+      return (end - buf) + 4;
+    if (*filled >= HDR_LEN - 1)
+      return -1;
+    ssize_t n = read(sock, buf + *filled, HDR_LEN - 1 - *filled);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    *filled += n;
+  }
+}
+
+static void *ServeConnection(void *arg) {
+  int sock = (int)(intptr_t)arg;
+  int one = 1;
+  setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  char buf[HDR_LEN];
+  int filled = 0;
+  int len;
+  while ((len = ReadRequest(sock, buf, &filled)) > 0) {
+    char method[16], url[4096];
+    if (sscanf(buf, "%15s %4095s", method, url) != 2)
+      break;
+
+    char *range_spec = NULL;
+    int keep_alive = 1;
+    char *line = strstr(buf, "\r\n");
+    while (line && line < buf + len - 4) {
+      line += 2;
+      if (strncasecmp(line, "Range:", 6) == 0) {
+        range_spec = line + 6;
+        while (*range_spec == ' ')
+          range_spec++;
+      } else if (strncasecmp(line, "Connection: close", 17) == 0) {
+        keep_alive = 0;
+      }
+      line = strstr(line, "\r\n");
+      if (line)
+        *line = '\0';
+    }
+
+    Delay();
+    int retval;
+    if (strcmp(method, "GET") == 0 || strcmp(method, "HEAD") == 0)
+      retval = ServeFile(sock, method, url, range_spec);
+    else
+      retval = SendStatus(sock, 405, "Method Not Allowed");
+    if (retval || !keep_alive)
+      break;
+
+    memmove(buf, buf + len, filled - len);
+    filled -= len;
+  }
+  close(sock);
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  int port = 8080;
+  int c;
+  while ((c = getopt(argc, argv, "hd:p:l:v")) != -1) {
+    switch (c) {
+    case 'h':
+      Usage(argv[0]);
+      return 0;
+    case 'd':
+      g_root = optarg;
+      break;
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 'l':
+      g_latency_ms = atoi(optarg);
+      break;
+    case 'v':
+      g_verbose = 1;
+      break;
+    default:
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  int sock_listen = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(sock_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  if (bind(sock_listen, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(sock_listen, 64) != 0) {
+    perror("cannot listen");
+    return 1;
+  }
+  printf("Serving %s on http://localhost:%d with %dms latency\n", g_root, port, g_latency_ms);
+  fflush(stdout);
+
+  while (1) {
+    int sock = accept(sock_listen, NULL, NULL);
+    if (sock < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("accept");
+      return 1;
+    }
+    pthread_t thread;
+    pthread_create(&thread, NULL, ServeConnection, (void *)(intptr_t)sock);
+    pthread_detach(thread);
+  }
+  return 0;
+}
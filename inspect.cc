@@ -1,11 +1,21 @@
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include <lz4.h>
+#include <lzma.h>
+#include <zlib.h>
+#include <zstd.h>
+
+#include <algorithm>
+#include <cinttypes>
 #include <cstdint>
 #include <cstdio>
-
-#include <iostream>
+#include <cstring>
+#include <map>
 #include <string>
+#include <vector>
 
 /// Big-endian 16-bit unsigned integer
 class RUInt16BE {
@@ -87,145 +97,718 @@ public:
    }
 };
 
-void Usage(char *progname) {
-  printf("Usage: %s <ROOT file> [-b(ig file)]\n", progname);
-}
 
-int main(int argc, char **argv) {
-  if (argc < 2) {
-    Usage(argv[0]);
-    return 1;
+/**
+ * Sequential reader of the big-endian TFile records in the mapped file.  Reads past the end of the file
+ * return zero and clear fOk, so that the callers check once after a record.
+ */
+class RBEReader {
+  const unsigned char *fBase;
+  std::uint64_t fSize;
+  std::uint64_t fPos;
+
+  template <typename BeT, typename T>
+  T Read() {
+    if (fPos + sizeof(BeT) > fSize) {
+      fOk = false;
+      fPos = fSize;
+      return 0;
+    }
+    BeT val;
+    memcpy(&val, fBase + fPos, sizeof(val));
+    fPos += sizeof(val);
+    return val;
   }
 
-  bool bigFile = false;
-  if ((argc >= 3) && (std::string(argv[2]) == "-b")) {
-    bigFile = true;
+ public:
+  bool fOk = true;
+
+  RBEReader(const unsigned char *base, std::uint64_t size, std::uint64_t pos)
+    : fBase(base), fSize(size), fPos(pos) {}
+
+  std::uint64_t GetPos() const { return fPos; }
+  std::uint8_t U8() {
+    if (fPos >= fSize) {
+      fOk = false;
+      return 0;
+    }
+    return fBase[fPos++];
+  }
+  std::uint16_t U16() { return Read<RUInt16BE, std::uint16_t>(); }
+  std::uint32_t U32() { return Read<RUInt32BE, std::uint32_t>(); }
+  std::int32_t I32() { return Read<RInt32BE, std::int32_t>(); }
+  std::uint64_t U64() { return Read<RUInt64BE, std::uint64_t>(); }
+  /// 32-bit or 64-bit file offset
+  std::uint64_t Seek(bool isBig) { return isBig ? U64() : U32(); }
+  /// A TString: one byte length, or 255 followed by a four bytes length
+  std::string String() {
+    std::uint32_t len = U8();
+    if (len == 255)
+      len = U32();
+    if (!fOk || (fPos + len > fSize)) {
+      fOk = false;
+      return "";
+    }
+    std::string result(reinterpret_cast<const char *>(fBase + fPos), len);
+    fPos += len;
+    return result;
   }
+};
 
-  std::string path = argv[1];
+/// Little-endian reader of the RNTuple envelopes, with the same error handling as RBEReader
+class RLEReader {
+  const unsigned char *fBase;
+  std::uint64_t fSize;
+  std::uint64_t fPos = 0;
+
+  template <typename T>
+  T Read() {
+    if (fPos + sizeof(T) > fSize) {
+      fOk = false;
+      fPos = fSize;
+      return 0;
+    }
+    T val;
+    memcpy(&val, fBase + fPos, sizeof(val));
+    fPos += sizeof(val);
+    return val;
+  }
 
-  int fd = open(path.c_str(), O_RDONLY);
-  if (fd < 0) {
-    fprintf(stderr, "Cannot open %s\n", path.c_str());
-    return 1;
+ public:
+  bool fOk = true;
+
+  RLEReader(const unsigned char *base, std::uint64_t size) : fBase(base), fSize(size) {}
+
+  std::uint64_t GetPos() const { return fPos; }
+  void SetPos(std::uint64_t pos) {
+    if (pos > fSize) {
+      fOk = false;
+      pos = fSize;
+    }
+    fPos = pos;
+  }
+  std::uint16_t U16() { return Read<std::uint16_t>(); }
+  std::uint32_t U32() { return Read<std::uint32_t>(); }
+  std::int32_t I32() { return Read<std::int32_t>(); }
+  std::uint64_t U64() { return Read<std::uint64_t>(); }
+  std::int64_t I64() { return Read<std::int64_t>(); }
+  std::string String() {
+    std::uint32_t len = U32();
+    if (!fOk || (fPos + len > fSize)) {
+      fOk = false;
+      return "";
+    }
+    std::string result(reinterpret_cast<const char *>(fBase + fPos), len);
+    fPos += len;
+    return result;
   }
 
-  lseek(fd, 100, SEEK_SET);
+  /// Feature flags: 64-bit words, the most significant bit marks another word to follow
+  void FeatureFlags() {
+    while (fOk && (U64() & 0x8000000000000000))
+      ;
+  }
 
-  RUInt32BE nbytes;
-  read(fd, &nbytes, sizeof(nbytes));
-  printf("NBytes: %u\n", (std::uint32_t)nbytes);
+  /// Record frames have a positive size, list frames a negative one followed by the number of items.
+  /// Returns the end position of the frame.
+  std::uint64_t Frame(std::uint32_t *nitems) {
+    const auto start = fPos;
+    auto size = I64();
+    *nitems = 0;
+    if (size < 0) {
+      size = -size;
+      *nitems = U32();
+    }
+    if (size < 8 || start + size > fSize)
+      fOk = false;
+    return fOk ? start + size : fSize;
+  }
 
-  RUInt16BE version;
-  read(fd, &version, sizeof(version));
-  printf("Version: %u\n", (std::uint16_t)version);
+  /// Returns false for locators of other storage types than files
+  bool Locator(std::uint64_t *offset, std::uint64_t *nbytes) {
+    const auto head = U32();
+    if ((head & 0x80000000) == 0) {
+      *nbytes = head;
+      *offset = U64();
+      return fOk;
+    }
+    // Non-standard locator: type and payload size; type 1 is the large locator of files
+    const std::uint32_t type = (head >> 24) & 0x7F;
+    const std::uint32_t payloadSize = head & 0xFFFF;
+    if ((type == 0x01) && (payloadSize == 16)) {
+      *nbytes = U64();
+      *offset = U64();
+      return fOk;
+    }
+    SetPos(fPos + payloadSize);
+    return false;
+  }
+};
 
-  RUInt32BE objlen;
-  read(fd, &objlen, sizeof(objlen));
-  printf("ObjLen: %u\n", (std::uint32_t)objlen);
 
-  RUInt32BE datetime;
-  read(fd, &datetime, sizeof(datetime));
+/// A byte range of the file.  Level 0 are the TFile records, level 1 the RNTuple objects within RBlob keys.
+struct RByteRange {
+  std::uint64_t fOffset;
+  std::uint64_t fSize;
+  int fLevel;
+  std::string fKind;
+  std::string fName;
+  std::string fDetail;
+};
 
-  RUInt16BE keylen;
-  read(fd, &keylen, sizeof(keylen));
-  printf("KeyLen: %u\n", (std::uint16_t)keylen);
+struct RTFileHeader {
+  std::int32_t fVersion = 0;
+  bool fIsBig = false;
+  std::uint64_t fBEGIN = 0;
+  std::uint64_t fEND = 0;
+  std::uint64_t fSeekFree = 0;
+  std::uint32_t fNbytesFree = 0;
+  std::uint32_t fNbytesName = 0;
+  std::int32_t fCompress = 0;
+  std::uint64_t fSeekInfo = 0;
+  std::uint32_t fNbytesInfo = 0;
+  std::uint64_t fSeekKeys = 0;  ///< of the top directory, which follows the file header
+};
 
-  RUInt16BE cycle;
-  read(fd, &cycle, sizeof(cycle));
-  printf("Cycle: %u\n", (std::uint16_t)cycle);
+struct RKeyInfo {
+  std::uint64_t fOffset;
+  std::uint32_t fNbytes;
+  std::uint32_t fObjLen;
+  std::uint16_t fKeyLen;
+  std::uint16_t fCycle;
+  std::string fClassName;
+  std::string fName;
+  std::string fTitle;
+};
 
-  RUInt32BE seekkey;
-  read(fd, &seekkey, sizeof(seekkey));
-  printf("SeekKey: %u\n", (std::uint32_t)seekkey);
 
-  RUInt32BE seekpdir;
-  read(fd, &seekpdir, sizeof(seekpdir));
-  printf("SeekPDir: %u\n", (std::uint32_t)seekpdir);
+/// Decompresses a sequence of ROOT compression blocks into exactly dstSize bytes
+static bool Unzip(const unsigned char *src, std::uint64_t srcSize, unsigned char *dst, std::uint64_t dstSize)
+{
+  constexpr std::uint64_t kHeaderSize = 9;
+  if (srcSize == dstSize) {
+    memcpy(dst, src, dstSize);
+    return true;
+  }
+  std::uint64_t srcPos = 0;
+  std::uint64_t dstPos = 0;
+  while ((srcPos + kHeaderSize <= srcSize) && (dstPos < dstSize)) {
+    const unsigned char *h = src + srcPos;
+    const std::uint64_t zipSize = h[3] | (h[4] << 8) | (h[5] << 16);
+    const std::uint64_t unzipSize = h[6] | (h[7] << 8) | (h[8] << 16);
+    const unsigned char *zipped = h + kHeaderSize;
+    if ((srcPos + kHeaderSize + zipSize > srcSize) || (dstPos + unzipSize > dstSize))
+      return false;
+
+    if (h[0] == 'Z' && h[1] == 'S') {
+      if (ZSTD_decompress(dst + dstPos, unzipSize, zipped, zipSize) != unzipSize)
+        return false;
+    } else if (h[0] == 'Z' && h[1] == 'L') {
+      z_stream stream;
+      memset(&stream, 0, sizeof(stream));
+      stream.next_in = const_cast<unsigned char *>(zipped);
+      stream.avail_in = zipSize;
+      stream.next_out = dst + dstPos;
+      stream.avail_out = unzipSize;
+      if (inflateInit(&stream) != Z_OK)
+        return false;
+      const int retval = inflate(&stream, Z_FINISH);
+      inflateEnd(&stream);
+      if ((retval != Z_STREAM_END) || (stream.total_out != unzipSize))
+        return false;
+    } else if (h[0] == 'X' && h[1] == 'Z') {
+      std::uint64_t memlimit = UINT64_MAX;
+      size_t inPos = 0;
+      size_t outPos = 0;
+      if (lzma_stream_buffer_decode(&memlimit, 0, nullptr, zipped, &inPos, zipSize, dst + dstPos, &outPos,
+                                    unzipSize) != LZMA_OK)
+        return false;
+    } else if (h[0] == 'L' && h[1] == '4') {
+      // The LZ4 block is preceded by an 8 bytes checksum
+      constexpr std::uint64_t kChecksumSize = 8;
+      if ((zipSize < kChecksumSize) ||
+          (LZ4_decompress_safe(reinterpret_cast<const char *>(zipped + kChecksumSize),
+                               reinterpret_cast<char *>(dst + dstPos), zipSize - kChecksumSize,
+                               unzipSize) != int(unzipSize)))
+        return false;
+    } else {
+      return false;
+    }
+    srcPos += kHeaderSize + zipSize;
+    dstPos += unzipSize;
+  }
+  return dstPos == dstSize;
+}
 
-  char lclname;
-  read(fd, &lclname, sizeof(lclname));
-  printf("lclname: %u\n", lclname);
 
-  unsigned char buf[1000];
-  read(fd, buf, lclname);
+/**
+ * The physical columns of an RNTuple, named after their fields, and the byte ranges of the RNTuple envelopes
+ * and pages.  Understands the anchor and envelope format of ROOT 6.32 and of RNTuple 1.0.
+ */
+class RNTupleWalker {
+  const unsigned char *fFile;
+  std::uint64_t fFileSize;
+  std::string fNTupleName;
+  std::vector<RByteRange> &fRanges;
+
+  struct RFieldInfo {
+    std::uint32_t fParentId;
+    std::string fName;
+  };
+  std::vector<RFieldInfo> fFields;
+  std::vector<std::uint32_t> fColumnFieldIds;
+  std::vector<std::string> fColumnNames;
+
+  /// Decompressed envelope; false if the range is outside the file or the envelope is not of the expected type
+  bool ReadEnvelope(std::uint64_t offset, std::uint64_t nbytes, std::uint64_t len, std::uint16_t expectedType,
+                    std::vector<unsigned char> *buffer)
+  {
+    // Envelopes are written as a single key, whose size is limited to 4GB
+    if ((offset + nbytes > fFileSize) || (len < 16) || (len > (std::uint64_t(1) << 32)))
+      return false;
+    buffer->resize(len);
+    if (!Unzip(fFile + offset, nbytes, buffer->data(), len))
+      return false;
+    RLEReader reader(buffer->data(), len);
+    const auto typeAndLength = reader.U64();
+    return ((typeAndLength & 0xFFFF) == expectedType) && ((typeAndLength >> 16) == len);
+  }
 
-  char lobjname;
-  read(fd, &lobjname, sizeof(lobjname));
-  printf("lobjname: %u\n", lobjname);
+  void AddRange(std::uint64_t offset, std::uint64_t size, const std::string &kind, const std::string &name,
+                const std::string &detail = "")
+  {
+    fRanges.push_back(RByteRange{offset, size, 1, kind, name, detail});
+  }
 
-  read(fd, buf, lobjname);
+  /// Field and column list frames, as found in the header and in the schema extension of the footer
+  bool ReadSchema(RLEReader &reader, std::uint64_t end) {
+    std::uint32_t nFields;
+    auto fieldsEnd = reader.Frame(&nFields);
+    for (std::uint32_t i = 0; i < nFields && reader.fOk; ++i) {
+      std::uint32_t dummy;
+      auto recordEnd = reader.Frame(&dummy);
+      reader.U32();  // field version
+      reader.U32();  // type version
+      const auto parentId = reader.U32();
+      reader.U16();  // structural role
+      const auto flags = reader.U16();
+      if (flags & 0x01)
+        reader.U64();  // repetition
+      if (flags & 0x02)
+        reader.U32();  // source field of a projected field
+      if (flags & 0x04)
+        reader.U32();  // type checksum
+      fFields.push_back(RFieldInfo{parentId, reader.String()});
+      reader.SetPos(recordEnd);
+    }
+    reader.SetPos(fieldsEnd);
+
+    std::uint32_t nColumns;
+    auto columnsEnd = reader.Frame(&nColumns);
+    for (std::uint32_t i = 0; i < nColumns && reader.fOk; ++i) {
+      std::uint32_t dummy;
+      auto recordEnd = reader.Frame(&dummy);
+      reader.U16();  // type
+      reader.U16();  // bits on storage
+      fColumnFieldIds.push_back(reader.U32());
+      reader.SetPos(recordEnd);
+    }
+    reader.SetPos(columnsEnd);
+    return reader.fOk && (reader.GetPos() <= end);
+  }
 
-  char ltitle;
-  read(fd, &ltitle, sizeof(ltitle));
-  printf("ltitle: %u\n", ltitle);
+  std::string GetFieldName(std::uint32_t fieldId) const {
+    std::string name;
+    for (unsigned depth = 0; (fieldId < fFields.size()) && (depth < fFields.size()); ++depth) {
+      name = name.empty() ? fFields[fieldId].fName : fFields[fieldId].fName + "." + name;
+      if (fFields[fieldId].fParentId == fieldId)
+        break;
+      fieldId = fFields[fieldId].fParentId;
+    }
+    return name;
+  }
 
-  read(fd, buf, ltitle);
+  /// Columns of the same field are numbered in the order of their physical ids
+  void NameColumns() {
+    std::map<std::uint32_t, unsigned> nColumnsPerField;
+    for (auto fieldId : fColumnFieldIds) {
+      auto idx = nColumnsPerField[fieldId]++;
+      fColumnNames.push_back(GetFieldName(fieldId) + "#" + std::to_string(idx));
+    }
+  }
 
-  // TFILE DATA
+  std::string GetColumnName(std::uint32_t columnId) const {
+    if (columnId < fColumnNames.size())
+      return fColumnNames[columnId];
+    return "column " + std::to_string(columnId);
+  }
 
-  read(fd, &lobjname, sizeof(lobjname));
-  printf("lobjname(TFile): %u\n", lobjname);
-  read(fd, buf, lobjname);
+  bool ReadPageList(std::uint64_t offset, std::uint64_t nbytes, std::uint64_t len, std::uint64_t firstClusterId,
+                    std::uint64_t *nPages)
+  {
+    std::vector<unsigned char> buffer;
+    if (!ReadEnvelope(offset, nbytes, len, 0x03, &buffer))
+      return false;
+    RLEReader reader(buffer.data(), len - 8);
+    reader.SetPos(8);
+    reader.U64();  // header checksum
+    std::uint32_t nClusterSummaries;
+    reader.SetPos(reader.Frame(&nClusterSummaries));
+
+    std::uint32_t nClusters;
+    auto clustersEnd = reader.Frame(&nClusters);
+    for (std::uint32_t c = 0; c < nClusters && reader.fOk; ++c) {
+      std::uint32_t nColumns;
+      auto columnsEnd = reader.Frame(&nColumns);
+      for (std::uint32_t col = 0; col < nColumns && reader.fOk; ++col) {
+        std::uint32_t nPagesInColumn;
+        auto pagesEnd = reader.Frame(&nPagesInColumn);
+        for (std::uint32_t p = 0; p < nPagesInColumn && reader.fOk; ++p) {
+          auto nElements = reader.I32();  // negative if the page has a checksum
+          std::uint64_t pageOffset, pageSize;
+          if (!reader.Locator(&pageOffset, &pageSize))
+            continue;
+          AddRange(pageOffset, pageSize, "ntuple-page", fNTupleName + ":" + GetColumnName(col),
+                   "cluster=" + std::to_string(firstClusterId + c) + " page=" + std::to_string(p) +
+                   " elements=" + std::to_string(nElements < 0 ? -std::int64_t(nElements) : nElements));
+          (*nPages)++;
+        }
+        reader.SetPos(pagesEnd);
+      }
+      reader.SetPos(columnsEnd);
+    }
+    reader.SetPos(clustersEnd);
+    return reader.fOk;
+  }
 
-  read(fd, &ltitle, sizeof(ltitle));
-  printf("ltitle(TFile): %u\n", ltitle);
-  read(fd, buf, ltitle);
+ public:
+  RNTupleWalker(const unsigned char *file, std::uint64_t fileSize, const std::string &ntupleName,
+                std::vector<RByteRange> &ranges)
+    : fFile(file), fFileSize(fileSize), fNTupleName(ntupleName), fRanges(ranges) {}
+
+  /// Parses the anchor object (the key payload) and everything it links to; prints a warning on failure
+  void Walk(const unsigned char *anchor, std::uint32_t anchorSize) {
+    RBEReader reader(anchor, anchorSize, 0);
+    // Byte count and class version of the streamer, the format version, and the envelope links
+    if ((reader.U32() & 0x40000000) == 0) {
+      fprintf(stderr, "%s: unsupported RNTuple anchor version\n", fNTupleName.c_str());
+      return;
+    }
+    reader.U16();
+    for (int i = 0; i < 4; ++i)
+      reader.U16();
+    const auto seekHeader = reader.U64();
+    const auto nbytesHeader = reader.U64();
+    const auto lenHeader = reader.U64();
+    const auto seekFooter = reader.U64();
+    const auto nbytesFooter = reader.U64();
+    const auto lenFooter = reader.U64();
+    if (!reader.fOk) {
+      fprintf(stderr, "%s: truncated RNTuple anchor\n", fNTupleName.c_str());
+      return;
+    }
+    AddRange(seekHeader, nbytesHeader, "ntuple-header", fNTupleName, "len=" + std::to_string(lenHeader));
+    AddRange(seekFooter, nbytesFooter, "ntuple-footer", fNTupleName, "len=" + std::to_string(lenFooter));
+
+    std::vector<unsigned char> header;
+    if (!ReadEnvelope(seekHeader, nbytesHeader, lenHeader, 0x01, &header)) {
+      fprintf(stderr, "%s: cannot read RNTuple header (unsupported format or compression)\n",
+              fNTupleName.c_str());
+      return;
+    }
+    RLEReader headerReader(header.data(), lenHeader - 8);
+    headerReader.SetPos(8);
+    headerReader.FeatureFlags();
+    headerReader.String();  // name
+    headerReader.String();  // description
+    headerReader.String();  // writer
+    if (!ReadSchema(headerReader, lenHeader - 8))
+      fprintf(stderr, "%s: cannot parse RNTuple schema, columns are unnamed\n", fNTupleName.c_str());
+
+    std::vector<unsigned char> footer;
+    if (!ReadEnvelope(seekFooter, nbytesFooter, lenFooter, 0x02, &footer)) {
+      fprintf(stderr, "%s: cannot read RNTuple footer\n", fNTupleName.c_str());
+      return;
+    }
+    RLEReader footerReader(footer.data(), lenFooter - 8);
+    footerReader.SetPos(8);
+    footerReader.FeatureFlags();
+    footerReader.U64();  // header checksum
+    std::uint32_t dummy;
+    auto extensionEnd = footerReader.Frame(&dummy);
+    if (footerReader.fOk && (footerReader.GetPos() < extensionEnd))
+      ReadSchema(footerReader, extensionEnd);
+    footerReader.SetPos(extensionEnd);
+    NameColumns();
+
+    // The cluster groups are the first non-empty list; ROOT 6.32 writes an empty list of column groups first
+    std::uint32_t nClusterGroups = 0;
+    std::uint64_t groupsEnd = 0;
+    while (footerReader.fOk && (footerReader.GetPos() < lenFooter - 8) && (nClusterGroups == 0)) {
+      groupsEnd = footerReader.Frame(&nClusterGroups);
+      if (nClusterGroups == 0)
+        footerReader.SetPos(groupsEnd);
+    }
+    std::uint64_t clusterId = 0;
+    std::uint64_t nPages = 0;
+    for (std::uint32_t g = 0; g < nClusterGroups && footerReader.fOk; ++g) {
+      auto recordEnd = footerReader.Frame(&dummy);
+      footerReader.U64();  // first entry
+      footerReader.U64();  // number of entries
+      const auto nClusters = footerReader.U32();
+      const auto lenPageList = footerReader.U64();
+      std::uint64_t seekPageList, nbytesPageList;
+      if (footerReader.Locator(&seekPageList, &nbytesPageList)) {
+        AddRange(seekPageList, nbytesPageList, "ntuple-pagelist", fNTupleName,
+                 "group=" + std::to_string(g) + " clusters=" + std::to_string(nClusters));
+        if (!ReadPageList(seekPageList, nbytesPageList, lenPageList, clusterId, &nPages))
+          fprintf(stderr, "%s: cannot read page list of cluster group %u\n", fNTupleName.c_str(), g);
+      }
+      clusterId += nClusters;
+      footerReader.SetPos(recordEnd);
+    }
+    if (!footerReader.fOk)
+      fprintf(stderr, "%s: cannot parse RNTuple footer\n", fNTupleName.c_str());
+  }
+};
 
-  RUInt16BE tfileversion;
-  read(fd, &tfileversion, sizeof(tfileversion));
-  printf("TFile version: %u\n", (std::uint16_t)tfileversion);
-//  char modified;
-//  read(fd, &modified, sizeof(modified));
-//  printf("modified: %u\n", modified);
-//
-//  char writable;
-//  read(fd, &writable, sizeof(writable));
-//  printf("writable: %u\n", writable);
 
-  read(fd, &datetime, sizeof(datetime));
-  read(fd, &datetime, sizeof(datetime));
+static bool ReadFileHeader(const unsigned char *file, std::uint64_t size, RTFileHeader *hdr) {
+  if ((size < 4) || (memcmp(file, "root", 4) != 0))
+    return false;
+  RBEReader reader(file, size, 4);
+  hdr->fVersion = reader.I32();
+  // Files larger than 2GB use 64-bit offsets, marked by adding 1000000 to the version
+  hdr->fIsBig = hdr->fVersion >= 1000000;
+  hdr->fBEGIN = reader.U32();
+  hdr->fEND = reader.Seek(hdr->fIsBig);
+  hdr->fSeekFree = reader.Seek(hdr->fIsBig);
+  hdr->fNbytesFree = reader.U32();
+  reader.U32();  // number of free segments
+  hdr->fNbytesName = reader.U32();
+  reader.U8();  // units
+  hdr->fCompress = reader.I32();
+  hdr->fSeekInfo = reader.Seek(hdr->fIsBig);
+  hdr->fNbytesInfo = reader.U32();
+  if (!reader.fOk)
+    return false;
+
+  // The top directory record follows the key of the TFile object and the name of the file
+  RBEReader dir(file, size, hdr->fBEGIN + hdr->fNbytesName);
+  const auto dirVersion = dir.U16();
+  dir.U32();  // creation date
+  dir.U32();  // modification date
+  dir.U32();  // nbytes keys
+  dir.U32();  // nbytes name
+  const bool isBigDir = dirVersion > 1000;
+  dir.Seek(isBigDir);  // seek dir
+  dir.Seek(isBigDir);  // seek parent
+  hdr->fSeekKeys = dir.Seek(isBigDir);
+  return true;
+}
 
-  RUInt32BE nbyteskeys;
-  read(fd, &nbyteskeys, sizeof(nbyteskeys));
-  printf("NByteKeys: %u\n", (std::uint32_t)nbyteskeys);
+static bool ReadKey(const unsigned char *file, std::uint64_t size, std::uint64_t offset, RKeyInfo *key) {
+  RBEReader reader(file, size, offset);
+  key->fOffset = offset;
+  key->fNbytes = reader.U32();
+  const auto version = reader.U16();
+  key->fObjLen = reader.U32();
+  reader.U32();  // date
+  key->fKeyLen = reader.U16();
+  key->fCycle = reader.U16();
+  reader.Seek(version > 1000);  // seek key
+  reader.Seek(version > 1000);  // seek parent directory
+  key->fClassName = reader.String();
+  key->fName = reader.String();
+  key->fTitle = reader.String();
+  return reader.fOk && (key->fKeyLen <= key->fNbytes) && (offset + key->fNbytes <= size);
+}
 
-  RUInt32BE nbytesname;
-  read(fd, &nbytesname, sizeof(nbytesname));
-  printf("NByteName: %u\n", (std::uint32_t)nbytesname);
+static std::string ClassifyKey(const RKeyInfo &key, const RTFileHeader &hdr) {
+  if (key.fOffset == hdr.fBEGIN)
+    return "top-directory";
+  if (key.fOffset == hdr.fSeekKeys)
+    return "keys-list";
+  if (key.fOffset == hdr.fSeekFree)
+    return "free-segments";
+  if (key.fOffset == hdr.fSeekInfo)
+    return "streamer-info";
+  if (key.fClassName == "TBasket")
+    return "basket";
+  if (key.fClassName == "ROOT::Experimental::RNTuple" || key.fClassName == "ROOT::RNTuple")
+    return "ntuple-anchor";
+  if (key.fClassName == "RBlob")
+    return "blob";
+  if (key.fClassName == "TDirectory" || key.fClassName == "TDirectoryFile")
+    return "directory";
+  return "object";
+}
 
-  if (bigFile) {
-    RUInt64BE seekdir;
-    read(fd, &seekdir, sizeof(seekdir));
-    printf("SeekDir: %lu\n", (std::uint64_t)seekdir);
 
-    RUInt64BE seekparent;
-    read(fd, &seekparent, sizeof(seekparent));
-    printf("SeekParent: %lu\n", (std::uint64_t)seekparent);
+/// Number of contiguous runs of the same name among the ranges of the given kind, in file order
+static std::uint64_t CountRuns(const std::vector<RByteRange> &ranges, const std::string &kind) {
+  std::uint64_t nRuns = 0;
+  const std::string *prevName = nullptr;
+  for (const auto &r : ranges) {
+    if (r.fKind != kind)
+      continue;
+    if (!prevName || (*prevName != r.fName))
+      nRuns++;
+    prevName = &r.fName;
+  }
+  return nRuns;
+}
 
-    RUInt64BE seekkeys;
-    read(fd, &seekkeys, sizeof(seekkeys));
-    printf("SeekKeys: %lu\n", (std::uint64_t)seekkeys);
-  } else {
-    RUInt32BE seekdir;
-    read(fd, &seekdir, sizeof(seekdir));
-    printf("SeekDir: %u\n", (std::uint32_t)seekdir);
+static void Usage(const char *progname) {
+  printf("Usage: %s [-s(ummary only)] [-o <byte range map (tab separated)>] <ROOT file>\n"
+         "  The map has the columns offset, size, level, kind, name, detail; level 0 are the TFile keys,\n"
+         "  level 1 the RNTuple envelopes and pages within RBlob keys\n",
+         progname);
+}
 
-    RUInt32BE seekparent;
-    read(fd, &seekparent, sizeof(seekparent));
-    printf("SeekParent: %u\n", (std::uint32_t)seekparent);
+int main(int argc, char **argv) {
+  bool summaryOnly = false;
+  std::string mapPath;
+  int c;
+  while ((c = getopt(argc, argv, "hvso:")) != -1) {
+    switch (c) {
+    case 'h':
+    case 'v':
+      Usage(argv[0]);
+      return 0;
+    case 's':
+      summaryOnly = true;
+      break;
+    case 'o':
+      mapPath = optarg;
+      break;
+    default:
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+  if (optind != argc - 1) {
+    Usage(argv[0]);
+    return 1;
+  }
+  std::string path = argv[optind];
 
-    RUInt32BE seekkeys;
-    read(fd, &seekkeys, sizeof(seekkeys));
-    printf("SeekKeys: %u\n", (std::uint32_t)seekkeys);
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Cannot open %s\n", path.c_str());
+    return 1;
+  }
+  struct stat info;
+  fstat(fd, &info);
+  const std::uint64_t size = info.st_size;
+  if (size == 0) {
+    fprintf(stderr, "%s is empty\n", path.c_str());
+    return 1;
+  }
+  auto map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "Cannot map %s\n", path.c_str());
+    return 1;
+  }
+  madvise(map, size, MADV_SEQUENTIAL);
+  const auto file = static_cast<const unsigned char *>(map);
+
+  RTFileHeader hdr;
+  if (!ReadFileHeader(file, size, &hdr)) {
+    fprintf(stderr, "%s is not a ROOT file\n", path.c_str());
+    return 1;
+  }
+  printf("Version: %d  BEGIN: %" PRIu64 "  END: %" PRIu64 "  Compression: %d  SeekKeys: %" PRIu64
+         "  SeekInfo: %" PRIu64 "  SeekFree: %" PRIu64 "\n",
+         hdr.fVersion, hdr.fBEGIN, hdr.fEND, hdr.fCompress, hdr.fSeekKeys, hdr.fSeekInfo, hdr.fSeekFree);
+
+  std::vector<RByteRange> ranges;
+  ranges.push_back(RByteRange{0, hdr.fBEGIN, 0, "file-header", "", ""});
+
+  // Every record between BEGIN and END is a key or, with negative size, a free gap
+  std::vector<RKeyInfo> anchors;
+  std::uint64_t pos = hdr.fBEGIN;
+  const std::uint64_t end = std::min(hdr.fEND, size);
+  while (pos + 4 <= end) {
+    RInt32BE nbytes;
+    memcpy(&nbytes, file + pos, sizeof(nbytes));
+    if (std::int32_t(nbytes) < 0) {
+      ranges.push_back(RByteRange{pos, std::uint64_t(-std::int32_t(nbytes)), 0, "gap", "", ""});
+      pos += -std::int32_t(nbytes);
+      continue;
+    }
+    RKeyInfo key;
+    if ((nbytes == 0) || !ReadKey(file, size, pos, &key)) {
+      fprintf(stderr, "Corrupt key at offset %" PRIu64 ", stopping\n", pos);
+      break;
+    }
+    const auto kind = ClassifyKey(key, hdr);
+    std::string detail = key.fClassName + " cycle=" + std::to_string(key.fCycle) +
+                         " keylen=" + std::to_string(key.fKeyLen) + " objlen=" + std::to_string(key.fObjLen);
+    if (kind == "basket")
+      detail += " tree=" + key.fTitle;
+    ranges.push_back(RByteRange{pos, key.fNbytes, 0, kind, key.fName, detail});
+    if (kind == "ntuple-anchor")
+      anchors.push_back(key);
+    pos += key.fNbytes;
+  }
+
+  for (const auto &key : anchors) {
+    const std::uint32_t payloadSize = key.fNbytes - key.fKeyLen;
+    if (payloadSize != key.fObjLen) {
+      fprintf(stderr, "%s: compressed RNTuple anchor not supported\n", key.fName.c_str());
+      continue;
+    }
+    RNTupleWalker walker(file, size, key.fName, ranges);
+    walker.Walk(file + key.fOffset + key.fKeyLen, payloadSize);
+  }
+
+  std::stable_sort(ranges.begin(), ranges.end(), [](const RByteRange &a, const RByteRange &b) {
+    return (a.fOffset < b.fOffset) || ((a.fOffset == b.fOffset) && (a.fLevel < b.fLevel));
+  });
+
+  if (!summaryOnly) {
+    printf("%12s %10s %5s %-16s %-32s %s\n", "offset", "nbytes", "level", "kind", "name", "detail");
+    for (const auto &r : ranges) {
+      printf("%12" PRIu64 " %10" PRIu64 " %5d %-16s %-32s %s\n", r.fOffset, r.fSize, r.fLevel, r.fKind.c_str(),
+             r.fName.c_str(), r.fDetail.c_str());
+    }
+    printf("\n");
   }
 
-  RUInt16BE uuidversion;
-  read(fd, &uuidversion, sizeof(uuidversion));
-  printf("UUID version: %u\n", (std::uint16_t)uuidversion);
+  std::map<std::string, std::pair<std::uint64_t, std::uint64_t>> perKind;
+  for (const auto &r : ranges) {
+    perKind[r.fKind].first++;
+    perKind[r.fKind].second += r.fSize;
+  }
+  printf("%-16s %10s %14s\n", "kind", "count", "bytes");
+  for (const auto &[kind, stats] : perKind)
+    printf("%-16s %10" PRIu64 " %14" PRIu64 "\n", kind.c_str(), stats.first, stats.second);
+  // Interleaving: a reader of a single branch or column seeks at least once per run of other data
+  for (const char *kind : {"basket", "ntuple-page"}) {
+    auto itr = perKind.find(kind);
+    if (itr == perKind.end())
+      continue;
+    const auto nRuns = CountRuns(ranges, kind);
+    printf("%s: %" PRIu64 " contiguous runs of the same branch/column, %.2f per run\n", kind, nRuns,
+           double(itr->second.first) / nRuns);
+  }
 
-  off_t pos = lseek(fd, 0, SEEK_CUR);
-  printf("Object size: %lu\n", pos + 16 - 100);
+  if (!mapPath.empty()) {
+    FILE *f = fopen(mapPath.c_str(), "w");
+    if (f == NULL) {
+      fprintf(stderr, "Cannot write %s\n", mapPath.c_str());
+      return 1;
+    }
+    fprintf(f, "# offset\tsize\tlevel\tkind\tname\tdetail\n");
+    for (const auto &r : ranges) {
+      fprintf(f, "%" PRIu64 "\t%" PRIu64 "\t%d\t%s\t%s\t%s\n", r.fOffset, r.fSize, r.fLevel, r.fKind.c_str(),
+              r.fName.c_str(), r.fDetail.c_str());
+    }
+    fclose(f);
+  }
 
+  munmap(map, size);
   return 0;
 }
@@ -0,0 +1,314 @@
+/**
+ * Copyright CERN; jblomer@cern.ch
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "io_trace.h"
+
+using namespace std;
+
+/// Reads of this size were issued by the kernel as part of a larger request
+static const uint32_t kLargeReadSize = 128 * 1024;
+
+/// Index of the power-of-two bucket [2^(i-1), 2^i) of a value; 0 for zero
+static unsigned GetLog2Bucket(uint64_t value) {
+  unsigned bucket = 0;
+  while (value) {
+    bucket++;
+    value >>= 1;
+  }
+  return bucket;
+}
+
+static string FormatBytes(uint64_t nbytes) {
+  const char *units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+  unsigned u = 0;
+  while ((nbytes >= 1024) && (u < 4) && (nbytes % 1024 == 0)) {
+    nbytes /= 1024;
+    u++;
+  }
+  return to_string(nbytes) + " " + units[u];
+}
+
+static void PrintHistogram(const vector<uint64_t> &counts, uint64_t total,
+                           const char *label)
+{
+  printf("%-24s %12s %8s\n", label, "count", "share");
+  for (unsigned i = 0; i < counts.size(); ++i) {
+    if (counts[i] == 0)
+      continue;
+    string range = (i == 0) ? "0" :
+      "[" + FormatBytes(uint64_t(1) << (i - 1)) + ", " +
+      FormatBytes(uint64_t(1) << i) + ")";
+    printf("%-24s %12" PRIu64 " %7.1f%%\n", range.c_str(), counts[i],
+           100.0 * counts[i] / total);
+  }
+}
+
+/**
+ * Counts the number of distinct blocks accessed between two accesses to the
+ * same block.  Every block access is a position on the time line; a Fenwick
+ * tree over the positions marks the most recent access of every block.
+ */
+class ReuseDistance {
+ public:
+  explicit ReuseDistance(size_t naccesses) : tree_(naccesses + 1, 0) { }
+
+  /// Returns -1 for the first access to a block
+  int64_t Access(uint64_t block) {
+    int64_t distance = -1;
+    auto itr = last_access_.find(block);
+    if (itr != last_access_.end()) {
+      distance = Sum(now_) - Sum(itr->second + 1);
+      Add(itr->second + 1, -1);
+      itr->second = now_;
+    } else {
+      last_access_[block] = now_;
+    }
+    Add(now_ + 1, 1);
+    now_++;
+    return distance;
+  }
+
+ private:
+  void Add(size_t pos, int64_t delta) {
+    for (; pos < tree_.size(); pos += pos & (~pos + 1))
+      tree_[pos] += delta;
+  }
+
+  /// Sum of the marks at positions [1, pos]
+  int64_t Sum(size_t pos) const {
+    int64_t sum = 0;
+    for (; pos > 0; pos -= pos & (~pos + 1))
+      sum += tree_[pos];
+    return sum;
+  }
+
+  vector<int64_t> tree_;
+  unordered_map<uint64_t, size_t> last_access_;
+  size_t now_ = 0;
+};
+
+
+static void Usage(const char *progname) {
+  printf("%s -i <trace> [-b block size for reuse distance (4096)] "
+         "[-r heat map rows (20)] [-c heat map columns (64)] "
+         "[-m <heat map matrix output>]\n"
+         "  <trace> is a fuse_forward trace or an 'offset size' text log\n",
+         progname);
+}
+
+int main(int argc, char **argv) {
+  string trace_path;
+  string matrix_path;
+  uint64_t block_size = 4096;
+  unsigned nrows = 20;
+  unsigned ncols = 64;
+  int c;
+  while ((c = getopt(argc, argv, "hvi:b:r:c:m:")) != -1) {
+    switch (c) {
+      case 'h':
+      case 'v':
+        Usage(argv[0]);
+        return 0;
+      case 'i':
+        trace_path = optarg;
+        break;
+      case 'b':
+        block_size = max(1, atoi(optarg));
+        break;
+      case 'r':
+        nrows = max(1, atoi(optarg));
+        break;
+      case 'c':
+        ncols = max(1, atoi(optarg));
+        break;
+      case 'm':
+        matrix_path = optarg;
+        break;
+      default:
+        Usage(argv[0]);
+        return 1;
+    }
+  }
+  if (trace_path.empty()) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  vector<IoTraceRecord> all_records;
+  if (!LoadIoTrace(trace_path.c_str(), &all_records)) {
+    fprintf(stderr, "cannot read trace %s\n", trace_path.c_str());
+    return 1;
+  }
+  // Only the reads of the application, not the read-ahead of fuse_forward
+  vector<IoTraceRecord> records;
+  for (const auto &r : all_records) {
+    if ((r.flags & kIoTraceFlagPrefetch) == 0)
+      records.push_back(r);
+  }
+  if (records.empty()) {
+    printf("empty trace\n");
+    return 0;
+  }
+
+  // Totals, the former count-mmap-calls.sh and size-mmap-calls.sh
+  uint64_t nbytes_total = 0;
+  uint64_t ncalls = 0;
+  bool in_large = false;
+  uint64_t file_end = 0;
+  vector<uint64_t> size_histogram;
+  for (const auto &r : records) {
+    nbytes_total += r.size;
+    if (!in_large)
+      ncalls++;
+    in_large = (r.size == kLargeReadSize);
+    file_end = max(file_end, r.offset + r.size);
+    unsigned bucket = GetLog2Bucket(r.size);
+    if (bucket >= size_histogram.size())
+      size_histogram.resize(bucket + 1, 0);
+    size_histogram[bucket]++;
+  }
+
+  // Access direction relative to the end of the previous read
+  uint64_t nsequential = 0;
+  uint64_t nforward = 0;
+  uint64_t nbackward = 0;
+  uint64_t prev_end = 0;
+  for (size_t i = 0; i < records.size(); ++i) {
+    const auto &r = records[i];
+    if (i > 0) {
+      if (r.offset == prev_end)
+        nsequential++;
+      else if (r.offset > prev_end)
+        nforward++;
+      else
+        nbackward++;
+    }
+    prev_end = r.offset + r.size;
+  }
+
+  // Unique bytes as the union of the read intervals
+  vector<pair<uint64_t, uint64_t>> intervals;
+  for (const auto &r : records) {
+    if (r.size > 0)
+      intervals.emplace_back(r.offset, r.offset + r.size);
+  }
+  sort(intervals.begin(), intervals.end());
+  uint64_t nbytes_unique = 0;
+  uint64_t covered_end = 0;
+  for (const auto &iv : intervals) {
+    uint64_t begin = max(iv.first, covered_end);
+    if (iv.second > begin)
+      nbytes_unique += iv.second - begin;
+    covered_end = max(covered_end, iv.second);
+  }
+
+  // Reuse distance in blocks, over all blocks touched by every read
+  size_t naccesses = 0;
+  for (const auto &r : records) {
+    if (r.size > 0)
+      naccesses += (r.offset + r.size - 1) / block_size - r.offset / block_size
+                   + 1;
+  }
+  ReuseDistance reuse(naccesses);
+  uint64_t ncold = 0;
+  vector<uint64_t> reuse_histogram;
+  for (const auto &r : records) {
+    if (r.size == 0)
+      continue;
+    uint64_t last_block = (r.offset + r.size - 1) / block_size;
+    for (uint64_t b = r.offset / block_size; b <= last_block; ++b) {
+      int64_t distance = reuse.Access(b);
+      if (distance < 0) {
+        ncold++;
+        continue;
+      }
+      unsigned bucket = GetLog2Bucket(distance * block_size);
+      if (bucket >= reuse_histogram.size())
+        reuse_histogram.resize(bucket + 1, 0);
+      reuse_histogram[bucket]++;
+    }
+  }
+
+  // Heat map: bytes read per time slice and file region.  Text traces have no
+  // timestamps, so time is the position of the read in the trace.
+  uint64_t t_max = records.back().timestamp_ns;
+  bool has_time = t_max > 0;
+  vector<vector<uint64_t>> heat(nrows, vector<uint64_t>(ncols, 0));
+  uint64_t heat_max = 0;
+  for (size_t i = 0; i < records.size(); ++i) {
+    const auto &r = records[i];
+    double t = has_time ? double(r.timestamp_ns) / (t_max + 1) :
+                          double(i) / records.size();
+    unsigned row = min<unsigned>(nrows - 1, t * nrows);
+    unsigned col = min<unsigned>(ncols - 1,
+                                 double(r.offset) / file_end * ncols);
+    heat[row][col] += r.size;
+    heat_max = max(heat_max, heat[row][col]);
+  }
+
+  printf("reads:                  %zu\n", records.size());
+  printf("calls (128 KiB merged): %" PRIu64 "\n", ncalls);
+  printf("bytes read:             %.2f MB (%.1f KiB)\n", nbytes_total / 1e6,
+         nbytes_total / 1024.0);
+  printf("unique bytes:           %.2f MB\n", nbytes_unique / 1e6);
+  printf("read amplification:     %.3f\n",
+         nbytes_unique ? double(nbytes_total) / nbytes_unique : 0.0);
+  printf("highest offset read:    %.2f MB\n", file_end / 1e6);
+  if (records.size() > 1) {
+    double ntransitions = records.size() - 1;
+    printf("sequential:             %.1f%%\n", 100 * nsequential / ntransitions);
+    printf("forward skip:           %.1f%%\n", 100 * nforward / ntransitions);
+    printf("backward:               %.1f%%\n", 100 * nbackward / ntransitions);
+  }
+  printf("\n");
+  PrintHistogram(size_histogram, records.size(), "request size");
+  printf("\n");
+  printf("reuse distance (%s blocks): %" PRIu64 " cold accesses out of %zu\n",
+         FormatBytes(block_size).c_str(), ncold, naccesses);
+  if (!reuse_histogram.empty())
+    PrintHistogram(reuse_histogram, naccesses - ncold, "distance");
+  printf("\n");
+
+  const char *shades = " .:-=+*#%@";
+  printf("heat map (rows: %s, columns: file offset 0 - %.1f MB)\n",
+         has_time ? "time" : "read sequence", file_end / 1e6);
+  for (unsigned row = 0; row < nrows; ++row) {
+    string line;
+    for (unsigned col = 0; col < ncols; ++col) {
+      uint64_t v = heat[row][col];
+      unsigned shade = (v == 0) ? 0 : 1 + (8 * v) / heat_max;
+      line += shades[min(shade, 9u)];
+    }
+    printf("|%s|\n", line.c_str());
+  }
+
+  if (!matrix_path.empty()) {
+    FILE *f = fopen(matrix_path.c_str(), "w");
+    if (f == NULL) {
+      fprintf(stderr, "cannot write %s\n", matrix_path.c_str());
+      return 1;
+    }
+    for (const auto &row : heat) {
+      for (unsigned col = 0; col < ncols; ++col)
+        fprintf(f, "%s%" PRIu64, (col > 0) ? " " : "", row[col]);
+      fprintf(f, "\n");
+    }
+    fclose(f);
+  }
+
+  return 0;
+}
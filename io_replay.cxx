@@ -0,0 +1,466 @@
+/**
+ * Copyright CERN; jblomer@cern.ch
+ */
+
+#define _FILE_OFFSET_BITS 64
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "io_trace.h"
+
+using namespace std;
+
+/// A read to replay
+struct Request {
+  uint64_t offset;
+  uint32_t size;
+};
+
+static const size_t kDirectAlignment = 4096;
+
+static uint64_t GetTimestampNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static void Die(const char *msg) {
+  fprintf(stderr, "%s (%s)\n", msg, strerror(errno));
+  exit(1);
+}
+
+static bool ReadRequests(const char *path, vector<Request> *requests) {
+  vector<IoTraceRecord> records;
+  if (!LoadIoTrace(path, &records))
+    return false;
+  for (const auto &r : records) {
+    // Read-ahead of fuse_forward itself is not part of the access pattern
+    if ((r.flags & kIoTraceFlagPrefetch) == 0)
+      requests->push_back({r.offset, r.size});
+  }
+  return true;
+}
+
+/// With O_DIRECT, reads are widened to the alignment of the block device
+static Request Align(const Request &r, bool is_direct) {
+  if (!is_direct)
+    return r;
+  uint64_t begin = r.offset & ~(kDirectAlignment - 1);
+  uint64_t end = (r.offset + r.size + kDirectAlignment - 1) &
+                 ~(kDirectAlignment - 1);
+  return {begin, static_cast<uint32_t>(end - begin)};
+}
+
+static char *AllocBuffer(size_t size) {
+  void *buf;
+  if (posix_memalign(&buf, kDirectAlignment,
+                     max(size, kDirectAlignment)) != 0)
+  {
+    Die("cannot allocate buffer");
+  }
+  return static_cast<char *>(buf);
+}
+
+/// Latency in nanoseconds of every issued I/O operation plus transferred bytes
+struct ReplayResult {
+  vector<uint64_t> latencies;
+  uint64_t nbytes = 0;
+};
+
+
+static void ReplayPread(int fd, const vector<Request> &requests,
+                        bool is_direct, ReplayResult *result)
+{
+  uint32_t max_size = 0;
+  for (const auto &r : requests)
+    max_size = max(max_size, Align(r, is_direct).size);
+  char *buf = AllocBuffer(max_size);
+  for (const auto &req : requests) {
+    Request r = Align(req, is_direct);
+    uint64_t t_start = GetTimestampNs();
+    ssize_t nbytes = pread(fd, buf, r.size, r.offset);
+    if (nbytes < 0)
+      Die("pread failed");
+    result->latencies.push_back(GetTimestampNs() - t_start);
+    result->nbytes += nbytes;
+  }
+  free(buf);
+}
+
+
+/**
+ * Contiguous requests (each starting where the previous one ended) are issued
+ * as a single preadv() of up to batch_size buffers.
+ */
+static void ReplayPreadv(int fd, const vector<Request> &requests,
+                         bool is_direct, unsigned batch_size,
+                         ReplayResult *result)
+{
+  uint32_t max_size = 0;
+  for (const auto &r : requests)
+    max_size = max(max_size, Align(r, is_direct).size);
+  vector<char *> buffers;
+  for (unsigned i = 0; i < batch_size; ++i)
+    buffers.push_back(AllocBuffer(max_size));
+
+  vector<struct iovec> iov;
+  size_t i = 0;
+  while (i < requests.size()) {
+    Request first = Align(requests[i], is_direct);
+    uint64_t end = first.offset;
+    iov.clear();
+    for (; (i < requests.size()) && (iov.size() < batch_size); ++i) {
+      Request r = Align(requests[i], is_direct);
+      if (r.offset != end)
+        break;
+      iov.push_back({buffers[iov.size()], r.size});
+      end += r.size;
+    }
+    uint64_t t_start = GetTimestampNs();
+    ssize_t nbytes = preadv(fd, iov.data(), iov.size(), first.offset);
+    if (nbytes < 0)
+      Die("preadv failed");
+    result->latencies.push_back(GetTimestampNs() - t_start);
+    result->nbytes += nbytes;
+  }
+  for (auto b : buffers)
+    free(b);
+}
+
+
+/// Requests are handed out in trace order to the next idle thread
+static void ReplayThreads(int fd, const vector<Request> &requests,
+                          bool is_direct, unsigned nthreads,
+                          ReplayResult *result)
+{
+  atomic<size_t> next{0};
+  vector<ReplayResult> thread_results(nthreads);
+  vector<thread> threads;
+  for (unsigned t = 0; t < nthreads; ++t) {
+    threads.emplace_back([&, t]() {
+      ReplayResult &my_result = thread_results[t];
+      char *buf = NULL;
+      uint32_t buf_size = 0;
+      size_t i;
+      while ((i = next.fetch_add(1)) < requests.size()) {
+        Request r = Align(requests[i], is_direct);
+        if (r.size > buf_size) {
+          free(buf);
+          buf = AllocBuffer(r.size);
+          buf_size = r.size;
+        }
+        uint64_t t_start = GetTimestampNs();
+        ssize_t nbytes = pread(fd, buf, r.size, r.offset);
+        if (nbytes < 0)
+          Die("pread failed");
+        my_result.latencies.push_back(GetTimestampNs() - t_start);
+        my_result.nbytes += nbytes;
+      }
+      free(buf);
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+  for (const auto &r : thread_results) {
+    result->latencies.insert(result->latencies.end(), r.latencies.begin(),
+                             r.latencies.end());
+    result->nbytes += r.nbytes;
+  }
+}
+
+
+/**
+ * Minimal io_uring through the raw system calls, like check-uring, so that
+ * liburing is not required.
+ */
+class Uring {
+ public:
+  explicit Uring(unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    fd_ = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd_ < 0)
+      Die("io_uring_setup failed");
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes +
+                    params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+      sq_ring_size_ = cq_ring_size_ = max(sq_ring_size_, cq_ring_size_);
+    sq_ring_ = Map(sq_ring_size_, IORING_OFF_SQ_RING);
+    cq_ring_ = (params.features & IORING_FEAT_SINGLE_MMAP) ?
+               sq_ring_ : Map(cq_ring_size_, IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = static_cast<struct io_uring_sqe *>(
+      Map(sqes_size_, IORING_OFF_SQES));
+
+    char *sq = static_cast<char *>(sq_ring_);
+    sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    char *cq = static_cast<char *>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+  }
+
+  ~Uring() {
+    munmap(sqes_, sqes_size_);
+    if (cq_ring_ != sq_ring_)
+      munmap(cq_ring_, cq_ring_size_);
+    munmap(sq_ring_, sq_ring_size_);
+    close(fd_);
+  }
+
+  /// Queues a readv of a single buffer; the caller keeps iov alive
+  void PrepareRead(int fd, struct iovec *iov, uint64_t offset,
+                   uint64_t user_data)
+  {
+    unsigned tail = *sq_tail_;
+    unsigned index = tail & sq_mask_;
+    struct io_uring_sqe *sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(iov);
+    sqe->len = 1;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    npending_++;
+  }
+
+  /// Submits the queued reads and waits for at least min_complete completions
+  void Submit(unsigned min_complete) {
+    int retval = syscall(__NR_io_uring_enter, fd_, npending_, min_complete,
+                         IORING_ENTER_GETEVENTS, NULL, 0);
+    if (retval < 0)
+      Die("io_uring_enter failed");
+    npending_ -= retval;
+  }
+
+  /// Returns false if there is no completion available
+  bool PopCompletion(struct io_uring_cqe *cqe) {
+    unsigned head = *cq_head_;
+    if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+      return false;
+    *cqe = cqes_[head & cq_mask_];
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+ private:
+  void *Map(size_t size, off_t offset) {
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd_, offset);
+    if (ptr == MAP_FAILED)
+      Die("cannot map io_uring");
+    return ptr;
+  }
+
+  int fd_;
+  unsigned npending_ = 0;
+  size_t sq_ring_size_;
+  size_t cq_ring_size_;
+  size_t sqes_size_;
+  void *sq_ring_;
+  void *cq_ring_;
+  struct io_uring_sqe *sqes_;
+  unsigned *sq_tail_;
+  unsigned sq_mask_;
+  unsigned *sq_array_;
+  unsigned *cq_head_;
+  unsigned *cq_tail_;
+  unsigned cq_mask_;
+  struct io_uring_cqe *cqes_;
+};
+
+
+/// Keeps up to queue_depth reads in flight, refilling as reads complete
+static void ReplayUring(int fd, const vector<Request> &requests,
+                        bool is_direct, unsigned queue_depth,
+                        ReplayResult *result)
+{
+  uint32_t max_size = 0;
+  for (const auto &r : requests)
+    max_size = max(max_size, Align(r, is_direct).size);
+  Uring ring(queue_depth);
+  vector<struct iovec> iovs(queue_depth);
+  vector<uint64_t> t_submit(queue_depth);
+  vector<unsigned> free_slots;
+  for (unsigned i = 0; i < queue_depth; ++i) {
+    iovs[i].iov_base = AllocBuffer(max_size);
+    free_slots.push_back(i);
+  }
+
+  size_t next = 0;
+  size_t ncompleted = 0;
+  vector<unsigned> queued;
+  while (ncompleted < requests.size()) {
+    queued.clear();
+    while (!free_slots.empty() && (next < requests.size())) {
+      unsigned slot = free_slots.back();
+      free_slots.pop_back();
+      Request r = Align(requests[next++], is_direct);
+      iovs[slot].iov_len = r.size;
+      ring.PrepareRead(fd, &iovs[slot], r.offset, slot);
+      queued.push_back(slot);
+    }
+    uint64_t now = GetTimestampNs();
+    for (auto slot : queued)
+      t_submit[slot] = now;
+    ring.Submit(1);
+
+    struct io_uring_cqe cqe;
+    while (ring.PopCompletion(&cqe)) {
+      if (cqe.res < 0) {
+        errno = -cqe.res;
+        Die("io_uring read failed");
+      }
+      unsigned slot = cqe.user_data;
+      result->latencies.push_back(GetTimestampNs() - t_submit[slot]);
+      result->nbytes += cqe.res;
+      free_slots.push_back(slot);
+      ncompleted++;
+    }
+  }
+  for (auto &iov : iovs)
+    free(iov.iov_base);
+}
+
+
+static void Usage(const char *progname) {
+  printf("%s -i <trace> -f <data file> [-b pread|preadv|threads|uring] "
+         "[-j threads (4)] [-q queue depth (32)] [-B preadv batch (16)] "
+         "[-D (O_DIRECT)] [-C (evict data file from page cache)]\n"
+         "  <trace> is a fuse_forward trace or an 'offset size' text log\n",
+         progname);
+}
+
+int main(int argc, char **argv) {
+  string trace_path;
+  string data_path;
+  string backend = "pread";
+  unsigned nthreads = 4;
+  unsigned queue_depth = 32;
+  unsigned batch_size = 16;
+  bool is_direct = false;
+  bool evict = false;
+  int c;
+  while ((c = getopt(argc, argv, "hvi:f:b:j:q:B:DC")) != -1) {
+    switch (c) {
+      case 'h':
+      case 'v':
+        Usage(argv[0]);
+        return 0;
+      case 'i':
+        trace_path = optarg;
+        break;
+      case 'f':
+        data_path = optarg;
+        break;
+      case 'b':
+        backend = optarg;
+        break;
+      case 'j':
+        nthreads = max(1, atoi(optarg));
+        break;
+      case 'q':
+        queue_depth = max(1, atoi(optarg));
+        break;
+      case 'B':
+        batch_size = max(1, min(IOV_MAX, atoi(optarg)));
+        break;
+      case 'D':
+        is_direct = true;
+        break;
+      case 'C':
+        evict = true;
+        break;
+      default:
+        Usage(argv[0]);
+        return 1;
+    }
+  }
+  if (trace_path.empty() || data_path.empty()) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  vector<Request> requests;
+  if (!ReadRequests(trace_path.c_str(), &requests)) {
+    fprintf(stderr, "cannot read trace %s\n", trace_path.c_str());
+    return 1;
+  }
+  uint64_t nbytes_requested = 0;
+  for (const auto &r : requests)
+    nbytes_requested += r.size;
+
+  int fd = open(data_path.c_str(), O_RDONLY | (is_direct ? O_DIRECT : 0));
+  if (fd < 0)
+    Die("cannot open data file");
+  if (evict)
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+  ReplayResult result;
+  uint64_t t_start = GetTimestampNs();
+  if (backend == "pread") {
+    ReplayPread(fd, requests, is_direct, &result);
+  } else if (backend == "preadv") {
+    ReplayPreadv(fd, requests, is_direct, batch_size, &result);
+  } else if (backend == "threads") {
+    ReplayThreads(fd, requests, is_direct, nthreads, &result);
+  } else if (backend == "uring") {
+    ReplayUring(fd, requests, is_direct, queue_depth, &result);
+  } else {
+    fprintf(stderr, "unknown back-end: %s\n", backend.c_str());
+    return 1;
+  }
+  uint64_t runtime_ns = GetTimestampNs() - t_start;
+  close(fd);
+
+  vector<uint64_t> &lat = result.latencies;
+  sort(lat.begin(), lat.end());
+  uint64_t lat_sum = 0;
+  for (auto l : lat)
+    lat_sum += l;
+  auto percentile = [&lat](double p) -> double {
+    if (lat.empty())
+      return 0.0;
+    return lat[min(lat.size() - 1, static_cast<size_t>(p * lat.size()))] /
+           1e3;
+  };
+
+  double seconds = runtime_ns / 1e9;
+  printf("Replayed %zu reads (%.2f MB requested) in %zu I/O operations "
+         "with %s%s\n", requests.size(), nbytes_requested / 1e6, lat.size(),
+         backend.c_str(), is_direct ? " + O_DIRECT" : "");
+  printf("Latency [us]: mean %.1f, median %.1f, p99 %.1f, max %.1f\n",
+         lat.empty() ? 0.0 : lat_sum / 1e3 / lat.size(), percentile(0.5),
+         percentile(0.99), lat.empty() ? 0.0 : lat.back() / 1e3);
+  printf("Bandwidth: %.2f MB/s requested, %.2f MB/s transferred\n",
+         nbytes_requested / 1e6 / seconds, result.nbytes / 1e6 / seconds);
+  printf("Runtime-Main: %" PRIu64 "us\n", runtime_ns / 1000);
+  return 0;
+}
@@ -0,0 +1,104 @@
+/**
+ * Copyright CERN; jblomer@cern.ch
+ */
+
+#ifndef IO_TRACE_H_
+#define IO_TRACE_H_
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+/// The record is a read-ahead issued by fuse_forward itself
+static const uint32_t kIoTraceFlagPrefetch = 0x01;
+/// The data was spliced from the physical file after the handler returned;
+/// the latency does not include the transfer
+static const uint32_t kIoTraceFlagSplice = 0x02;
+
+/**
+ * One read as seen by fuse_forward.  A trace file is a plain sequence of
+ * these records in native byte order, one file per traced file; records of
+ * different threads are written in batches, so they are not sorted by
+ * timestamp.  Reads served by the block cache only touch storage for the
+ * missing blocks; latency and delay cover only those storage reads.
+ */
+struct IoTraceRecord {
+  uint64_t timestamp_ns;  ///< start of the read, relative to the mount
+  uint64_t latency_ns;    ///< duration of the underlying pread
+  uint64_t delay_ns;      ///< added by the storage emulation after the pread
+  uint64_t offset;
+  uint32_t size;          ///< bytes returned
+  uint32_t size_req;      ///< bytes requested by the kernel
+  uint32_t size_hit;      ///< bytes served from the block cache
+  uint32_t flags;         ///< kIoTraceFlag...
+  uint32_t thread;        ///< kernel thread id of the FUSE worker
+  int32_t fd;             ///< file descriptor of the traced file
+};
+
+static_assert(sizeof(IoTraceRecord) == 56, "unexpected trace record padding");
+
+/**
+ * Reads all records of a trace file sorted by timestamp; returns false if the
+ * file cannot be opened or has a trailing partial record.
+ */
+static inline bool ReadIoTrace(const char *path,
+                               std::vector<IoTraceRecord> *records)
+{
+  FILE *f = fopen(path, "rb");
+  if (f == NULL)
+    return false;
+  IoTraceRecord buf[4096];
+  size_t nitems;
+  while ((nitems = fread(buf, sizeof(IoTraceRecord), 4096, f)) > 0)
+    records->insert(records->end(), buf, buf + nitems);
+  bool is_complete = (ftell(f) % sizeof(IoTraceRecord)) == 0;
+  fclose(f);
+  std::stable_sort(records->begin(), records->end(),
+    [](const IoTraceRecord &a, const IoTraceRecord &b) {
+      return a.timestamp_ns < b.timestamp_ns;
+    });
+  return is_complete;
+}
+
+/// Text traces consist of "offset size" lines as written by bm_iopattern.sh
+static inline bool IsTextIoTrace(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL)
+    return false;
+  char buf[4096];
+  size_t nbytes = fread(buf, 1, sizeof(buf), f);
+  fclose(f);
+  for (size_t i = 0; i < nbytes; ++i) {
+    if (!isdigit(buf[i]) && (buf[i] != ' ') && (buf[i] != '\n'))
+      return false;
+  }
+  return true;
+}
+
+/**
+ * Reads a binary or a text trace.  Records from text traces only have offset
+ * and size set; they keep the order of the file.
+ */
+static inline bool LoadIoTrace(const char *path,
+                               std::vector<IoTraceRecord> *records)
+{
+  if (!IsTextIoTrace(path))
+    return ReadIoTrace(path, records);
+
+  FILE *f = fopen(path, "r");
+  if (f == NULL)
+    return false;
+  IoTraceRecord record;
+  memset(&record, 0, sizeof(record));
+  while (fscanf(f, "%" SCNu64 " %" SCNu32, &record.offset, &record.size) == 2)
+    records->push_back(record);
+  fclose(f);
+  return true;
+}
+
+#endif  // IO_TRACE_H_
@@ -0,0 +1,107 @@
+/**
+ * Copyright CERN; jblomer@cern.ch
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <vector>
+
+#include "io_trace.h"
+
+using namespace std;
+
+static void Usage(const char *progname) {
+  printf("%s [-l | -s] <trace file>\n"
+         "  Prints 'offset size' per read; -l prints all fields including\n"
+         "  read-ahead records, -s prints cache hit rate and bandwidth\n",
+         progname);
+}
+
+static void PrintSummary(const vector<IoTraceRecord> &records) {
+  uint64_t nreads = 0;
+  uint64_t nbytes = 0;
+  uint64_t nbytes_hit = 0;
+  uint64_t nprefetch = 0;
+  uint64_t nbytes_prefetch = 0;
+  uint64_t t_end = 0;
+  for (const auto &r : records) {
+    t_end = max(t_end, r.timestamp_ns + r.latency_ns + r.delay_ns);
+    if (r.flags & kIoTraceFlagPrefetch) {
+      nprefetch++;
+      nbytes_prefetch += r.size;
+      continue;
+    }
+    nreads++;
+    nbytes += r.size;
+    nbytes_hit += r.size_hit;
+  }
+  // Records are sorted by timestamp
+  uint64_t t_begin = records.empty() ? 0 : records[0].timestamp_ns;
+  double seconds = (t_end - t_begin) / 1e9;
+
+  printf("reads:            %" PRIu64 "\n", nreads);
+  printf("bytes read:       %.2f MB\n", nbytes / 1e6);
+  printf("cache hit rate:   %.1f%%\n",
+         nbytes ? 100.0 * nbytes_hit / nbytes : 0.0);
+  printf("read-ahead:       %" PRIu64 " requests, %.2f MB\n",
+         nprefetch, nbytes_prefetch / 1e6);
+  printf("bandwidth:        %.2f MB/s over %.3f s\n",
+         seconds > 0 ? nbytes / 1e6 / seconds : 0.0, seconds);
+}
+
+int main(int argc, char **argv) {
+  bool long_format = false;
+  bool summary = false;
+  int c;
+  while ((c = getopt(argc, argv, "hvls")) != -1) {
+    switch (c) {
+      case 'h':
+      case 'v':
+        Usage(argv[0]);
+        return 0;
+      case 'l':
+        long_format = true;
+        break;
+      case 's':
+        summary = true;
+        break;
+      default:
+        Usage(argv[0]);
+        return 1;
+    }
+  }
+  if (optind != argc - 1) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  vector<IoTraceRecord> records;
+  if (!ReadIoTrace(argv[optind], &records)) {
+    fprintf(stderr, "cannot read trace file %s\n", argv[optind]);
+    return 1;
+  }
+
+  if (summary) {
+    PrintSummary(records);
+    return 0;
+  }
+
+  if (long_format) {
+    printf("# timestamp_ns latency_ns delay_ns thread fd offset size size_req "
+           "size_hit flags\n");
+  }
+  for (const auto &r : records) {
+    if (long_format) {
+      printf("%" PRIu64 " %" PRIu64 " %" PRIu64 " %u %d %" PRIu64
+             " %u %u %u %u\n",
+             r.timestamp_ns, r.latency_ns, r.delay_ns, r.thread, r.fd,
+             r.offset, r.size, r.size_req, r.size_hit, r.flags);
+    } else if ((r.flags & kIoTraceFlagPrefetch) == 0) {
+      printf("%" PRIu64 " %u\n", r.offset, r.size);
+    }
+  }
+  return 0;
+}
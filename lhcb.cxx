@@ -34,10 +34,12 @@
 #include <TTreeReader.h>
 #include <TTreePerfStats.h>
 
+#include "spill_file.h"
 #include "util.h"
 
 bool g_perf_stats = false;
 bool g_show = false;
+bool g_stream = false;
 int g_cluster_bunch_size = 1;
 
 static ROOT::Experimental::RNTupleReadOptions GetRNTupleOptions() {
@@ -136,7 +138,7 @@ static void Dataframe(ROOT::RDataFrame &frame)
 static void TreeDirect(const std::string &path) {
    auto ts_init = std::chrono::steady_clock::now();
 
-   auto file = OpenOrDownload(path);
+   auto file = g_stream ? OpenOrStream(path) : OpenOrDownload(path);
    auto tree = file->Get<TTree>("DecayTree");
    TTreePerfStats *ps = nullptr;
    if (g_perf_stats)
@@ -281,13 +283,15 @@ static void NTupleDirect(const std::string &path)
    using RNTupleModel = ROOT::Experimental::RNTupleModel;
 
    // Trigger download if needed.
-   delete OpenOrDownload(path);
+   if (!g_stream)
+      delete OpenOrDownload(path);
 
    auto ts_init = std::chrono::steady_clock::now();
 
    auto model = RNTupleModel::Create();
    auto options = GetRNTupleOptions();
-   auto ntuple = RNTupleReader::Open(std::move(model), "DecayTree", path, options);
+   auto ntuple = g_stream ? OpenNTupleOrStream(std::move(model), "DecayTree", path, options)
+                          : RNTupleReader::Open(std::move(model), "DecayTree", path, options);
    if (g_perf_stats)
       ntuple->EnableMetrics();
 
@@ -366,7 +370,8 @@ static void NTupleDirect(const std::string &path)
 
 
 static void Usage(const char *progname) {
-  printf("%s [-i input.root] [-r(df)] [-m(t)] [-p(erformance stats)] [-s(show)] [-x cluster bunch size]\n", progname);
+  printf("%s [-i input.root] [-r(df)] [-m(t)] [-p(erformance stats)] [-s(show)] [-x cluster bunch size]\n"
+         "   [-w (process while downloading)]\n", progname);
 }
 
 
@@ -377,7 +382,7 @@ int main(int argc, char **argv) {
    std::string input_suffix;
    bool use_rdf = false;
    int c;
-   while ((c = getopt(argc, argv, "hvi:rpsmx:")) != -1) {
+   while ((c = getopt(argc, argv, "hvi:rpsmx:w")) != -1) {
       switch (c) {
       case 'h':
       case 'v':
@@ -401,6 +406,9 @@ int main(int argc, char **argv) {
       case 'x':
          g_cluster_bunch_size = atoi(optarg);
          break;
+      case 'w':
+         g_stream = true;
+         break;
       default:
          fprintf(stderr, "Unknown option: -%c\n", c);
          Usage(argv[0]);
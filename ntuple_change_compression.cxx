@@ -5,39 +5,262 @@
   Accepts one or more ROOT input files containing one or more RNTuples and outputs one file with
   all the RNTuples merged with possibly changed compression algorithm and level.
 
+  The compression can be set per column: rules of the form <selector>=<compression> are matched in
+  the given order against every column, the first match wins and unmatched columns use the default
+  compression.  The selector is either a glob pattern of the qualified field name (e.g. 'H1_*') or
+  'type:<column type>' (e.g. 'type:SplitReal64').  The compression is a number (e.g. 505) or an
+  algorithm with an optional level (e.g. lz4, zstd-19).
+
+  By default, the inputs are copied cluster by cluster: pages whose compression is unchanged are
+  copied as sealed byte ranges without decompression, the other pages are recompressed by a pool of
+  threads that takes pages off a shared queue.  The next cluster is read while the current one is
+  processed and written.  With -M, RNTupleMerger is used instead (no rules).
+
+  The output sink labels the column ranges of all clusters with a single compression: the default
+  compression or, if it is preserved (-1), the compression of the first input.  Columns without a rule
+  are recompressed where they differ from it.  Columns with a rule are labelled with it as well, although
+  their pages use the rule's compression; the pages are self-describing, so reading is not affected.
+
+  Usage: ntuple_change_compression [-c <default compression>] [-r <selector>=<compression> ...] [-j <threads>]
+             [-M] -o <ntuple_file_out> -n <ntuple_name> <ntuple_file1.root> [ntuple_file2.root ...]
+
+  The former positional form
+         ntuple_change_compression <compression_settings> <ntuple_file_out> <ntuple_name> <ntuple_file1.root> ...
+  is still accepted and equivalent to -M -c <compression_settings> -o <ntuple_file_out> -n <ntuple_name>.
+
   @author Giacomo Parolini, 2024
 */
+#include <ROOT/RColumnElement.hxx>
 #include <ROOT/RLogger.hxx>
 #include <ROOT/RNTupleReader.hxx>
 #include <ROOT/RNTupleMerger.hxx>
+#include <ROOT/RNTupleZip.hxx>
 #include <ROOT/RPageStorageFile.hxx>
 #include <TFile.h>
 #include <TROOT.h>
 #include <ROOT/RNTupleWriteOptions.hxx>
+
+#include <fnmatch.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace ROOT::Experimental;
 using namespace ROOT::Experimental::Internal;
 using namespace std::chrono;
 
+namespace {
+
+struct CompressionRule {
+  std::string fSelector;
+  int fCompression;
+  // Statistics over all pages that matched the rule
+  std::atomic<std::uint64_t> fBytesIn{0};
+  std::atomic<std::uint64_t> fBytesOut{0};
+
+  CompressionRule(const std::string &selector, int compression) : fSelector(selector), fCompression(compression) {}
+};
+
+/// A column to be copied: its id in the input and the output, and the rule that applies to it
+struct ColumnInfo {
+  std::string fName;
+  DescriptorId_t fInputId;
+  DescriptorId_t fOutputId;
+  std::unique_ptr<RColumnElementBase> fElement;
+  /// Index into the rules, rules.size() for the default compression
+  std::size_t fRuleIdx;
+};
+
+/// A page of the current cluster; fSealed points into the loaded cluster or into fBuffer after recompression
+struct PageTask {
+  const ColumnInfo *fColumn;
+  RPageStorage::RSealedPage *fSealed;
+  std::unique_ptr<unsigned char[]> fBuffer;
+  /// Target compression of the page
+  int fCompression;
+};
+
+/// Parses 505, zstd, zstd-19, ...; returns -2 on error
+int ParseCompression(const std::string &spec) {
+  if (!spec.empty() && (isdigit(spec[0]) || spec[0] == '-'))
+    return std::atoi(spec.c_str());
+
+  auto posDash = spec.find('-');
+  auto algorithm = spec.substr(0, posDash);
+  int level = (posDash == std::string::npos) ? -1 : std::atoi(spec.c_str() + posDash + 1);
+  if (algorithm == "none")
+    return 0;
+  if (algorithm == "zlib")
+    return 100 + ((level < 0) ? 1 : level);
+  if (algorithm == "lzma")
+    return 200 + ((level < 0) ? 7 : level);
+  if (algorithm == "lz4")
+    return 400 + ((level < 0) ? 4 : level);
+  if (algorithm == "zstd")
+    return 500 + ((level < 0) ? 5 : level);
+  return -2;
+}
+
+bool Matches(const CompressionRule &rule, const std::string &fieldName, EColumnType type) {
+  if (rule.fSelector.compare(0, 5, "type:") == 0)
+    return rule.fSelector.substr(5) == RColumnElementBase::GetTypeName(type);
+  return fnmatch(rule.fSelector.c_str(), fieldName.c_str(), 0) == 0;
+}
+
+/// Collects the physical columns in the order in which the page sink creates them for the model
+/// of the descriptor, i.e. depth-first over the fields
+void CollectColumns(const RNTupleDescriptor &desc, DescriptorId_t fieldId, std::vector<ColumnInfo> &columns,
+                    const std::vector<std::unique_ptr<CompressionRule>> &rules) {
+  const auto fieldName = desc.GetQualifiedFieldName(fieldId);
+  for (const auto &columnDesc : desc.GetColumnIterable(fieldId)) {
+    if (columnDesc.IsAliasColumn())
+      continue;
+    ColumnInfo column;
+    const auto type = columnDesc.GetModel().GetType();
+    column.fName = fieldName + "." + std::to_string(columnDesc.GetIndex());
+    column.fInputId = columnDesc.GetPhysicalId();
+    column.fOutputId = columns.size();
+    column.fElement = RColumnElementBase::Generate(type);
+    column.fRuleIdx = rules.size();
+    for (std::size_t i = 0; i < rules.size(); ++i) {
+      if (Matches(*rules[i], fieldName, type)) {
+        column.fRuleIdx = i;
+        break;
+      }
+    }
+    columns.emplace_back(std::move(column));
+  }
+  for (const auto &fieldDesc : desc.GetFieldIterable(fieldId))
+    CollectColumns(desc, fieldDesc.GetId(), columns, rules);
+}
+
+/// The former command line: a numeric compression setting followed by output file, RNTuple name, and inputs
+bool IsPositionalCommandLine(int argc, char **argv) {
+  if (argc < 5)
+    return false;
+  char *end;
+  std::strtol(argv[1], &end, 10);
+  return *argv[1] != '\0' && *end == '\0';
+}
+
+bool NeedsRecompression(int srcCompression, int dstCompression) {
+  return dstCompression != -1 && dstCompression != srcCompression;
+}
+
+/// Recompresses the page to the target compression
+void ProcessPage(PageTask &task) {
+  auto &sealed = *task.fSealed;
+
+  const auto nElements = sealed.GetNElements();
+  const auto packedSize = task.fColumn->fElement->GetPackedSize(nElements);
+  auto unzipped = std::make_unique<unsigned char[]>(packedSize);
+  RNTupleDecompressor::Unzip(sealed.GetBuffer(), sealed.GetDataSize(), packedSize, unzipped.get());
+
+  const std::size_t checksumSize = sealed.GetHasChecksum() ? sizeof(std::uint64_t) : 0;
+  task.fBuffer = std::make_unique<unsigned char[]>(packedSize + checksumSize);
+  const auto zippedSize = RNTupleCompressor::Zip(unzipped.get(), packedSize, task.fCompression, task.fBuffer.get());
+  sealed = RPageStorage::RSealedPage(task.fBuffer.get(), zippedSize + checksumSize, nElements,
+                                     sealed.GetHasChecksum());
+  sealed.ChecksumIfEnabled();
+}
+
+void Usage(const char *progname) {
+  fprintf(stderr,
+          "Usage: %s [-c <default compression (-1)>] [-r <selector>=<compression> ...] [-j <threads>] [-M(erger)]\n"
+          "          -o <ntuple_file_out> -n <ntuple_name> <ntuple_file1.root> [ntuple_file2.root ...]\n",
+          progname);
+  fprintf(stderr, "Common compression settings:\n\t-1: preserve;\n\t0: uncompressed\n\t505: Zstd\n\t207: LZMA\n");
+  fprintf(stderr, "Rule examples: -r 'H1_*=lz4' -r 'type:SplitReal64=zstd-19'\n");
+  fprintf(stderr, "Deprecated: %s <compression_settings> <ntuple_file_out> <ntuple_name> <ntuple_file1.root> ...\n",
+          progname);
+}
+
+} // anonymous namespace
+
 int main(int argc, char **argv) {
-  if (argc < 5) {
-    fprintf(stderr, "Usage: %s <compression_settings> <ntuple_file_out> <ntuple_name> <ntuple_file1.root> [ntuple_file2.root ...]\n", argv[0]);
-    fprintf(stderr, "Common compression settings:\n\t-1: preserve;\n\t0: uncompressed\n\t505: Zstd\n\t207: LZMA\n");
-    return 1;
+  int compSettings = -1;
+  std::string ntuple_file_out;
+  std::string ntuple_name;
+  std::vector<std::unique_ptr<CompressionRule>> rules;
+  unsigned nThreads = std::max(1u, std::thread::hardware_concurrency());
+  bool useMerger = false;
+
+  const bool isPositional = IsPositionalCommandLine(argc, argv);
+  if (isPositional) {
+    compSettings = std::atoi(argv[1]);
+    ntuple_file_out = argv[2];
+    ntuple_name = argv[3];
+    useMerger = true;
+    fprintf(stderr, "Positional arguments are deprecated, use -M -c %s -o %s -n %s\n", argv[1], argv[2], argv[3]);
   }
 
-#ifdef R__USE_IMT
-  ROOT::EnableImplicitMT();
-#endif
+  int c;
+  while (!isPositional && (c = getopt(argc, argv, "hc:r:j:o:n:M")) != -1) {
+    switch (c) {
+    case 'h':
+      Usage(argv[0]);
+      return 0;
+    case 'c':
+      compSettings = ParseCompression(optarg);
+      if (compSettings < -1) {
+        fprintf(stderr, "Invalid compression: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 'r': {
+      std::string rule = optarg;
+      auto posEq = rule.rfind('=');
+      int compression = (posEq == std::string::npos) ? -2 : ParseCompression(rule.substr(posEq + 1));
+      if (posEq == 0 || compression < -1) {
+        fprintf(stderr, "Invalid rule: %s\n", optarg);
+        return 1;
+      }
+      rules.emplace_back(std::make_unique<CompressionRule>(rule.substr(0, posEq), compression));
+      break;
+    }
+    case 'j':
+      nThreads = std::max(1, std::atoi(optarg));
+      break;
+    case 'o':
+      ntuple_file_out = optarg;
+      break;
+    case 'n':
+      ntuple_name = optarg;
+      break;
+    case 'M':
+      useMerger = true;
+      break;
+    default:
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+  const int firstInput = isPositional ? 4 : optind;
+  if (ntuple_file_out.empty() || ntuple_name.empty() || firstInput >= argc) {
+    Usage(argv[0]);
+    return 1;
+  }
+  if (useMerger && !rules.empty()) {
+    fprintf(stderr, "RNTupleMerger supports only a single compression setting (no -r)\n");
+    return 1;
+  }
 
   auto noWarn = RLogScopedVerbosity(NTupleLog(), ELogLevel::kError);
 
-  const int compSettings = std::atoi(argv[1]);
-  const char *ntuple_file_out = argv[2];
-  const char *ntuple_name = argv[3];
   std::vector<const char *> ntuple_files;
-  for (int i = 4; i < argc; ++i)
+  for (int i = firstInput; i < argc; ++i)
     ntuple_files.push_back(argv[i]);
 
   std::vector<std::unique_ptr<RPageSource>> srcs;
@@ -50,7 +273,7 @@ int main(int argc, char **argv) {
     if (!file)
       return 1;
 
-    auto *anchor = file->Get<RNTuple>(ntuple_name);
+    auto *anchor = file->Get<RNTuple>(ntuple_name.c_str());
     if (!anchor) {
       std::cerr << "Error reading RNTuple " << ntuple_name << " from " << ntuple_file << ": skipping.\n";
       continue;
@@ -60,17 +283,181 @@ int main(int argc, char **argv) {
     srcsRaw.push_back(s.get());
   }
 
-  auto dst = RPageSinkFile { ntuple_name, ntuple_file_out, RNTupleWriteOptions {} };
+  RNTupleWriteOptions writeOptions;
+  if (compSettings != -1)
+    writeOptions.SetCompression(compSettings);
 
-  RNTupleMerger merger;
-  RNTupleMergeOptions merge_opts;
-  merge_opts.fCompressionSettings = compSettings;
-  merger.Merge(srcsRaw, dst, merge_opts);
+  if (useMerger) {
+    auto dst = RPageSinkFile { ntuple_name, ntuple_file_out, writeOptions };
+#ifdef R__USE_IMT
+    ROOT::EnableImplicitMT();
+#endif
+    RNTupleMerger merger;
+    RNTupleMergeOptions merge_opts;
+    merge_opts.fCompressionSettings = compSettings;
+    merger.Merge(srcsRaw, dst, merge_opts);
 
-  std::cout << "Merged " << srcsRaw.size() << " ntuples.";
-  if (compSettings != -1)
-    std::cout << " Compression changed to " << compSettings << ".";
-  std::cout << "\nOut file is " << ntuple_file_out << "\n";
+    std::cout << "Merged " << srcsRaw.size() << " ntuples.";
+    if (compSettings != -1)
+      std::cout << " Compression changed to " << compSettings << ".";
+    std::cout << "\nOut file is " << ntuple_file_out << "\n";
+    return 0;
+  }
+
+  auto ts_start = steady_clock::now();
+  std::uint64_t bytesIn = 0;
+  std::uint64_t bytesOut = 0;
+  std::uint64_t bytesCopied = 0;
+  std::unique_ptr<RNTupleModel> model;
+  std::unique_ptr<RPageSinkFile> dst;
+  std::vector<ColumnInfo> columns;
+  for (auto src : srcsRaw) {
+    src->Attach();
+    auto desc = src->GetSharedDescriptorGuard()->Clone();
+
+    // All inputs must have the schema of the first one; columns are matched by name
+    std::vector<ColumnInfo> srcColumns;
+    CollectColumns(*desc, desc->GetFieldZeroId(), srcColumns, rules);
+    if (!model) {
+      // The sink labels all column ranges with the compression of its write options; if the compression is
+      // preserved, it is the one of the first input, so that its pages are copied and labelled correctly
+      const auto firstColumnId = srcColumns.empty() ? kInvalidDescriptorId : srcColumns[0].fInputId;
+      const auto firstClusterId = desc->FindClusterId(firstColumnId, 0);
+      if (compSettings == -1 && firstClusterId != kInvalidDescriptorId) {
+        writeOptions.SetCompression(
+          desc->GetClusterDescriptor(firstClusterId).GetColumnRange(firstColumnId).fCompressionSettings);
+      }
+      model = desc->CreateModel();
+      dst = std::make_unique<RPageSinkFile>(ntuple_name, ntuple_file_out, writeOptions);
+      dst->Init(*model);
+      columns = std::move(srcColumns);
+      for (const auto &column : columns) {
+        const auto compression = (column.fRuleIdx < rules.size()) ? rules[column.fRuleIdx]->fCompression
+                                                                    : writeOptions.GetCompression();
+        std::cout << column.fName << " (" << RColumnElementBase::GetTypeName(column.fElement->GetType())
+                  << "): " << compression << "\n";
+      }
+    } else {
+      bool isCompatible = (srcColumns.size() == columns.size());
+      for (std::size_t i = 0; isCompatible && i < columns.size(); ++i)
+        isCompatible = (srcColumns[i].fName == columns[i].fName);
+      if (!isCompatible) {
+        std::cerr << "Error: schema of input " << desc->GetName() << " does not match the first input\n";
+        return 1;
+      }
+      for (std::size_t i = 0; i < columns.size(); ++i)
+        columns[i].fInputId = srcColumns[i].fInputId;
+    }
+
+    RCluster::ColumnSet_t columnSet;
+    for (const auto &column : columns)
+      columnSet.insert(column.fInputId);
+
+    // Reads all pages of the cluster in one vector read
+    auto loadCluster = [src, &columnSet](DescriptorId_t id) {
+      RCluster::RKey key{id, columnSet};
+      return std::move(src->LoadClusters({&key, 1})[0]);
+    };
+
+    const auto nClusters = desc->GetNClusters();
+    std::size_t clusterNo = 0;
+    auto clusterId = columns.empty() ? kInvalidDescriptorId : desc->FindClusterId(columns[0].fInputId, 0);
+    std::future<std::unique_ptr<RCluster>> nextCluster;
+    if (clusterId != kInvalidDescriptorId)
+      nextCluster = std::async(std::launch::async, loadCluster, clusterId);
+    while (clusterId != kInvalidDescriptorId) {
+      const auto &clusterDesc = desc->GetClusterDescriptor(clusterId);
+      auto cluster = nextCluster.get();
+      const auto nextClusterId = desc->FindNextClusterId(clusterId);
+      if (nextClusterId != kInvalidDescriptorId)
+        nextCluster = std::async(std::launch::async, loadCluster, nextClusterId);
+
+      // The sealed pages must stay in place until committed, hence a deque per column
+      std::vector<RPageStorage::SealedPageSequence_t> sealedPages(columns.size());
+      // Only pages that change compression become tasks, the others are committed as loaded
+      std::vector<PageTask> tasks;
+      for (std::size_t i = 0; i < columns.size(); ++i) {
+        const auto &column = columns[i];
+        if (!clusterDesc.ContainsColumn(column.fInputId))
+          continue;
+        const auto srcCompression = clusterDesc.GetColumnRange(column.fInputId).fCompressionSettings;
+        const auto dstCompression =
+          (column.fRuleIdx < rules.size()) ? rules[column.fRuleIdx]->fCompression : writeOptions.GetCompression();
+        const bool needsRecompression = NeedsRecompression(srcCompression, dstCompression);
+        const auto &pageRange = clusterDesc.GetPageRange(column.fInputId);
+        std::uint64_t pageNo = 0;
+        for (const auto &pageInfo : pageRange.fPageInfos) {
+          auto onDiskPage = cluster->GetOnDiskPage(ROnDiskPage::Key{column.fInputId, pageNo++});
+          auto &sealed = sealedPages[i].emplace_back(onDiskPage->GetAddress(), onDiskPage->GetSize(),
+                                                     pageInfo.fNElements, pageInfo.fHasChecksum);
+          bytesIn += sealed.GetBufferSize();
+          if (needsRecompression) {
+            tasks.emplace_back(PageTask{&column, &sealed, nullptr, dstCompression});
+          } else {
+            bytesCopied += sealed.GetBufferSize();
+            if (column.fRuleIdx < rules.size()) {
+              rules[column.fRuleIdx]->fBytesIn += sealed.GetBufferSize();
+              rules[column.fRuleIdx]->fBytesOut += sealed.GetBufferSize();
+            }
+          }
+        }
+      }
+
+      std::atomic<std::size_t> nextTask{0};
+      auto worker = [&]() {
+        for (auto t = nextTask++; t < tasks.size(); t = nextTask++) {
+          auto &task = tasks[t];
+          const auto ruleIdx = task.fColumn->fRuleIdx;
+          const auto sizeIn = task.fSealed->GetBufferSize();
+          ProcessPage(task);
+          if (ruleIdx < rules.size()) {
+            rules[ruleIdx]->fBytesIn += sizeIn;
+            rules[ruleIdx]->fBytesOut += task.fSealed->GetBufferSize();
+          }
+        }
+      };
+      if (!tasks.empty()) {
+        std::vector<std::thread> threads;
+        for (unsigned i = 1; i < std::min<std::size_t>(nThreads, tasks.size()); ++i)
+          threads.emplace_back(worker);
+        worker();
+        for (auto &t : threads)
+          t.join();
+      }
+
+      std::vector<RPageStorage::RSealedPageGroup> sealedPageGroups;
+      for (std::size_t i = 0; i < columns.size(); ++i) {
+        if (sealedPages[i].empty())
+          continue;
+        for (const auto &sealed : sealedPages[i])
+          bytesOut += sealed.GetBufferSize();
+        sealedPageGroups.emplace_back(columns[i].fOutputId, sealedPages[i].cbegin(), sealedPages[i].cend());
+      }
+      dst->CommitSealedPageV(sealedPageGroups);
+      dst->CommitCluster(clusterDesc.GetNEntries());
+
+      auto seconds = duration_cast<microseconds>(steady_clock::now() - ts_start).count() / 1e6;
+      printf("[%s] cluster %zu/%lu: %.1f MB in, %.1f MB out, %.1f MB/s\n", desc->GetName().c_str(), ++clusterNo,
+             static_cast<unsigned long>(nClusters), bytesIn / 1e6, bytesOut / 1e6, bytesIn / 1e6 / seconds);
+      clusterId = nextClusterId;
+    }
+  }
+  if (!dst) {
+    std::cerr << "Error: no input contains the RNTuple " << ntuple_name << "\n";
+    return 1;
+  }
+  dst->CommitClusterGroup();
+  dst->CommitDataset();
+
+  auto seconds = duration_cast<microseconds>(steady_clock::now() - ts_start).count() / 1e6;
+  for (const auto &rule : rules) {
+    printf("rule %s=%d: %.1f MB -> %.1f MB\n", rule->fSelector.c_str(), rule->fCompression,
+           rule->fBytesIn / 1e6, rule->fBytesOut / 1e6);
+  }
+  std::cout << "Merged " << srcsRaw.size() << " ntuples with " << rules.size() << " compression rules using "
+            << nThreads << " threads in " << seconds << "s (" << bytesIn / 1e6 / seconds << " MB/s).\n"
+            << "Copied " << bytesCopied / 1e6 << " MB of " << bytesIn / 1e6 << " MB as sealed pages.\n"
+            << "Out file is " << ntuple_file_out << "\n";
 
   return 0;
 }
@@ -0,0 +1,17 @@
+#!/bin/sh
+
+if [ x$DATA_ROOT != "x" ]; then
+  SELECT_DATA_ROOT="DATA_ROOT=$DATA_ROOT"
+fi
+
+for sample in lhcb cms h1X10; do
+  for compression in none zstd; do
+    for format in ntuple root; do
+      make $SELECT_DATA_ROOT result_read_emuhdd.${sample}~${compression}.${format}.txt
+      for latency in 0 10 50 100; do
+        make $SELECT_DATA_ROOT \
+          result_read_emuhttp.${sample}+${latency}ms~${compression}.${format}.txt
+      done
+    done
+  done
+done
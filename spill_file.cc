@@ -0,0 +1,270 @@
+/**
+ * Copyright CERN; jblomer@cern.ch
+ */
+
+#include "spill_file.h"
+#include "util.h"
+
+#include <ROOT/RPageStorageFile.hxx>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+RSpillCache::RSpillCache(const std::string &url, const std::string &localPath) : fUrl(url), fLocalPath(localPath)
+{
+   const std::string partialPath = fLocalPath + ".partial";
+   // A spill file of a previous run already has the final size, so the remote end is only contacted once a
+   // missing block is needed
+   struct stat info;
+   fFdCache = open(partialPath.c_str(), O_RDWR);
+   if (fFdCache >= 0 && fstat(fFdCache, &info) == 0 && info.st_size > 0) {
+      fSize = info.st_size;
+   } else {
+      if (fFdCache >= 0)
+         close(fFdCache);
+      OpenRemote();
+      fSize = fRemote->GetSize();
+      fFdCache = open(partialPath.c_str(), O_RDWR | O_CREAT, 0644);
+      if (fFdCache < 0)
+         throw std::runtime_error("cannot open spill file " + partialPath + ": " + strerror(errno));
+      // Sparse file of the final size; blocks not yet fetched read as holes
+      if (ftruncate(fFdCache, fSize) != 0)
+         throw std::runtime_error("cannot resize spill file " + partialPath + ": " + strerror(errno));
+   }
+   const std::size_t nBlocks = (fSize + kBlockSize - 1) / kBlockSize;
+   fBlockMap.resize(nBlocks, 0);
+
+   const std::string mapPath = partialPath + ".map";
+   fFdMap = open(mapPath.c_str(), O_RDWR | O_CREAT, 0644);
+   if (fFdMap < 0)
+      throw std::runtime_error("cannot open block map " + mapPath + ": " + strerror(errno));
+   auto nread = pread(fFdMap, fBlockMap.data(), nBlocks, 0);
+   if (nread < 0)
+      nread = 0;
+   // A short map only happens if a previous run was killed while writing; treat the tail as missing
+   std::fill(fBlockMap.begin() + nread, fBlockMap.end(), 0);
+   fNBlocksPresent = std::count(fBlockMap.begin(), fBlockMap.end(), 1);
+
+   std::cerr << "Streaming " << fUrl << " (" << fSize << " B), " << fNBlocksPresent << "/" << nBlocks
+             << " blocks already in " << partialPath << '\n';
+   if (IsComplete())
+      Finalize();
+}
+
+
+RSpillCache::~RSpillCache()
+{
+   std::cerr << "Spill cache: fetched " << fNBytesFetched << " B in " << fNFetches << " requests, "
+             << fNBlocksPresent << "/" << fBlockMap.size() << " blocks local\n";
+   if (fFdMap >= 0)
+      close(fFdMap);
+   if (fFdCache >= 0)
+      close(fFdCache);
+}
+
+
+void RSpillCache::OpenRemote()
+{
+   if (!fRemote)
+      fRemote = ROOT::Internal::RRawFile::Create(fUrl);
+}
+
+
+void RSpillCache::FetchBlocks(std::size_t firstBlock, std::size_t nBlocks)
+{
+   OpenRemote();
+   const std::uint64_t offset = firstBlock * kBlockSize;
+   const std::size_t nbytes = std::min<std::uint64_t>(nBlocks * kBlockSize, fSize - offset);
+   fFetchBuffer.resize(nbytes);
+   auto nread = fRemote->ReadAt(fFetchBuffer.data(), nbytes, offset);
+   if (nread != nbytes)
+      throw std::runtime_error("short read from " + fUrl);
+   fNBytesFetched += nbytes;
+   fNFetches++;
+
+   std::size_t nwritten = 0;
+   while (nwritten < nbytes) {
+      auto n = pwrite(fFdCache, fFetchBuffer.data() + nwritten, nbytes - nwritten, offset + nwritten);
+      if (n < 0) {
+         if (errno == EINTR)
+            continue;
+         throw std::runtime_error("cannot write spill file: " + std::string(strerror(errno)));
+      }
+      nwritten += n;
+   }
+
+   std::fill(fBlockMap.begin() + firstBlock, fBlockMap.begin() + firstBlock + nBlocks, 1);
+   // Blocks are marked only after their data is written, so a crash never leaves a marked hole
+   auto n = pwrite(fFdMap, fBlockMap.data() + firstBlock, nBlocks, firstBlock);
+   (void)n;
+   fNBlocksPresent += nBlocks;
+   if (IsComplete())
+      Finalize();
+}
+
+
+void RSpillCache::Finalize()
+{
+   const std::string partialPath = fLocalPath + ".partial";
+   if (rename(partialPath.c_str(), fLocalPath.c_str()) != 0) {
+      std::cerr << "Warning: cannot rename " << partialPath << " to " << fLocalPath << '\n';
+      return;
+   }
+   unlink((partialPath + ".map").c_str());
+   std::cerr << "Spill cache complete: " << fLocalPath << '\n';
+}
+
+
+std::size_t RSpillCache::ReadAt(void *buffer, std::size_t nbytes, std::uint64_t offset)
+{
+   if (offset >= fSize)
+      return 0;
+   nbytes = std::min<std::uint64_t>(nbytes, fSize - offset);
+   if (nbytes == 0)
+      return 0;
+
+   {
+      std::lock_guard<std::mutex> guard(fLock);
+      // Fetch runs of missing blocks with a single request each
+      const std::size_t lastBlock = (offset + nbytes - 1) / kBlockSize;
+      std::size_t runStart = 0;
+      std::size_t runLength = 0;
+      for (std::size_t b = offset / kBlockSize; b <= lastBlock; ++b) {
+         if (fBlockMap[b]) {
+            if (runLength > 0)
+               FetchBlocks(runStart, runLength);
+            runLength = 0;
+            continue;
+         }
+         if (runLength == 0)
+            runStart = b;
+         runLength++;
+      }
+      if (runLength > 0)
+         FetchBlocks(runStart, runLength);
+   }
+
+   std::size_t nread = 0;
+   while (nread < nbytes) {
+      auto n = pread(fFdCache, reinterpret_cast<unsigned char *>(buffer) + nread, nbytes - nread, offset + nread);
+      if (n < 0) {
+         if (errno == EINTR)
+            continue;
+         throw std::runtime_error("cannot read spill file: " + std::string(strerror(errno)));
+      }
+      if (n == 0)
+         break;
+      nread += n;
+   }
+   return nread;
+}
+
+
+TFileSpill::TFileSpill(std::shared_ptr<RSpillCache> cache)
+   : TFile(cache->GetUrl().c_str(), "WEB"), fCache(cache)
+{
+   fD = fCache->GetFdCache();
+   Init(kFALSE);
+}
+
+
+TFileSpill::~TFileSpill()
+{
+   Close();
+}
+
+
+Int_t TFileSpill::SysRead(Int_t, void *buf, Int_t len)
+{
+   auto nbytes = fCache->ReadAt(buf, len, fPos);
+   fPos += nbytes;
+   return nbytes;
+}
+
+
+Long64_t TFileSpill::SysSeek(Int_t, Long64_t offset, Int_t whence)
+{
+   switch (whence) {
+   case SEEK_SET:
+      fPos = offset;
+      break;
+   case SEEK_CUR:
+      fPos += offset;
+      break;
+   case SEEK_END:
+      fPos = fCache->GetSize() + offset;
+      break;
+   default:
+      return -1;
+   }
+   return fPos;
+}
+
+
+Int_t TFileSpill::SysStat(Int_t, Long_t *id, Long64_t *size, Long_t *flags, Long_t *modtime)
+{
+   *id = 0;
+   *size = fCache->GetSize();
+   *flags = 0;
+   *modtime = 0;
+   return 0;
+}
+
+
+static std::shared_ptr<RSpillCache> MakeSpillCache(const std::string &path)
+{
+   std::string url = path;
+   if (path.find("://") == path.npos) {
+      if (path.find('/') != path.npos) {
+         std::cerr << "Refusing to stream file " << path << " with relative path.\n";
+         exit(1);
+      }
+      url = GetDownloadUrl(path);
+   }
+   return std::make_shared<RSpillCache>(url, GetFileName(path));
+}
+
+
+TFile *OpenOrStream(const std::string &path)
+{
+   if (access(path.c_str(), R_OK) == 0)
+      return TFile::Open(path.c_str());
+   const std::string localPath = GetFileName(path);
+   if (access(localPath.c_str(), R_OK) == 0)
+      return TFile::Open(localPath.c_str());
+
+   return new TFileSpill(MakeSpillCache(path));
+}
+
+
+std::unique_ptr<ROOT::Experimental::RNTupleReader> OpenNTupleOrStream(
+   std::unique_ptr<ROOT::Experimental::RNTupleModel> model,
+   const std::string &ntupleName,
+   const std::string &path,
+   const ROOT::Experimental::RNTupleReadOptions &options)
+{
+   using RNTupleReader = ROOT::Experimental::RNTupleReader;
+   using RPageSourceFile = ROOT::Experimental::Internal::RPageSourceFile;
+
+   if (access(path.c_str(), R_OK) == 0)
+      return RNTupleReader::Open(std::move(model), ntupleName, path, options);
+   const std::string localPath = GetFileName(path);
+   if (access(localPath.c_str(), R_OK) == 0)
+      return RNTupleReader::Open(std::move(model), ntupleName, localPath, options);
+
+   auto rawFile = std::make_unique<RRawFileSpill>(MakeSpillCache(path), ROOT::Internal::RRawFile::ROptions());
+   auto source = std::make_unique<RPageSourceFile>(ntupleName, std::move(rawFile), options);
+   return std::make_unique<RNTupleReader>(std::move(model), std::move(source));
+}
@@ -0,0 +1,121 @@
+/**
+ * Copyright CERN; jblomer@cern.ch
+ */
+
+#ifndef SPILL_FILE_H_
+#define SPILL_FILE_H_
+
+#include <ROOT/RNTupleModel.hxx>
+#include <ROOT/RNTupleReader.hxx>
+#include <ROOT/RNTupleReadOptions.hxx>
+#include <ROOT/RRawFile.hxx>
+
+#include <TFile.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// Block-wise local copy of a remote file that is filled on demand.  Every byte range that is read is
+/// fetched from the remote end in units of kBlockSize and written ("spilled") into a sparse local file
+/// `<name>.partial`.  The list of blocks present is kept in `<name>.partial.map` so that an interrupted
+/// run continues where the previous one stopped.  Once all blocks are present, the partial file is
+/// renamed to `<name>` and from then on the file is read like any other local file.  The remote end is
+/// opened only when a block is missing, so a run that finds all of its blocks in the spill file stays local.
+class RSpillCache {
+public:
+   static constexpr std::size_t kBlockSize = 1024 * 1024;
+
+private:
+   std::mutex fLock;
+   std::unique_ptr<ROOT::Internal::RRawFile> fRemote;
+   std::string fUrl;
+   std::string fLocalPath;
+   std::uint64_t fSize = 0;
+   int fFdCache = -1;
+   int fFdMap = -1;
+   std::vector<unsigned char> fBlockMap;
+   std::size_t fNBlocksPresent = 0;
+   std::vector<unsigned char> fFetchBuffer;
+
+   std::uint64_t fNBytesFetched = 0;
+   std::uint64_t fNFetches = 0;
+
+   void OpenRemote();
+   void FetchBlocks(std::size_t firstBlock, std::size_t nBlocks);
+   void Finalize();
+
+public:
+   RSpillCache(const std::string &url, const std::string &localPath);
+   RSpillCache(const RSpillCache &other) = delete;
+   RSpillCache &operator=(const RSpillCache &other) = delete;
+   ~RSpillCache();
+
+   std::size_t ReadAt(void *buffer, std::size_t nbytes, std::uint64_t offset);
+
+   const std::string &GetUrl() const { return fUrl; }
+   std::uint64_t GetSize() const { return fSize; }
+   int GetFdCache() const { return fFdCache; }
+   bool IsComplete() const { return fNBlocksPresent == fBlockMap.size(); }
+};
+
+
+/// RNTuple-side view of an RSpillCache.  Clones share the same cache.
+class RRawFileSpill : public ROOT::Internal::RRawFile {
+   std::shared_ptr<RSpillCache> fCache;
+
+protected:
+   void OpenImpl() final {}
+   std::size_t ReadAtImpl(void *buffer, std::size_t nbytes, std::uint64_t offset) final
+   {
+      return fCache->ReadAt(buffer, nbytes, offset);
+   }
+   std::uint64_t GetSizeImpl() final { return fCache->GetSize(); }
+
+public:
+   RRawFileSpill(std::shared_ptr<RSpillCache> cache, ROptions options)
+      : RRawFile(cache->GetUrl(), options), fCache(cache)
+   {
+   }
+   std::unique_ptr<RRawFile> Clone() const final { return std::make_unique<RRawFileSpill>(fCache, fOptions); }
+   int GetFeatures() const final { return kFeatureHasSize; }
+};
+
+
+/// TTree-side view of an RSpillCache.  TFile is constructed in "WEB" mode, which skips the local open,
+/// and all low-level I/O is redirected through the Sys...() hooks.
+class TFileSpill : public TFile {
+   std::shared_ptr<RSpillCache> fCache;
+   Long64_t fPos = 0;
+
+protected:
+   Int_t SysOpen(const char *, Int_t, UInt_t) final { return fCache->GetFdCache(); }
+   Int_t SysClose(Int_t) final { return 0; }
+   Int_t SysRead(Int_t, void *buf, Int_t len) final;
+   Int_t SysWrite(Int_t, const void *, Int_t) final { return -1; }
+   Long64_t SysSeek(Int_t, Long64_t offset, Int_t whence) final;
+   Int_t SysStat(Int_t, Long_t *id, Long64_t *size, Long_t *flags, Long_t *modtime) final;
+   Int_t SysSync(Int_t) final { return 0; }
+
+public:
+   explicit TFileSpill(std::shared_ptr<RSpillCache> cache);
+   ~TFileSpill() override;
+};
+
+
+/// Like OpenOrDownload() but starts reading immediately: non-local inputs are read through byte-range
+/// requests while the file is being spilled into the working directory.  A complete local copy from a
+/// previous run is used directly.
+TFile *OpenOrStream(const std::string &path);
+
+/// RNTuple counterpart of OpenOrStream()
+std::unique_ptr<ROOT::Experimental::RNTupleReader> OpenNTupleOrStream(
+   std::unique_ptr<ROOT::Experimental::RNTupleModel> model,
+   const std::string &ntupleName,
+   const std::string &path,
+   const ROOT::Experimental::RNTupleReadOptions &options);
+
+#endif  // SPILL_FILE_H_
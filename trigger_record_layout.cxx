@@ -0,0 +1,266 @@
+// Compares the schema shapes of the DUNE trigger record (see gen_trigger_record) on synthetic data:
+// write throughput, file open time and descriptor memory, and the throughput of reading a single
+// detector unit.
+
+#include <ROOT/RNTupleModel.hxx>
+#include <ROOT/RNTupleReader.hxx>
+#include <ROOT/RNTupleView.hxx>
+#include <ROOT/RNTupleWriter.hxx>
+#include <ROOT/RNTupleWriteOptions.hxx>
+
+#include <TSystem.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "TriggerRecord.hxx"
+#include "TriggerRecordFlat.hxx"
+#include "TriggerRecordUnits.hxx"
+
+using ROOT::Experimental::RClusterIndex;
+using ROOT::Experimental::RNTupleModel;
+using ROOT::Experimental::RNTupleReader;
+using ROOT::Experimental::RNTupleWriter;
+using ROOT::Experimental::RNTupleWriteOptions;
+
+static double GetSeconds(std::chrono::steady_clock::time_point ts_start)
+{
+   return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - ts_start).count() /
+          1e6;
+}
+
+// Resident set size of the process in bytes
+static std::size_t GetRSS()
+{
+   std::size_t size = 0;
+   std::size_t resident = 0;
+   FILE *f = fopen("/proc/self/statm", "r");
+   if (!f)
+      return 0;
+   if (fscanf(f, "%zu %zu", &size, &resident) != 2)
+      resident = 0;
+   fclose(f);
+   return resident * sysconf(_SC_PAGESIZE);
+}
+
+struct RBenchmarkConfig {
+   std::string fOutputDir = ".";
+   unsigned fNRecords = 100;
+   std::size_t fStreamSize = 4096;
+   int fCompressionSettings = 0;
+   int fUnit = 42;
+};
+
+// Reads the readout streams of a single detector unit from all records; returns the number of payload bytes.
+template <typename RecordT>
+static std::uint64_t ReadUnit(RNTupleReader &reader, int unit);
+
+template <>
+std::uint64_t ReadUnit<TriggerRecord>(RNTupleReader &reader, int unit)
+{
+   char fieldName[64];
+   snprintf(fieldName, sizeof(fieldName), "TriggerRecords.fDetectors.fUnit%03d", unit);
+   auto viewUnit = reader.GetView<TriggerRecord::DetectorUnit>(fieldName);
+
+   std::uint64_t nBytes = 0;
+   for (auto i : reader.GetEntryRange()) {
+      const auto &detectorUnit = viewUnit(i);
+      for (int s = 0; s < TriggerRecord::kNStreamsPerUnit; ++s) {
+         auto stream = reinterpret_cast<const TriggerRecord::Stream *>(
+            reinterpret_cast<const unsigned char *>(&detectorUnit) + TriggerRecord::kStreamOffsets[s]);
+         nBytes += stream->fData.size();
+      }
+   }
+   return nBytes;
+}
+
+template <>
+std::uint64_t ReadUnit<TriggerRecordUnits>(RNTupleReader &reader, int unit)
+{
+   char fieldName[64];
+   snprintf(fieldName, sizeof(fieldName), "TriggerRecords.fDetectors.fUnit%03d", unit);
+   auto viewUnit = reader.GetView<std::vector<TriggerRecordUnits::Stream>>(fieldName);
+
+   std::uint64_t nBytes = 0;
+   for (auto i : reader.GetEntryRange()) {
+      for (const auto &stream : viewUnit(i))
+         nBytes += stream.fData.size();
+   }
+   return nBytes;
+}
+
+template <>
+std::uint64_t ReadUnit<TriggerRecordFlat>(RNTupleReader &reader, int unit)
+{
+   // Only the two unit index items and the item range of the unit's streams are read
+   auto viewUnitIndex = reader.GetCollectionView("TriggerRecords.fUnitIndex");
+   auto viewUnitIndexItem = viewUnitIndex.GetView<std::uint32_t>("_0");
+   auto viewStreams = reader.GetCollectionView("TriggerRecords.fReadoutStreams");
+   auto viewStreamData = viewStreams.GetView<ROOT::RVec<std::byte>>("_0.fData");
+
+   std::uint64_t nBytes = 0;
+   for (auto i : reader.GetEntryRange()) {
+      const auto firstIndex = *viewUnitIndex.GetCollectionRange(i).begin();
+      const auto firstStream = *viewStreams.GetCollectionRange(i).begin();
+      const std::uint32_t begin =
+         viewUnitIndexItem(RClusterIndex(firstIndex.GetClusterId(), firstIndex.GetIndex() + unit));
+      const std::uint32_t end =
+         viewUnitIndexItem(RClusterIndex(firstIndex.GetClusterId(), firstIndex.GetIndex() + unit + 1));
+      for (auto s = begin; s < end; ++s)
+         nBytes += viewStreamData(RClusterIndex(firstStream.GetClusterId(), firstStream.GetIndex() + s)).size();
+   }
+   return nBytes;
+}
+
+template <typename RecordT>
+static void RunLayout(const std::string &layoutName, const RBenchmarkConfig &config)
+{
+   const std::string path = config.fOutputDir + "/trigger_record_" + layoutName + ".ntuple";
+
+   // Random payload, every stream copies a different window
+   std::vector<std::byte> pool(std::max<std::size_t>(2 * config.fStreamSize, 1024 * 1024));
+   std::mt19937 generator(42);
+   for (auto &b : pool)
+      b = static_cast<std::byte>(generator());
+
+   auto ts_write = std::chrono::steady_clock::now();
+   std::uint64_t nBytesWritten = 0;
+   {
+      auto model = RNTupleModel::Create();
+      auto ptrTR = model->MakeField<RecordT>("TriggerRecords");
+      RNTupleWriteOptions options;
+      options.SetCompression(config.fCompressionSettings);
+      auto writer = RNTupleWriter::Recreate(std::move(model), "DUNE", path, options);
+
+      std::size_t window = 0;
+      auto fillStream = [&](typename RecordT::Stream *stream, typename RecordT::EDataType dataType) {
+         stream->fDataType = dataType;
+         stream->fData.resize(config.fStreamSize);
+         window = (window + 4099) % (pool.size() - config.fStreamSize);
+         memcpy(stream->fData.data(), pool.data() + window, config.fStreamSize);
+         nBytesWritten += config.fStreamSize;
+      };
+      for (unsigned i = 0; i < config.fNRecords; ++i) {
+         ptrTR->fTRID = i;
+         ptrTR->fSliceID = 0;
+         for (int u = 0; u < RecordT::kNUnits; ++u) {
+            for (int s = 0; s < RecordT::kNStreamsPerUnit; ++s)
+               fillStream(ptrTR->GetReadoutStream(u, s), RecordT::EDataType::kWIBEth);
+         }
+         for (int s = 0; s < RecordT::kNHWSignalsInterfaces; ++s)
+            fillStream(ptrTR->GetHWSignalsInterfaceStream(s), RecordT::EDataType::kHardwareSignal);
+         for (int s = 0; s < RecordT::kNTriggers; ++s)
+            fillStream(ptrTR->GetTriggerStream(s), RecordT::EDataType::kTriggerPrimitive);
+         for (int s = 0; s < RecordT::kNTRBuilders; ++s)
+            fillStream(ptrTR->GetTRBuilderStream(s), RecordT::EDataType::kTriggerRecordHeader);
+         writer->Fill();
+      }
+   }
+   auto writeSeconds = GetSeconds(ts_write);
+   struct stat info;
+   stat(path.c_str(), &info);
+
+   // Open with an empty model: the cost is dominated by deserializing the header and footer
+   auto rssBeforeOpen = GetRSS();
+   auto ts_open = std::chrono::steady_clock::now();
+   auto reader = RNTupleReader::Open(RNTupleModel::Create(), "DUNE", path);
+   auto openSeconds = GetSeconds(ts_open);
+   auto rssAfterOpen = GetRSS();
+   auto descriptorBytes = (rssAfterOpen > rssBeforeOpen) ? rssAfterOpen - rssBeforeOpen : 0;
+   const auto &desc = reader->GetDescriptor();
+
+   auto ts_read = std::chrono::steady_clock::now();
+   auto nBytesRead = ReadUnit<RecordT>(*reader, config.fUnit);
+   auto readSeconds = GetSeconds(ts_read);
+
+   std::cout << layoutName << ": " << desc.GetNFields() << " fields, " << desc.GetNLogicalColumns() << " columns, "
+             << info.st_size / 1e6 << " MB on disk" << std::endl;
+   std::cout << "   write:     " << writeSeconds << "s, " << nBytesWritten / 1e6 / writeSeconds << " MB/s" << std::endl;
+   std::cout << "   open:      " << openSeconds << "s, " << descriptorBytes / 1e6 << " MB descriptor memory"
+             << std::endl;
+   std::cout << "   read unit: " << readSeconds << "s, " << nBytesRead / 1e6 / readSeconds << " MB/s" << std::endl;
+}
+
+static void Usage(char *progname)
+{
+   std::cout << "Usage: " << progname << " [-o <output directory>] [-n <records (100)>] [-s <bytes per stream (4096)>] "
+             << "[-c <compression>] [-u <unit to read (42)>] [-l members|units|flat (repeatable; default all)]"
+             << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+   RBenchmarkConfig config;
+   std::vector<std::string> layouts;
+
+   int c;
+   while ((c = getopt(argc, argv, "hvo:n:s:c:u:l:")) != -1) {
+      switch (c) {
+      case 'h':
+      case 'v':
+         Usage(argv[0]);
+         return 0;
+      case 'o':
+         config.fOutputDir = optarg;
+         break;
+      case 'n':
+         config.fNRecords = std::max(1, atoi(optarg));
+         break;
+      case 's':
+         config.fStreamSize = std::max(1, atoi(optarg));
+         break;
+      case 'c':
+         config.fCompressionSettings = GetCompressionSettings(optarg);
+         break;
+      case 'u':
+         config.fUnit = atoi(optarg);
+         break;
+      case 'l':
+         layouts.emplace_back(optarg);
+         break;
+      default:
+         fprintf(stderr, "Unknown option: -%c\n", c);
+         Usage(argv[0]);
+         return 1;
+      }
+   }
+   if (config.fUnit < 0 || config.fUnit >= TriggerRecord::kNUnits) {
+      fprintf(stderr, "Unit must be in [0, %d)\n", TriggerRecord::kNUnits);
+      return 1;
+   }
+   if (layouts.empty())
+      layouts = {"members", "units", "flat"};
+
+   gSystem->Load("./libTriggerRecord.so");
+   gSystem->Load("./libTriggerRecordUnits.so");
+   gSystem->Load("./libTriggerRecordFlat.so");
+
+   for (const auto &layout : layouts) {
+      if (layout == "members") {
+         RunLayout<TriggerRecord>(layout, config);
+      } else if (layout == "units") {
+         RunLayout<TriggerRecordUnits>(layout, config);
+      } else if (layout == "flat") {
+         RunLayout<TriggerRecordFlat>(layout, config);
+      } else {
+         fprintf(stderr, "Unknown layout: %s\n", layout.c_str());
+         return 1;
+      }
+   }
+
+   return 0;
+}
@@ -0,0 +1,185 @@
+/**
+ * Copyright CERN; jblomer@cern.ch
+ */
+
+#ifndef TSC_COUNTER_H_
+#define TSC_COUNTER_H_
+
+#include <ROOT/RNTupleMetrics.hxx>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/// Time stamp counter of the CPU with a conversion to nanoseconds that is calibrated once per process against
+/// steady_clock.  Assumes an invariant TSC, i.e. constant rate and synchronized across cores.  On other
+/// architectures, steady_clock is used directly.
+class RTscClock {
+public:
+   /// Start of an interval; lfence keeps rdtsc from executing before the preceding instructions completed
+   static std::uint64_t Start()
+   {
+#if defined(__x86_64__) || defined(__i386__)
+      _mm_lfence();
+      return __rdtsc();
+#else
+      return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+   }
+
+   /// End of an interval; rdtscp waits for the preceding instructions to complete
+   static std::uint64_t Stop()
+   {
+#if defined(__x86_64__) || defined(__i386__)
+      unsigned int aux;
+      return __rdtscp(&aux);
+#else
+      return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+   }
+
+   static double GetNsPerTick()
+   {
+      static const double nsPerTick = Calibrate();
+      return nsPerTick;
+   }
+
+private:
+   static double Calibrate()
+   {
+#if defined(__x86_64__) || defined(__i386__)
+      using std::chrono::steady_clock;
+      const auto tsStart = steady_clock::now();
+      const auto ticksStart = Start();
+      while (steady_clock::now() - tsStart < std::chrono::milliseconds(20)) {
+      }
+      const auto ticksEnd = Stop();
+      const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(steady_clock::now() - tsStart).count();
+      return double(ns) / double(ticksEnd - ticksStart);
+#else
+      return double(std::chrono::steady_clock::period::num) * 1e9 / std::chrono::steady_clock::period::den;
+#endif
+   }
+};
+
+/// Performance counter of TSC ticks for RNTupleMetrics.  Every thread adds to its own cache line without a
+/// locked instruction; the per-thread values are summed up and converted to nanoseconds when read.
+class RTscCounter : public ROOT::Experimental::Detail::RNTuplePerfCounter {
+public:
+   /// Live threads beyond this number minus one share the last slot, which is updated with a locked add
+   static constexpr unsigned kMaxThreads = 256;
+
+private:
+   static constexpr unsigned kSharedSlot = kMaxThreads - 1;
+
+   struct alignas(64) RSlot {
+      std::atomic<std::uint64_t> fTicks{0};
+   };
+   RSlot fSlots[kMaxThreads];
+
+   /// Hands out the slot indexes; the slots of exited threads are reused before new ones are taken
+   class RSlotRegistry {
+      std::mutex fLock;
+      std::vector<unsigned> fFreeSlots;
+      unsigned fNextSlot = 0;
+
+   public:
+      unsigned Acquire()
+      {
+         std::lock_guard<std::mutex> guard(fLock);
+         if (!fFreeSlots.empty()) {
+            auto idx = fFreeSlots.back();
+            fFreeSlots.pop_back();
+            return idx;
+         }
+         return (fNextSlot < kSharedSlot) ? fNextSlot++ : kSharedSlot;
+      }
+      void Release(unsigned idx)
+      {
+         if (idx == kSharedSlot)
+            return;
+         std::lock_guard<std::mutex> guard(fLock);
+         fFreeSlots.push_back(idx);
+      }
+   };
+
+   static RSlotRegistry &GetRegistry()
+   {
+      static RSlotRegistry gRegistry;
+      return gRegistry;
+   }
+
+   /// Returns the slot of a thread to the registry when the thread exits.  The ticks remain in the slot.
+   struct RSlotLease {
+      unsigned fIdx;
+      ~RSlotLease() { GetRegistry().Release(fIdx); }
+   };
+
+   static unsigned GetSlotIdx()
+   {
+      // Constant initialization, so that the thread-local access needs no guard
+      static thread_local unsigned tSlot = kMaxThreads;
+      if (tSlot == kMaxThreads) {
+         static thread_local RSlotLease tLease{GetRegistry().Acquire()};
+         tSlot = tLease.fIdx;
+      }
+      return tSlot;
+   }
+
+public:
+   RTscCounter(const std::string &name, const std::string &unit, const std::string &desc)
+      : RNTuplePerfCounter(name, unit, desc)
+   {
+      // Calibrate outside of the measured intervals
+      RTscClock::GetNsPerTick();
+   }
+
+   void Add(std::uint64_t ticks)
+   {
+      if (!IsEnabled())
+         return;
+      const auto idx = GetSlotIdx();
+      auto &slot = fSlots[idx].fTicks;
+      if (idx == kSharedSlot) {
+         slot.fetch_add(ticks, std::memory_order_relaxed);
+         return;
+      }
+      // Single writer per slot: relaxed load and store instead of fetch_add
+      slot.store(slot.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+   }
+
+   std::uint64_t GetTicks() const
+   {
+      std::uint64_t sum = 0;
+      for (const auto &s : fSlots)
+         sum += s.fTicks.load(std::memory_order_relaxed);
+      return sum;
+   }
+
+   /// Sum over all threads in nanoseconds
+   std::int64_t GetValue() const { return GetTicks() * RTscClock::GetNsPerTick(); }
+
+   std::int64_t GetValueAsInt() const final { return GetValue(); }
+   std::string GetValueAsString() const final { return std::to_string(GetValue()); }
+};
+
+/// Adds the TSC ticks of its lifetime to an RTscCounter
+class RTscTimer {
+   RTscCounter &fCounter;
+   std::uint64_t fStart;
+
+public:
+   explicit RTscTimer(RTscCounter &counter) : fCounter(counter), fStart(RTscClock::Start()) {}
+   ~RTscTimer() { fCounter.Add(RTscClock::Stop() - fStart); }
+   RTscTimer(const RTscTimer &) = delete;
+   RTscTimer &operator=(const RTscTimer &) = delete;
+};
+
+#endif // TSC_COUNTER_H_
@@ -65,6 +65,9 @@ FileFormats GetFileFormat(const std::string &suffix) {
   else if (suffix == "ntuple-deflated") return FileFormats::kNtupleDeflated;
   else if (suffix == "ntuple-inflated") return FileFormats::kNtupleInflated;
   else if (suffix == "ntuple") return FileFormats::kNtuple;
+  else if (suffix == "parquet") return FileFormats::kParquet;
+  else if (suffix == "h5") return FileFormats::kH5;
+  else if (suffix == "hdf5") return FileFormats::kH5;
   else abort();
 }
 
@@ -182,6 +185,14 @@ int GetCompressionSettings(std::string shorthand) {
 }
 
 
+std::string GetDownloadUrl(const std::string &path) {
+  std::string url = "https://root.cern/files/RNTuple/";
+  if (path.length() > 5 && !path.compare(path.length() - 5, 5, ".root"))
+    url += "treeref/";
+  return url + path;
+}
+
+
 TFile *OpenOrDownload(const std::string &path) {
   if (auto file = TFile::Open(path.c_str()))
     return file;
@@ -190,10 +201,7 @@ TFile *OpenOrDownload(const std::string &path) {
     std::cerr << "Refusing to download file " << path << " with relative path.\n";
     exit(1);
   }
-  std::string url = "https://root.cern/files/RNTuple/";
-  if (path.length() > 5 && !path.compare(path.length() - 5, 5, ".root"))
-    url += "treeref/";
-  url += path;
+  std::string url = GetDownloadUrl(path);
   std::cerr << "Downloading " << url << '\n';
   std::string cmd = "curl -L -O " + url;
   if (system(cmd.c_str())) {
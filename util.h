@@ -19,7 +19,7 @@ enum class FileFormats
     kRootAutosplitInflated, kRootAutosplitDeflated, kRootDeepsplitInflated,
     kRootDeepsplitDeflated, kRootDeepsplitLz4, kParquetInflated,
     kParquetDeflated, kParquetSnappy, kParquetDeepInflated,
-    kNtuple, kNtupleDeflated, kNtupleInflated };
+    kNtuple, kNtupleDeflated, kNtupleInflated, kParquet, kH5 };
 
 FileFormats GetFileFormat(const std::string &suffix);
 std::string StripSuffix(const std::string &path);
@@ -40,6 +40,7 @@ std::string StringifyUint(const uint64_t value);
 
 int GetCompressionSettings(std::string shorthand);
 
+std::string GetDownloadUrl(const std::string &path);
 TFile *OpenOrDownload(const std::string &path);
 
 #endif  // UTIL_H_